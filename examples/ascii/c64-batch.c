@@ -0,0 +1,391 @@
+/*
+    c64-batch.c
+
+    Runs many headless C64 jobs in parallel (e.g. to regression-test a
+    software library) and streams one JSON object per finished job to
+    stdout.
+
+    Each worker thread owns one C64 instance which boots once, every job
+    then restarts from the booted state (see c64-job.h). The ROM images
+    are shared read-only by all workers.
+
+    Args:
+
+        jobs=manifest.txt   the job manifest (required)
+        threads=N           number of worker threads (default: number of CPUs)
+        screen=yes          include the screen text in the results
+
+    The manifest has one job per line, with the same key=value args as
+    c64-run (file, input, tape, stop-pc, stop-text, stop-mem, max-cycles) plus
+    an optional system=c64. Values with spaces must be in double quotes,
+    and \n, \" and \\ are unescaped in quoted values. Empty lines and
+    lines starting with # are skipped. For instance:
+
+        file=games/foo.prg stop-text="GAME OVER" max-cycles=50000000
+        file=demos/bar.tap input="LOAD\nRUN\n" stop-mem=D020:00
+
+    Each result has the manifest line number, the stop reason, the cycle
+    count, the PC and the CRC32 of RAM and screen, in completion order.
+    The exit code is 0 if all jobs succeeded (same rules as c64-run).
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#define SOKOL_IMPL
+#include "sokol_args.h"
+#include "sokol_time.h"
+#define CHIPS_IMPL
+#include "chips/m6502.h"
+#include "chips/m6526.h"
+#include "chips/m6569.h"
+#include "chips/m6581.h"
+#include "chips/beeper.h"
+#include "chips/kbd.h"
+#include "chips/mem.h"
+#include "chips/clk.h"
+#include "systems/c1530.h"
+#include "chips/m6522.h"
+#include "systems/c1541.h"
+#include "systems/c64.h"
+#include "c64-roms.h"
+#define COMMON_IMPL
+#define KEYBUF_PER_THREAD
+#include "../common/keybuf.h"
+#include "../common/inflate.h"
+#include "../common/cbmtape.h"
+#include "c64-job.h"
+
+#define MAX_THREADS (64)
+#define MAX_ARGS (16)
+
+typedef struct {
+    int line;
+    // parsed arguments, point into args_buf
+    int num_args;
+    const char* keys[MAX_ARGS];
+    const char* values[MAX_ARGS];
+    char* args_buf;
+} job_entry_t;
+
+static struct {
+    job_entry_t* jobs;
+    int num_jobs;
+    bool screen;
+    #if !defined(_WIN32)
+    pthread_mutex_t mutex;
+    #endif
+    // protected by mutex
+    int next_job;
+    int num_failed;
+} state;
+
+static void lock(void) {
+    #if !defined(_WIN32)
+    pthread_mutex_lock(&state.mutex);
+    #endif
+}
+
+static void unlock(void) {
+    #if !defined(_WIN32)
+    pthread_mutex_unlock(&state.mutex);
+    #endif
+}
+
+// split a manifest line into key=value pairs, in place
+static bool parse_line(char* str, job_entry_t* job) {
+    char* p = str;
+    while (true) {
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p == 0) {
+            return true;
+        }
+        if (job->num_args == MAX_ARGS) {
+            return false;
+        }
+        job->keys[job->num_args] = p;
+        while (*p && (*p != '=') && !isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p != '=') {
+            return false;
+        }
+        *p++ = 0;
+        char* dst = p;
+        job->values[job->num_args++] = dst;
+        if (*p == '"') {
+            p++;
+            while (*p && (*p != '"')) {
+                if ((*p == '\\') && p[1]) {
+                    p++;
+                    *dst++ = (*p == 'n') ? '\n' : *p;
+                    p++;
+                }
+                else {
+                    *dst++ = *p++;
+                }
+            }
+            if (*p != '"') {
+                return false;
+            }
+            p++;
+        }
+        else {
+            while (*p && !isspace((unsigned char)*p)) {
+                *dst++ = *p++;
+            }
+        }
+        const bool at_end = (*p == 0);
+        *dst = 0;
+        if (at_end) {
+            return true;
+        }
+        p++;
+    }
+}
+
+static bool load_manifest(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "c64-batch: failed to open '%s'\n", path);
+        return false;
+    }
+    char line_buf[4096];
+    int line = 0;
+    int capacity = 0;
+    while (fgets(line_buf, sizeof(line_buf), fp)) {
+        line++;
+        line_buf[strcspn(line_buf, "\r\n")] = 0;
+        const char* p = line_buf;
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        if ((*p == 0) || (*p == '#')) {
+            continue;
+        }
+        if (state.num_jobs == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            state.jobs = (job_entry_t*) realloc(state.jobs, (size_t)capacity * sizeof(job_entry_t));
+        }
+        job_entry_t* job = &state.jobs[state.num_jobs];
+        memset(job, 0, sizeof(job_entry_t));
+        job->line = line;
+        const size_t len = strlen(p) + 1;
+        job->args_buf = (char*) malloc(len);
+        memcpy(job->args_buf, p, len);
+        if (!parse_line(job->args_buf, job)) {
+            fprintf(stderr, "c64-batch: %s:%d: malformed job\n", path, line);
+            fclose(fp);
+            return false;
+        }
+        state.num_jobs++;
+    }
+    fclose(fp);
+    return true;
+}
+
+// fill a c64job_desc_t from the job args, returns an error message or 0
+static const char* job_desc(const job_entry_t* job, c64job_desc_t* desc) {
+    memset(desc, 0, sizeof(c64job_desc_t));
+    for (int i = 0; i < job->num_args; i++) {
+        const char* key = job->keys[i];
+        const char* val = job->values[i];
+        if (0 == strcmp(key, "system")) {
+            if (0 != strcmp(val, "c64")) {
+                return "unsupported system";
+            }
+        }
+        else if (0 == strcmp(key, "file")) {
+            desc->file = val;
+        }
+        else if (0 == strcmp(key, "input")) {
+            desc->input = val;
+        }
+        else if (0 == strcmp(key, "tape")) {
+            desc->fast_tape = (0 == strcmp(val, "fast"));
+        }
+        else if (0 == strcmp(key, "stop-pc")) {
+            desc->stop_pc_enabled = true;
+            desc->stop_pc = (uint16_t) strtoul(val, 0, 16);
+        }
+        else if (0 == strcmp(key, "stop-text")) {
+            desc->stop_text = val;
+        }
+        else if (0 == strcmp(key, "stop-mem")) {
+            char* end;
+            const unsigned long addr = strtoul(val, &end, 16);
+            if ((*end != ':') || (addr > 0xFFFF)) {
+                return "stop-mem expects addr:value in hex";
+            }
+            desc->stop_mem_enabled = true;
+            desc->stop_mem_addr = (uint16_t) addr;
+            desc->stop_mem_val = (uint8_t) strtoul(end + 1, 0, 16);
+        }
+        else if (0 == strcmp(key, "max-cycles")) {
+            desc->max_cycles = strtoull(val, 0, 10);
+        }
+        else {
+            return "unknown key";
+        }
+    }
+    return 0;
+}
+
+static void json_string(FILE* fp, const char* str) {
+    fputc('"', fp);
+    for (; *str; str++) {
+        const unsigned char c = (unsigned char) *str;
+        if ((c == '"') || (c == '\\')) {
+            fprintf(fp, "\\%c", c);
+        }
+        else if (c == '\n') {
+            fputs("\\n", fp);
+        }
+        else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        }
+        else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void print_result(const job_entry_t* entry, const c64job_desc_t* desc, c64job_t* job, const char* err, double ms) {
+    // gather the results before taking the lock, only the output is serialized
+    bool ok = false;
+    uint32_t ram_crc = 0, screen_crc = 0;
+    char screen[C64JOB_SCREEN_TEXT_SIZE];
+    if (!err) {
+        ok = c64job_success(job);
+        c64job_screen_text(job, screen);
+        screen_crc = inflate_crc32(0, (const uint8_t*)screen, strlen(screen));
+        uint8_t page[256];
+        for (int i = 0; i < (1<<16); i++) {
+            page[i & 0xFF] = mem_rd(&job->c64.mem_cpu, (uint16_t)i);
+            if ((i & 0xFF) == 0xFF) {
+                ram_crc = inflate_crc32(ram_crc, page, sizeof(page));
+            }
+        }
+    }
+    lock();
+    printf("{\"line\":%d,\"system\":\"c64\",\"file\":", entry->line);
+    json_string(stdout, desc->file ? desc->file : "");
+    if (err) {
+        printf(",\"status\":\"error\",\"error\":");
+        json_string(stdout, err);
+    }
+    else {
+        printf(",\"status\":\"%s\",\"stop\":\"%s\",\"cycles\":%llu,\"pc\":\"%04X\",\"ram_crc32\":\"%08X\",\"screen_crc32\":\"%08X\"",
+            ok ? "ok" : "fail",
+            c64job_stop_name(job->stop),
+            (unsigned long long)job->cycles,
+            m6502_pc(&job->c64.cpu),
+            ram_crc,
+            screen_crc);
+        if (state.screen) {
+            printf(",\"screen\":");
+            json_string(stdout, screen);
+        }
+    }
+    printf(",\"ms\":%.1f}\n", ms);
+    fflush(stdout);
+    if (!ok) {
+        state.num_failed++;
+    }
+    unlock();
+}
+
+static void* worker(void* arg) {
+    (void)arg;
+    // the instance boots lazily, a worker without jobs doesn't pay for it
+    c64job_t* job = 0;
+    while (true) {
+        lock();
+        const int index = state.next_job++;
+        unlock();
+        if (index >= state.num_jobs) {
+            break;
+        }
+        const job_entry_t* entry = &state.jobs[index];
+        const uint64_t start = stm_now();
+        c64job_desc_t desc;
+        const char* err = job_desc(entry, &desc);
+        if (!err) {
+            if (!job) {
+                job = (c64job_t*) malloc(sizeof(c64job_t));
+                c64job_init(job, true);
+            }
+            err = c64job_start(job, &desc);
+            if (!err) {
+                c64job_run(job);
+            }
+        }
+        print_result(entry, &desc, job, err, stm_ms(stm_since(start)));
+    }
+    if (job) {
+        c64job_discard(job);
+        free(job);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    sargs_setup(&(sargs_desc){ .argc=argc, .argv=argv });
+    stm_setup();
+    if (!sargs_exists("jobs")) {
+        fprintf(stderr, "usage: c64-batch jobs=manifest.txt [threads=N] [screen=yes]\n");
+        return 2;
+    }
+    if (!load_manifest(sargs_value("jobs"))) {
+        return 2;
+    }
+    state.screen = sargs_exists("screen");
+    // inflate_crc32() builds its table on first use, do this before the workers start
+    inflate_crc32(0, 0, 0);
+    const uint64_t start = stm_now();
+    #if !defined(_WIN32)
+    int num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (sargs_exists("threads")) {
+        num_threads = atoi(sargs_value("threads"));
+    }
+    if (num_threads > state.num_jobs) {
+        num_threads = state.num_jobs;
+    }
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    pthread_mutex_init(&state.mutex, 0);
+    pthread_t threads[MAX_THREADS];
+    for (int i = 0; i < num_threads; i++) {
+        pthread_create(&threads[i], 0, worker, 0);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], 0);
+    }
+    pthread_mutex_destroy(&state.mutex);
+    #else
+    // no thread pool on Windows, run the jobs one after another
+    const int num_threads = 1;
+    worker(0);
+    #endif
+    fprintf(stderr, "c64-batch: %d jobs, %d failed, %d threads, %.1f s\n",
+        state.num_jobs, state.num_failed, num_threads, stm_sec(stm_since(start)));
+    for (int i = 0; i < state.num_jobs; i++) {
+        free(state.jobs[i].args_buf);
+    }
+    free(state.jobs);
+    sargs_shutdown();
+    return (state.num_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,285 @@
+#pragma once
+/*
+    c64-job.h
+
+    A headless C64 instance for scripted runs, shared by c64-run and
+    c64-batch. The instance boots into BASIC once, each job then starts
+    from a copy of the booted state (no re-init, no boot frames), loads
+    its media, types its input and runs unthrottled until one of its
+    stop conditions is met.
+
+    Include after systems/c64.h and the keybuf.h and cbmtape.h implementations. The
+    keybuf is used for typing, so there can be only one running job per
+    thread (see KEYBUF_PER_THREAD).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define C64JOB_FRAME_USEC (20000)
+#define C64JOB_BOOT_MAX_FRAMES (5 * 50)
+#define C64JOB_SCREEN_ADDR (0x0400)
+// 25 lines of 40 chars plus newline, and a terminating zero
+#define C64JOB_SCREEN_TEXT_SIZE (25 * 41 + 1)
+
+typedef enum {
+    C64JOB_STOP_NONE,
+    C64JOB_STOP_PC,
+    C64JOB_STOP_TEXT,
+    C64JOB_STOP_MEM,
+    C64JOB_STOP_CYCLES,
+} c64job_stop_t;
+
+typedef struct {
+    const char* file;           // optional .prg/.bin (quickload + RUN) or .tap (tape + LOAD)
+    const char* input;          // optional text to type instead of RUN/LOAD
+    bool fast_tape;             // decode standard KERNAL tapes and quickload them (see cbmtape.h)
+    bool stop_pc_enabled;       // stop when the CPU fetches an opcode at stop_pc
+    uint16_t stop_pc;
+    const char* stop_text;      // optional, stop when the screen contains this text
+    bool stop_mem_enabled;      // stop when memory at stop_mem_addr holds stop_mem_val
+    uint16_t stop_mem_addr;
+    uint8_t stop_mem_val;
+    uint64_t max_cycles;        // cycle limit after loading, 0 for 60 emulated seconds
+} c64job_desc_t;
+
+typedef struct {
+    c64_t c64;
+    // the system right after booting into BASIC, restored for each job
+    c64_t booted;
+    uint32_t pixels[512*512];
+    c64job_desc_t desc;
+    uint8_t* file_data;
+    size_t file_size;
+    uint8_t tape_prg[0x10002];
+    // run state, updated from the debug hook
+    bool armed;
+    bool stopped;
+    c64job_stop_t stop;
+    uint64_t cycles;
+} c64job_t;
+
+// the job currently running on this thread, for the keybuf ready callback
+static KEYBUF_THREAD_LOCAL c64job_t* c64job_cur;
+
+// conversion from C64 screen codes to ASCII (the 'x' is actually the pound sign)
+static const char c64job_font_map[65] = "@ABCDEFGHIJKLMNOPQRSTUVWXYZ[x]   !\"#$%&`()*+,-./0123456789:;<=>?";
+
+static const char* c64job_stop_name(c64job_stop_t stop) {
+    static const char* names[] = { "none", "pc", "text", "mem", "cycles" };
+    return names[stop];
+}
+
+static bool c64job_has_ext(const char* path, const char* ext) {
+    const char* dot = strrchr(path, '.');
+    if (!dot) {
+        return false;
+    }
+    dot++;
+    for (; *dot && *ext; dot++, ext++) {
+        if (tolower(*dot) != *ext) {
+            return false;
+        }
+    }
+    return (*dot == 0) && (*ext == 0);
+}
+
+// screen text as 25 lines of 40 chars, each line terminated with '\n'
+static void c64job_screen_text(c64job_t* job, char* buf) {
+    for (int y = 0; y < 25; y++) {
+        for (int x = 0; x < 40; x++) {
+            const uint8_t font_code = mem_rd(&job->c64.mem_vic, C64JOB_SCREEN_ADDR + y*40 + x);
+            *buf++ = c64job_font_map[font_code & 63];
+        }
+        *buf++ = '\n';
+    }
+    *buf = 0;
+}
+
+static bool c64job_screen_contains(c64job_t* job, const char* text) {
+    char buf[C64JOB_SCREEN_TEXT_SIZE];
+    c64job_screen_text(job, buf);
+    // screen codes are upper case only
+    char upper[256];
+    size_t i = 0;
+    for (; text[i] && (i < sizeof(upper) - 1); i++) {
+        upper[i] = (char) toupper(text[i]);
+    }
+    upper[i] = 0;
+    return 0 != strstr(buf, upper);
+}
+
+// called by c64_exec() after each tick
+static void c64job_debug_tick(void* user_data, uint64_t pins) {
+    c64job_t* job = (c64job_t*) user_data;
+    if (!job->armed) {
+        return;
+    }
+    job->cycles++;
+    if (job->desc.stop_pc_enabled && (pins & M6502_SYNC) && (M6502_GET_ADDR(pins) == job->desc.stop_pc)) {
+        job->stop = C64JOB_STOP_PC;
+        job->stopped = true;
+    }
+    else if (job->cycles >= job->desc.max_cycles) {
+        job->stop = C64JOB_STOP_CYCLES;
+        job->stopped = true;
+    }
+}
+
+static bool c64job_keybuf_ready(void) {
+    return 0 == mem_rd(&c64job_cur->c64.mem_cpu, 0xC6);
+}
+
+static void c64job_check_stop(c64job_t* job) {
+    if (job->stop != C64JOB_STOP_NONE) {
+        return;
+    }
+    if (job->desc.stop_text && c64job_screen_contains(job, job->desc.stop_text)) {
+        job->stop = C64JOB_STOP_TEXT;
+    }
+    else if (job->desc.stop_mem_enabled && (mem_rd(&job->c64.mem_cpu, job->desc.stop_mem_addr) == job->desc.stop_mem_val)) {
+        job->stop = C64JOB_STOP_MEM;
+    }
+}
+
+// run one frame and feed keyboard input
+static void c64job_frame(c64job_t* job) {
+    c64_exec(&job->c64, C64JOB_FRAME_USEC);
+    uint8_t key_code;
+    if (0 != (key_code = keybuf_get(C64JOB_FRAME_USEC))) {
+        c64_key_down(&job->c64, key_code);
+        c64_key_up(&job->c64, key_code);
+    }
+}
+
+// initialize the instance and boot into BASIC, the tape drive is needed for .tap jobs
+static void c64job_init(c64job_t* job, bool c1530_enabled) {
+    memset(job, 0, sizeof(c64job_t));
+    c64_init(&job->c64, &(c64_desc_t){
+        .c1530_enabled = c1530_enabled,
+        .pixel_buffer = { .ptr = job->pixels, .size = sizeof(job->pixels) },
+        .roms = {
+            .chars = { .ptr=dump_c64_char_bin, .size=sizeof(dump_c64_char_bin) },
+            .basic = { .ptr=dump_c64_basic_bin, .size=sizeof(dump_c64_basic_bin) },
+            .kernal = { .ptr=dump_c64_kernalv3_bin, .size=sizeof(dump_c64_kernalv3_bin) }
+        },
+        .debug = {
+            .callback = { .func = c64job_debug_tick, .user_data = job },
+            .stopped = &job->stopped,
+        },
+    });
+    c64job_cur = job;
+    keybuf_init(&(keybuf_desc_t){ .key_delay_frames=2, .ready_cb=c64job_keybuf_ready });
+    for (int i = 0; (i < C64JOB_BOOT_MAX_FRAMES) && !c64job_screen_contains(job, "READY."); i++) {
+        c64job_frame(job);
+    }
+    // the debug hook and pixel buffer point into the job, so a plain copy restores the booted system
+    job->booted = job->c64;
+}
+
+static void c64job_discard(c64job_t* job) {
+    c64_discard(&job->c64);
+    keybuf_shutdown();
+    free(job->file_data);
+    job->file_data = 0;
+}
+
+static bool c64job_read_file(c64job_t* job, const char* path) {
+    free(job->file_data);
+    job->file_data = 0;
+    job->file_size = 0;
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    const long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    bool ok = false;
+    if (size > 0) {
+        job->file_size = (size_t) size;
+        job->file_data = (uint8_t*) malloc(job->file_size);
+        ok = (job->file_data != 0) && (1 == fread(job->file_data, job->file_size, 1, fp));
+    }
+    fclose(fp);
+    return ok;
+}
+
+// restore the booted system and load the job's media, returns an error message or 0
+static const char* c64job_start(c64job_t* job, const c64job_desc_t* desc) {
+    job->c64 = job->booted;
+    job->desc = *desc;
+    if (0 == job->desc.max_cycles) {
+        job->desc.max_cycles = 60ULL * C64_FREQUENCY;
+    }
+    job->armed = false;
+    job->stopped = false;
+    job->stop = C64JOB_STOP_NONE;
+    job->cycles = 0;
+    c64job_cur = job;
+    keybuf_init(&(keybuf_desc_t){ .key_delay_frames=2, .ready_cb=c64job_keybuf_ready });
+    const char* input = desc->input;
+    if (desc->file) {
+        if (c64job_has_ext(desc->file, "d64")) {
+            return "disc images are not supported by this C64 emulator version";
+        }
+        if (!c64job_read_file(job, desc->file)) {
+            return "failed to read file";
+        }
+        int tape_prg_size = 0;
+        int tape_end = 0;
+        if (desc->fast_tape && c64job_has_ext(desc->file, "tap")) {
+            // relocatable programs go to the BASIC start like with LOAD
+            const uint16_t txttab = mem_rd(&job->c64.mem_cpu, 0x2B) | (mem_rd(&job->c64.mem_cpu, 0x2C) << 8);
+            tape_prg_size = cbmtape_to_prg(job->file_data, (int)job->file_size, txttab, job->tape_prg, sizeof(job->tape_prg), &tape_end);
+        }
+        if (tape_prg_size > 0) {
+            if (!c64_quickload(&job->c64, job->tape_prg, tape_prg_size)) {
+                return "failed to load tape program";
+            }
+            // the rest of the tape for multi-part programs and loaders reading more blocks
+            uint8_t* tail = (uint8_t*) malloc(job->file_size);
+            const int tail_size = tail ? cbmtape_tail(job->file_data, (int)job->file_size, tape_end, tail, (int)job->file_size) : 0;
+            if ((tail_size > 0) && c64_insert_tape(&job->c64, tail, tail_size)) {
+                c64_tape_play(&job->c64);
+            }
+            free(tail);
+            input = input ? input : "RUN\n";
+        }
+        else if (c64job_has_ext(desc->file, "tap")) {
+            if (!c64_insert_tape(&job->c64, job->file_data, (int)job->file_size)) {
+                return "failed to insert tape";
+            }
+            c64_tape_play(&job->c64);
+            input = input ? input : "LOAD\n";
+        }
+        else {
+            if (!c64_quickload(&job->c64, job->file_data, (int)job->file_size)) {
+                return "failed to load file";
+            }
+            input = input ? input : "RUN\n";
+        }
+    }
+    if (input) {
+        keybuf_put(input);
+    }
+    job->armed = true;
+    return 0;
+}
+
+// run until a stop condition is met
+static c64job_stop_t c64job_run(c64job_t* job) {
+    c64job_cur = job;
+    while (job->stop == C64JOB_STOP_NONE) {
+        c64job_frame(job);
+        c64job_check_stop(job);
+    }
+    return job->stop;
+}
+
+// true if the stop reason counts as success (the cycle limit only if it's the only condition)
+static bool c64job_success(const c64job_t* job) {
+    const bool only_cycles = !job->desc.stop_pc_enabled && !job->desc.stop_text && !job->desc.stop_mem_enabled;
+    return (job->stop != C64JOB_STOP_CYCLES) || only_cycles;
+}
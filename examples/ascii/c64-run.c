@@ -0,0 +1,239 @@
+/*
+    c64-run.c
+
+    Headless C64 for scripted runs (e.g. in CI): loads a program, types
+    input, runs unthrottled until a stop condition is met and dumps the
+    results. No window, audio or terminal handling.
+
+    Args (key=value, like the sokol front-ends):
+
+        file=prog.prg       .prg/.bin via quickload (typed RUN), .tap via
+                            the tape drive (typed LOAD)
+        input=text          text to type after loading (instead of RUN/LOAD)
+        tape=fast           load standard KERNAL tapes instantly (typed RUN)
+        stop-pc=E5CD        stop when the CPU fetches an opcode at this address
+        stop-text=READY.    stop when the screen contains this text
+        stop-mem=D020:06    stop when memory at address holds value
+        max-cycles=N        cycle limit after loading (default: 60 emulated seconds)
+        screen=yes          print the screen text at exit
+        mem=0400:07E7,...   hex dump memory ranges at exit (inclusive)
+        png=out.png         write the display as PNG at exit
+
+    Exit codes:
+
+        0   a stop condition was met (or the cycle limit if it's the only one)
+        1   the cycle limit was reached first
+        2   bad arguments or the file couldn't be loaded
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#define SOKOL_IMPL
+#include "sokol_args.h"
+#define CHIPS_IMPL
+#include "chips/m6502.h"
+#include "chips/m6526.h"
+#include "chips/m6569.h"
+#include "chips/m6581.h"
+#include "chips/beeper.h"
+#include "chips/kbd.h"
+#include "chips/mem.h"
+#include "chips/clk.h"
+#include "systems/c1530.h"
+#include "chips/m6522.h"
+#include "systems/c1541.h"
+#include "systems/c64.h"
+#include "c64-roms.h"
+#define COMMON_IMPL
+#include "../common/keybuf.h"
+#include "../common/inflate.h"
+#include "../common/cbmtape.h"
+#include "c64-job.h"
+
+static c64job_t job;
+static c64job_desc_t desc;
+
+// write the display as RGBA8 PNG with uncompressed deflate blocks
+static uint32_t png_adler32(uint32_t adler, const uint8_t* ptr, size_t num_bytes) {
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    for (size_t i = 0; i < num_bytes; i++) {
+        a = (a + ptr[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+static void png_put_u32(uint8_t* dst, uint32_t v) {
+    dst[0] = v >> 24; dst[1] = (v >> 16) & 0xFF; dst[2] = (v >> 8) & 0xFF; dst[3] = v & 0xFF;
+}
+
+static void png_chunk(FILE* fp, const char* type, const uint8_t* data, uint32_t size) {
+    uint8_t hdr[8];
+    png_put_u32(hdr, size);
+    memcpy(&hdr[4], type, 4);
+    fwrite(hdr, 8, 1, fp);
+    if (size > 0) {
+        fwrite(data, size, 1, fp);
+    }
+    uint32_t crc = inflate_crc32(0, &hdr[4], 4);
+    crc = inflate_crc32(crc, data, size);
+    uint8_t crc_bytes[4];
+    png_put_u32(crc_bytes, crc);
+    fwrite(crc_bytes, 4, 1, fp);
+}
+
+static bool write_png(const char* path) {
+    const int w = c64_display_width(&job.c64);
+    const int h = c64_display_height(&job.c64);
+    // raw scanlines, each with a filter-type byte
+    const size_t row_size = 1 + (size_t)w * 4;
+    const size_t raw_size = row_size * h;
+    uint8_t* raw = (uint8_t*) malloc(raw_size);
+    // zlib stream: header, stored blocks of up to 65535 bytes, adler32
+    const size_t num_blocks = (raw_size + 65534) / 65535;
+    const size_t zlib_size = 2 + num_blocks * 5 + raw_size + 4;
+    uint8_t* zlib = (uint8_t*) malloc(zlib_size);
+    FILE* fp = fopen(path, "wb");
+    if (!raw || !zlib || !fp) {
+        free(raw);
+        free(zlib);
+        if (fp) {
+            fclose(fp);
+        }
+        fprintf(stderr, "c64-run: failed to write '%s'\n", path);
+        return false;
+    }
+    for (int y = 0; y < h; y++) {
+        raw[y * row_size] = 0;
+        // RGBA8 with R in the lowest byte is the PNG byte order on little endian
+        memcpy(&raw[y * row_size + 1], &job.pixels[y * w], (size_t)w * 4);
+    }
+    size_t pos = 0;
+    zlib[pos++] = 0x78;
+    zlib[pos++] = 0x01;
+    for (size_t src = 0; src < raw_size; src += 65535) {
+        const size_t len = ((raw_size - src) < 65535) ? (raw_size - src) : 65535;
+        zlib[pos++] = ((src + len) == raw_size) ? 1 : 0;
+        zlib[pos++] = len & 0xFF;
+        zlib[pos++] = (len >> 8) & 0xFF;
+        zlib[pos++] = ~len & 0xFF;
+        zlib[pos++] = (~len >> 8) & 0xFF;
+        memcpy(&zlib[pos], &raw[src], len);
+        pos += len;
+    }
+    png_put_u32(&zlib[pos], png_adler32(1, raw, raw_size));
+    pos += 4;
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(signature, 8, 1, fp);
+    uint8_t ihdr[13];
+    png_put_u32(&ihdr[0], (uint32_t)w);
+    png_put_u32(&ihdr[4], (uint32_t)h);
+    ihdr[8] = 8;    // bits per channel
+    ihdr[9] = 6;    // RGBA
+    ihdr[10] = 0;   // deflate
+    ihdr[11] = 0;   // adaptive filtering
+    ihdr[12] = 0;   // no interlace
+    png_chunk(fp, "IHDR", ihdr, sizeof(ihdr));
+    png_chunk(fp, "IDAT", zlib, (uint32_t)pos);
+    png_chunk(fp, "IEND", 0, 0);
+    fclose(fp);
+    free(raw);
+    free(zlib);
+    return true;
+}
+
+// dump comma-separated inclusive hex ranges like 0400:07E7,D000:D02E
+static bool dump_mem(const char* ranges) {
+    const char* p = ranges;
+    while (*p) {
+        char* end;
+        const unsigned long first = strtoul(p, &end, 16);
+        if (*end != ':') {
+            return false;
+        }
+        const unsigned long last = strtoul(end + 1, &end, 16);
+        if ((first > last) || (last > 0xFFFF)) {
+            return false;
+        }
+        for (unsigned long addr = first; addr <= last; addr += 16) {
+            printf("%04lX:", addr);
+            for (unsigned long i = addr; (i < addr + 16) && (i <= last); i++) {
+                printf(" %02X", mem_rd(&job.c64.mem_cpu, (uint16_t)i));
+            }
+            printf("\n");
+        }
+        p = (*end == ',') ? end + 1 : end;
+        if ((*end != ',') && (*end != 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parse_args(void) {
+    if (sargs_exists("file")) {
+        desc.file = sargs_value("file");
+    }
+    if (sargs_exists("input")) {
+        desc.input = sargs_value("input");
+    }
+    desc.fast_tape = sargs_equals("tape", "fast");
+    if (sargs_exists("stop-pc")) {
+        desc.stop_pc_enabled = true;
+        desc.stop_pc = (uint16_t) strtoul(sargs_value("stop-pc"), 0, 16);
+    }
+    if (sargs_exists("stop-text")) {
+        desc.stop_text = sargs_value("stop-text");
+    }
+    if (sargs_exists("stop-mem")) {
+        char* end;
+        const unsigned long addr = strtoul(sargs_value("stop-mem"), &end, 16);
+        if ((*end != ':') || (addr > 0xFFFF)) {
+            fprintf(stderr, "c64-run: stop-mem expects addr:value in hex\n");
+            return false;
+        }
+        desc.stop_mem_enabled = true;
+        desc.stop_mem_addr = (uint16_t) addr;
+        desc.stop_mem_val = (uint8_t) strtoul(end + 1, 0, 16);
+    }
+    if (sargs_exists("max-cycles")) {
+        desc.max_cycles = strtoull(sargs_value("max-cycles"), 0, 10);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    sargs_setup(&(sargs_desc){ .argc=argc, .argv=argv });
+    if (!parse_args()) {
+        return 2;
+    }
+    c64job_init(&job, desc.file && c64job_has_ext(desc.file, "tap"));
+    const char* err = c64job_start(&job, &desc);
+    if (err) {
+        fprintf(stderr, "c64-run: %s: %s\n", desc.file, err);
+        return 2;
+    }
+    c64job_run(&job);
+    fprintf(stderr, "c64-run: stop=%s cycles=%llu pc=%04X\n",
+        c64job_stop_name(job.stop), (unsigned long long)job.cycles, m6502_pc(&job.c64.cpu));
+
+    int exit_code = c64job_success(&job) ? 0 : 1;
+    if (sargs_exists("screen")) {
+        char buf[C64JOB_SCREEN_TEXT_SIZE];
+        c64job_screen_text(&job, buf);
+        fputs(buf, stdout);
+    }
+    if (sargs_exists("mem") && !dump_mem(sargs_value("mem"))) {
+        fprintf(stderr, "c64-run: mem expects first:last hex ranges separated by commas\n");
+        exit_code = 2;
+    }
+    if (sargs_exists("png") && !write_png(sargs_value("png"))) {
+        exit_code = 2;
+    }
+    c64job_discard(&job);
+    sargs_shutdown();
+    return exit_code;
+}
@@ -42,6 +42,12 @@ static void catch_sigint(int signo) {
     quit_requested = 1;
 }
 
+// fast paste: CAOS has taken the last key code (key-ready bit 0 of the
+// keyboard flags at IX+8, with IX=01F0h)
+static bool keybuf_ready(void) {
+    return 0 == (mem_rd(&kc85.mem, 0x01F8) & 1);
+}
+
 // xterm-color256 color codes mapped to KC85 colors, don't use the colors
 // below 16 as those a most likely mapped by color themes
 static int background_colors[8] = {
@@ -88,7 +94,7 @@ static void init_kc_colors(void) {
 
 int main(int argc, char* argv[]) {
     sargs_setup(&(sargs_desc){ .argc=argc, .argv=argv });
-    keybuf_init(&(keybuf_desc_t){ .key_delay_frames = 10 });
+    keybuf_init(&(keybuf_desc_t){ .key_delay_frames = 3, .ready_cb = keybuf_ready });
 
     // initialize a KC85/4 emulator instance, we don't need audio
     // or video output, so don't provide a pixel buffer and
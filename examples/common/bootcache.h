@@ -0,0 +1,154 @@
+#pragma once
+/*
+    Boot-state cache: skip the cold boot on startup.
+
+    After a cold boot has run long enough to reach the BASIC/OS prompt, the
+    system state is written with snapshot.h to [system]-boot-[key].snp in
+    the current directory. The key is a hash of the freshly initialized
+    system in the position-independent snapshot format, which covers the
+    ROM images, the system type and the configuration from the command
+    line. The snapshot header adds the build id. Later launches with the
+    same key restore the cached state in app_init(), and media is loaded
+    right away instead of after the boot delay.
+
+    Usage:
+
+        xxx_init(&sys, ...);
+        snapshot_init(...);
+        bootcache_init(&(bootcache_desc_t){ .system = "xxx", .boot_frames = 180, ... });
+
+        // once per emulated frame, after the system has been executed
+        bootcache_frame(frame_time_us);
+
+        // load media when the system is ready
+        if (fs_ptr() && bootcache_ready()) { ... }
+
+    The mode is meant to come from the "bootcache" command line arg:
+
+        bootcache=on    restore and write the cache (default)
+        bootcache=off   always cold boot
+
+    The cache is always off on the web platform. Include after snapshot.h.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char* system;         // system name for the cache file, e.g. "c64"
+    uint32_t boot_frames;       // 60 Hz frames until a cold boot shows the prompt
+    const char* mode;           // "on" (default) or "off"
+} bootcache_desc_t;
+
+// setup after snapshot_init(), restores the cached boot state if there is one
+void bootcache_init(const bootcache_desc_t* desc);
+// call once per emulated frame, writes the cache when a cold boot is done
+void bootcache_frame(uint32_t frame_time_us);
+// true once the system is booted (right away when restored from the cache)
+bool bootcache_ready(void);
+// true if the boot state was restored from the cache
+bool bootcache_restored(void);
+// the cache file name, empty when the cache is off
+const char* bootcache_path(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*== IMPLEMENTATION ==========================================================*/
+#ifdef COMMON_IMPL
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+// 'ready' is set on the emulator thread and read by file loading on the render
+// thread (see emuthread.h), which runs inline on Windows and the web
+#if defined(__GNUC__) || defined(__clang__)
+#define _BOOTCACHE_SET_READY() __atomic_store_n(&bootcache.ready, true, __ATOMIC_RELEASE)
+#define _BOOTCACHE_READY() __atomic_load_n(&bootcache.ready, __ATOMIC_ACQUIRE)
+#else
+#define _BOOTCACHE_SET_READY() (bootcache.ready = true)
+#define _BOOTCACHE_READY() (bootcache.ready)
+#endif
+
+typedef struct {
+    bool valid;
+    bool enabled;
+    bool ready;
+    bool restored;
+    uint64_t boot_time_us;
+    uint64_t time_us;
+    char path[64];
+} bootcache_state_t;
+static bootcache_state_t bootcache;
+
+// FNV-1a over the snapshot of the freshly initialized system
+static uint64_t bootcache_key(void) {
+    const size_t size = snapshot_write(0, 0);
+    uint8_t* buf = (uint8_t*) malloc(size);
+    if (!buf || (0 == snapshot_write(buf, size))) {
+        free(buf);
+        return 0;
+    }
+    uint64_t hash = 0xCBF29CE484222325;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ buf[i]) * 0x100000001B3;
+    }
+    free(buf);
+    return hash;
+}
+
+void bootcache_init(const bootcache_desc_t* desc) {
+    assert(desc && desc->system);
+    memset(&bootcache, 0, sizeof(bootcache));
+    bootcache.valid = true;
+    bootcache.boot_time_us = (uint64_t)desc->boot_frames * 16667;
+    #if defined(__EMSCRIPTEN__)
+    bootcache.enabled = false;
+    #else
+    bootcache.enabled = !(desc->mode && (0 == strcmp(desc->mode, "off")));
+    #endif
+    if (bootcache.enabled) {
+        const uint64_t key = bootcache_key();
+        bootcache.enabled = (0 != key);
+        snprintf(bootcache.path, sizeof(bootcache.path), "%s-boot-%016llx.snp", desc->system, (unsigned long long)key);
+    }
+    if (bootcache.enabled && snapshot_load_file(bootcache.path)) {
+        bootcache.ready = true;
+        bootcache.restored = true;
+    }
+}
+
+void bootcache_frame(uint32_t frame_time_us) {
+    assert(bootcache.valid);
+    if (bootcache.ready) {
+        return;
+    }
+    bootcache.time_us += frame_time_us;
+    if (bootcache.time_us >= bootcache.boot_time_us) {
+        if (bootcache.enabled && !snapshot_save_file(bootcache.path)) {
+            printf("bootcache: failed to write '%s'\n", bootcache.path);
+        }
+        _BOOTCACHE_SET_READY();
+    }
+}
+
+bool bootcache_ready(void) {
+    assert(bootcache.valid);
+    return _BOOTCACHE_READY();
+}
+
+bool bootcache_restored(void) {
+    assert(bootcache.valid);
+    return bootcache.restored;
+}
+
+const char* bootcache_path(void) {
+    assert(bootcache.valid);
+    return bootcache.path;
+}
+#endif /* COMMON_IMPL */
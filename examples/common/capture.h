@@ -0,0 +1,449 @@
+#pragma once
+/*
+    Video and audio capture to Y4M/WAV files.
+
+    Call capture_video() exactly once per emulated frame and capture_audio()
+    with the samples generated for that frame, the output then follows
+    emulated time (fixed frame rate, no dropped or duplicated frames) no
+    matter how fast or slow the emulation runs on the host. Hosts should
+    run unthrottled with a fixed frame step while capture_active().
+
+    File writes and the RGBA8 to YUV420 conversion happen on a background
+    thread, fed through a small ring of buffers. When the writer falls
+    behind, capture_video() blocks instead of dropping frames.
+
+    Used by the SDL shim (examples/sokol/sokol_hal.c), which hooks it into
+    gfx_draw() and saudio_push(). It's not part of the common lib.
+*/
+typedef struct {
+    const char* video_path;     // Y4M output file, or NULL
+    const char* audio_path;     // WAV output file, or NULL
+    int fps;                    // emulated frames per second (default: 60)
+} capture_desc_t;
+
+// start capturing, does nothing if neither path is set
+void capture_init(const capture_desc_t* desc);
+// flush pending data, finalize file headers and stop capturing
+void capture_shutdown(void);
+// true between capture_init() with a valid path and capture_shutdown()
+bool capture_active(void);
+// emulated time per frame in seconds
+double capture_frame_duration(void);
+// queue an RGBA8 frame (optionally rotated 90 degrees clockwise)
+void capture_video(const uint32_t* pixels, int width, int height, bool rot90);
+// queue interleaved float samples
+void capture_audio(const float* samples, int num_frames, int num_channels, int sample_rate);
+
+/*== IMPLEMENTATION ==========================================================*/
+#ifdef COMMON_IMPL
+#include <stdio.h>
+#include <stdlib.h> // malloc/free
+#include <string.h>
+#include <assert.h>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define _CAPTURE_SSE2 (1)
+#endif
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#define _CAPTURE_THREADS (1)
+#endif
+
+#define CAPTURE_NUM_BUFFERS (2)
+#define CAPTURE_MAX_AUDIO_SAMPLES (16 * 1024)
+
+typedef struct {
+    int width;          // 0 if the buffer carries no video frame
+    int height;
+    bool rot90;
+    uint32_t* pixels;
+    int num_audio_samples;
+    int16_t audio[CAPTURE_MAX_AUDIO_SAMPLES];
+} capture_buffer_t;
+
+typedef struct {
+    bool valid;
+    int fps;
+    FILE* video_file;
+    FILE* audio_file;
+    // video format, fixed by the first frame
+    int width;
+    int height;
+    int src_width;
+    int src_height;
+    uint8_t* yuv;
+    uint32_t* rotated;
+    // audio format, fixed by the first audio packet
+    int sample_rate;
+    int num_channels;
+    uint32_t audio_bytes;
+    // stats
+    uint32_t num_frames;
+    uint32_t num_skipped;
+    uint32_t num_stalls;
+    // emulator fills buffers[fill], writer drains buffers[drain]
+    int fill;
+    int drain;
+    bool full[CAPTURE_NUM_BUFFERS];
+    capture_buffer_t* buffers;
+    #ifdef _CAPTURE_THREADS
+    bool threaded;
+    bool quit;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    #endif
+} capture_state_t;
+static capture_state_t capt;
+
+static void _capture_put_u16(uint8_t* dst, uint16_t v) {
+    dst[0] = v & 0xFF; dst[1] = v >> 8;
+}
+
+static void _capture_put_u32(uint8_t* dst, uint32_t v) {
+    dst[0] = v & 0xFF; dst[1] = (v >> 8) & 0xFF; dst[2] = (v >> 16) & 0xFF; dst[3] = v >> 24;
+}
+
+// 16-bit PCM WAV header, sizes are patched in capture_shutdown()
+static void _capture_write_wav_header(uint32_t data_bytes) {
+    uint8_t hdr[44];
+    memcpy(&hdr[0], "RIFF", 4);
+    _capture_put_u32(&hdr[4], 36 + data_bytes);
+    memcpy(&hdr[8], "WAVEfmt ", 8);
+    _capture_put_u32(&hdr[16], 16);
+    _capture_put_u16(&hdr[20], 1);
+    _capture_put_u16(&hdr[22], (uint16_t)capt.num_channels);
+    _capture_put_u32(&hdr[24], (uint32_t)capt.sample_rate);
+    _capture_put_u32(&hdr[28], (uint32_t)(capt.sample_rate * capt.num_channels * 2));
+    _capture_put_u16(&hdr[32], (uint16_t)(capt.num_channels * 2));
+    _capture_put_u16(&hdr[34], 16);
+    memcpy(&hdr[36], "data", 4);
+    _capture_put_u32(&hdr[40], data_bytes);
+    fwrite(hdr, sizeof(hdr), 1, capt.audio_file);
+}
+
+/* BT.601 limited range, pixels are RGBA8 (R in the lowest byte):
+    Y = ((66*R + 129*G + 25*B + 128) >> 8) + 16
+    U = ((-38*R - 74*G + 112*B + 128) >> 8) + 128
+    V = ((112*R - 94*G - 18*B + 128) >> 8) + 128
+   chroma is taken from the average of each 2x2 block (C420jpeg siting)
+*/
+static inline uint8_t _capture_y(uint32_t p) {
+    int r = p & 0xFF, g = (p >> 8) & 0xFF, b = (p >> 16) & 0xFF;
+    return (uint8_t)(((66*r + 129*g + 25*b + 128) >> 8) + 16);
+}
+
+static void _capture_chroma(uint32_t p0, uint32_t p1, uint32_t p2, uint32_t p3, uint8_t* u, uint8_t* v) {
+    int r = ((p0 & 0xFF) + (p1 & 0xFF) + (p2 & 0xFF) + (p3 & 0xFF) + 2) >> 2;
+    int g = (((p0 >> 8) & 0xFF) + ((p1 >> 8) & 0xFF) + ((p2 >> 8) & 0xFF) + ((p3 >> 8) & 0xFF) + 2) >> 2;
+    int b = (((p0 >> 16) & 0xFF) + ((p1 >> 16) & 0xFF) + ((p2 >> 16) & 0xFF) + ((p3 >> 16) & 0xFF) + 2) >> 2;
+    *u = (uint8_t)(((-38*r - 74*g + 112*b + 128) >> 8) + 128);
+    *v = (uint8_t)(((112*r - 94*g - 18*b + 128) >> 8) + 128);
+}
+
+#ifdef _CAPTURE_SSE2
+// split 8 RGBA8 pixels into 16-bit R, G and B lanes
+static inline void _capture_unpack_sse2(const uint32_t* src, __m128i* r, __m128i* g, __m128i* b) {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    const __m128i p0 = _mm_loadu_si128((const __m128i*)src);
+    const __m128i p1 = _mm_loadu_si128((const __m128i*)(src + 4));
+    *r = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+    *g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    *b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+}
+
+// the weighted sum stays below 65536, so a logical shift gives the exact result
+static inline __m128i _capture_y_sse2(__m128i r, __m128i g, __m128i b) {
+    __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+    y = _mm_add_epi16(y, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+    return _mm_add_epi16(_mm_srli_epi16(y, 8), _mm_set1_epi16(16));
+}
+
+// sum horizontal pixel pairs of two 8-pixel rows into 4 32-bit lanes
+static inline __m128i _capture_sum2x2_sse2(__m128i row0, __m128i row1) {
+    return _mm_madd_epi16(_mm_add_epi16(row0, row1), _mm_set1_epi16(1));
+}
+
+// chroma weights keep every intermediate within signed 16 bits
+static inline __m128i _capture_uv_sse2(__m128i r, __m128i g, __m128i b, short wr, short wg, short wb) {
+    __m128i c = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(wr)), _mm_mullo_epi16(g, _mm_set1_epi16(wg)));
+    c = _mm_add_epi16(c, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(wb)), _mm_set1_epi16(128)));
+    return _mm_add_epi16(_mm_srai_epi16(c, 8), _mm_set1_epi16(128));
+}
+
+// convert 16x2 pixels into 32 luma and 8+8 chroma values
+static void _capture_yuv_block_sse2(const uint32_t* src0, const uint32_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v) {
+    __m128i r[2][2], g[2][2], b[2][2];
+    for (int row = 0; row < 2; row++) {
+        const uint32_t* src = row ? src1 : src0;
+        _capture_unpack_sse2(src, &r[row][0], &g[row][0], &b[row][0]);
+        _capture_unpack_sse2(src + 8, &r[row][1], &g[row][1], &b[row][1]);
+        __m128i ylo = _capture_y_sse2(r[row][0], g[row][0], b[row][0]);
+        __m128i yhi = _capture_y_sse2(r[row][1], g[row][1], b[row][1]);
+        _mm_storeu_si128((__m128i*)(row ? y1 : y0), _mm_packus_epi16(ylo, yhi));
+    }
+    const __m128i round = _mm_set1_epi16(2);
+    __m128i ra = _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(_capture_sum2x2_sse2(r[0][0], r[1][0]), _capture_sum2x2_sse2(r[0][1], r[1][1])), round), 2);
+    __m128i ga = _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(_capture_sum2x2_sse2(g[0][0], g[1][0]), _capture_sum2x2_sse2(g[0][1], g[1][1])), round), 2);
+    __m128i ba = _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(_capture_sum2x2_sse2(b[0][0], b[1][0]), _capture_sum2x2_sse2(b[0][1], b[1][1])), round), 2);
+    __m128i uu = _capture_uv_sse2(ra, ga, ba, -38, -74, 112);
+    __m128i vv = _capture_uv_sse2(ra, ga, ba, 112, -94, -18);
+    _mm_storel_epi64((__m128i*)u, _mm_packus_epi16(uu, uu));
+    _mm_storel_epi64((__m128i*)v, _mm_packus_epi16(vv, vv));
+}
+#endif
+
+// convert an RGBA8 image into planar YUV420, odd edges replicate the last pixel
+static void _capture_rgba8_to_yuv420(const uint32_t* src, int width, int height, uint8_t* dst) {
+    const int cw = (width + 1) / 2;
+    const int ch = (height + 1) / 2;
+    uint8_t* dst_y = dst;
+    uint8_t* dst_u = dst + width * height;
+    uint8_t* dst_v = dst_u + cw * ch;
+    for (int cy = 0; cy < ch; cy++) {
+        const int y0 = cy * 2;
+        const int y1 = (y0 + 1 < height) ? y0 + 1 : y0;
+        const uint32_t* row0 = src + y0 * width;
+        const uint32_t* row1 = src + y1 * width;
+        uint8_t* out_y0 = dst_y + y0 * width;
+        uint8_t* out_y1 = dst_y + y1 * width;
+        uint8_t* out_u = dst_u + cy * cw;
+        uint8_t* out_v = dst_v + cy * cw;
+        int x = 0;
+        #ifdef _CAPTURE_SSE2
+        for (; x + 16 <= width; x += 16) {
+            _capture_yuv_block_sse2(row0 + x, row1 + x, out_y0 + x, out_y1 + x, out_u + x/2, out_v + x/2);
+        }
+        #endif
+        for (; x < width; x += 2) {
+            const int x1 = (x + 1 < width) ? x + 1 : x;
+            out_y0[x] = _capture_y(row0[x]);
+            out_y0[x1] = _capture_y(row0[x1]);
+            out_y1[x] = _capture_y(row1[x]);
+            out_y1[x1] = _capture_y(row1[x1]);
+            _capture_chroma(row0[x], row0[x1], row1[x], row1[x1], &out_u[x/2], &out_v[x/2]);
+        }
+    }
+}
+
+static void _capture_write_buffer(capture_buffer_t* buf) {
+    if (buf->width > 0) {
+        const uint32_t* pixels = buf->pixels;
+        if (buf->rot90) {
+            // same orientation as the display: source row h-1-x becomes column x
+            for (int x = 0; x < buf->height; x++) {
+                const uint32_t* src = buf->pixels + (buf->height - 1 - x) * buf->width;
+                for (int y = 0; y < buf->width; y++) {
+                    capt.rotated[y * buf->height + x] = src[y];
+                }
+            }
+            pixels = capt.rotated;
+        }
+        _capture_rgba8_to_yuv420(pixels, capt.width, capt.height, capt.yuv);
+        const size_t yuv_size = (size_t)capt.width * capt.height + 2 * (size_t)((capt.width + 1) / 2) * ((capt.height + 1) / 2);
+        fputs("FRAME\n", capt.video_file);
+        fwrite(capt.yuv, yuv_size, 1, capt.video_file);
+    }
+    if (buf->num_audio_samples > 0) {
+        fwrite(buf->audio, sizeof(int16_t), buf->num_audio_samples, capt.audio_file);
+        capt.audio_bytes += buf->num_audio_samples * sizeof(int16_t);
+    }
+    buf->width = 0;
+    buf->num_audio_samples = 0;
+}
+
+#ifdef _CAPTURE_THREADS
+static void* _capture_thread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&capt.mutex);
+    for (;;) {
+        while (!capt.full[capt.drain] && !capt.quit) {
+            pthread_cond_wait(&capt.cond, &capt.mutex);
+        }
+        if (!capt.full[capt.drain]) {
+            break;  // quit requested and everything written
+        }
+        capture_buffer_t* buf = &capt.buffers[capt.drain];
+        pthread_mutex_unlock(&capt.mutex);
+        _capture_write_buffer(buf);
+        pthread_mutex_lock(&capt.mutex);
+        capt.full[capt.drain] = false;
+        capt.drain = (capt.drain + 1) % CAPTURE_NUM_BUFFERS;
+        pthread_cond_broadcast(&capt.cond);
+    }
+    pthread_mutex_unlock(&capt.mutex);
+    return 0;
+}
+#endif
+
+// hand the current buffer to the writer and wait for the next one to be free
+static void _capture_submit(void) {
+    #ifdef _CAPTURE_THREADS
+    if (capt.threaded) {
+        pthread_mutex_lock(&capt.mutex);
+        capt.full[capt.fill] = true;
+        capt.fill = (capt.fill + 1) % CAPTURE_NUM_BUFFERS;
+        pthread_cond_broadcast(&capt.cond);
+        if (capt.full[capt.fill]) {
+            capt.num_stalls++;
+            while (capt.full[capt.fill]) {
+                pthread_cond_wait(&capt.cond, &capt.mutex);
+            }
+        }
+        pthread_mutex_unlock(&capt.mutex);
+        return;
+    }
+    #endif
+    _capture_write_buffer(&capt.buffers[capt.fill]);
+}
+
+void capture_init(const capture_desc_t* desc) {
+    assert(desc);
+    memset(&capt, 0, sizeof(capt));
+    if (!desc->video_path && !desc->audio_path) {
+        return;
+    }
+    capt.fps = desc->fps > 0 ? desc->fps : 60;
+    if (desc->video_path) {
+        capt.video_file = fopen(desc->video_path, "wb");
+        if (!capt.video_file) {
+            fprintf(stderr, "capture: failed to open '%s'\n", desc->video_path);
+        }
+    }
+    if (desc->audio_path) {
+        capt.audio_file = fopen(desc->audio_path, "wb");
+        if (!capt.audio_file) {
+            fprintf(stderr, "capture: failed to open '%s'\n", desc->audio_path);
+        }
+    }
+    if (!capt.video_file && !capt.audio_file) {
+        return;
+    }
+    capt.buffers = calloc(CAPTURE_NUM_BUFFERS, sizeof(capture_buffer_t));
+    assert(capt.buffers);
+    #ifdef _CAPTURE_THREADS
+    pthread_mutex_init(&capt.mutex, 0);
+    pthread_cond_init(&capt.cond, 0);
+    capt.threaded = (0 == pthread_create(&capt.thread, 0, _capture_thread, 0));
+    #endif
+    capt.valid = true;
+}
+
+bool capture_active(void) {
+    return capt.valid;
+}
+
+double capture_frame_duration(void) {
+    assert(capt.valid);
+    return 1.0 / capt.fps;
+}
+
+void capture_video(const uint32_t* pixels, int width, int height, bool rot90) {
+    if (!capt.valid || !capt.video_file) {
+        return;
+    }
+    assert(pixels && (width > 0) && (height > 0));
+    if (0 == capt.num_frames + capt.num_skipped) {
+        // first frame fixes the stream format
+        capt.src_width = width;
+        capt.src_height = height;
+        capt.width = rot90 ? height : width;
+        capt.height = rot90 ? width : height;
+        const size_t num_pixels = (size_t)width * height;
+        for (int i = 0; i < CAPTURE_NUM_BUFFERS; i++) {
+            capt.buffers[i].pixels = malloc(num_pixels * sizeof(uint32_t));
+            assert(capt.buffers[i].pixels);
+        }
+        capt.rotated = malloc(num_pixels * sizeof(uint32_t));
+        capt.yuv = malloc(num_pixels + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2));
+        assert(capt.rotated && capt.yuv);
+        fprintf(capt.video_file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", capt.width, capt.height, capt.fps);
+    }
+    else if ((width != capt.src_width) || (height != capt.src_height)) {
+        // Y4M streams have a fixed size, frames of any other size are skipped
+        capt.num_skipped++;
+        return;
+    }
+    capture_buffer_t* buf = &capt.buffers[capt.fill];
+    memcpy(buf->pixels, pixels, (size_t)width * height * sizeof(uint32_t));
+    buf->width = width;
+    buf->height = height;
+    buf->rot90 = rot90;
+    capt.num_frames++;
+    _capture_submit();
+}
+
+void capture_audio(const float* samples, int num_frames, int num_channels, int sample_rate) {
+    if (!capt.valid || !capt.audio_file) {
+        return;
+    }
+    assert(samples && (num_channels > 0));
+    if (0 == capt.sample_rate) {
+        capt.sample_rate = sample_rate;
+        capt.num_channels = num_channels;
+        _capture_write_wav_header(0);
+    }
+    assert((sample_rate == capt.sample_rate) && (num_channels == capt.num_channels));
+    int num_samples = num_frames * num_channels;
+    while (num_samples > 0) {
+        capture_buffer_t* buf = &capt.buffers[capt.fill];
+        int n = CAPTURE_MAX_AUDIO_SAMPLES - buf->num_audio_samples;
+        if (n > num_samples) {
+            n = num_samples;
+        }
+        int16_t* dst = &buf->audio[buf->num_audio_samples];
+        for (int i = 0; i < n; i++) {
+            float s = samples[i] * 32767.0f;
+            dst[i] = (int16_t)(s > 32767.0f ? 32767.0f : (s < -32768.0f ? -32768.0f : s));
+        }
+        buf->num_audio_samples += n;
+        samples += n;
+        num_samples -= n;
+        if (buf->num_audio_samples == CAPTURE_MAX_AUDIO_SAMPLES) {
+            _capture_submit();
+        }
+    }
+}
+
+void capture_shutdown(void) {
+    if (!capt.valid) {
+        return;
+    }
+    capture_buffer_t* buf = &capt.buffers[capt.fill];
+    if ((buf->width > 0) || (buf->num_audio_samples > 0)) {
+        _capture_submit();
+    }
+    #ifdef _CAPTURE_THREADS
+    if (capt.threaded) {
+        pthread_mutex_lock(&capt.mutex);
+        capt.quit = true;
+        pthread_cond_broadcast(&capt.cond);
+        pthread_mutex_unlock(&capt.mutex);
+        pthread_join(capt.thread, 0);
+    }
+    pthread_cond_destroy(&capt.cond);
+    pthread_mutex_destroy(&capt.mutex);
+    #endif
+    if (capt.video_file) {
+        fclose(capt.video_file);
+    }
+    if (capt.audio_file) {
+        if (capt.sample_rate > 0) {
+            fseek(capt.audio_file, 0, SEEK_SET);
+            _capture_write_wav_header(capt.audio_bytes);
+        }
+        fclose(capt.audio_file);
+    }
+    printf("capture: %u frames (%u skipped), %.2fs audio, writer stalled %u times\n",
+        capt.num_frames, capt.num_skipped,
+        capt.sample_rate ? (double)capt.audio_bytes / (2.0 * capt.num_channels * capt.sample_rate) : 0.0,
+        capt.num_stalls);
+    for (int i = 0; i < CAPTURE_NUM_BUFFERS; i++) {
+        free(capt.buffers[i].pixels);
+    }
+    free(capt.buffers);
+    free(capt.rotated);
+    free(capt.yuv);
+    memset(&capt, 0, sizeof(capt));
+}
+#endif /* COMMON_IMPL */
@@ -0,0 +1,283 @@
+#pragma once
+/*
+    Decode Commodore .tap images in the standard KERNAL tape format into
+    a .prg, for instant tape loading in the C64 and VIC-20 front-ends.
+
+    A .tap file is a list of pulse lengths. The KERNAL writes each block
+    as a leader of short pulses followed by bytes, where every byte is a
+    long-medium marker, 8 data bits (short-medium is 0, medium-short is 1,
+    LSB first) and an odd parity bit. A block starts with a countdown of 9
+    sync bytes ($89..$81 for the first copy, $09..$01 for the repeat) and
+    ends with an XOR checksum and a long-short end marker. A program is a
+    192-byte header block (type, start and end address, name) followed by
+    the data block.
+
+    The pulse lengths are classified relative to the short pulse (the
+    shortest frequent one), so this works with C64 and VIC-20 timing
+    alike. Only the first program on the tape is decoded. The front-ends
+    insert the rest of the tape (see cbmtape_tail()) into the tape drive,
+    so that multi-part programs and loaders which read further blocks
+    find their data. Tapes with a turbo loader in the first program don't
+    decode at all, and the front-ends fall back to the cycle-accurate
+    tape drive.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+    Decode the first program on a .tap image into .prg format (2-byte load
+    address followed by the data). A relocatable program (header type 1)
+    is moved to reloc_addr unless reloc_addr is 0, like the KERNAL does
+    for LOAD without secondary address (pass the BASIC start from the
+    TXTTAB pointer at $2B/$2C). Returns the .prg size, or 0 if the tape
+    doesn't hold a program in the standard format or prg is too small.
+    The optional tap_end receives the offset in the .tap right after the
+    program (after the repeat of its data block).
+*/
+int cbmtape_to_prg(const uint8_t* tap, int tap_size, uint16_t reloc_addr, uint8_t* prg, int max_prg_size, int* tap_end);
+/*
+    Write a .tap image with the pulses from offset tap_pos on (as returned
+    in tap_end above) to out. Returns the image size, or 0 if no pulses
+    are left or out is too small (tap_size bytes are always enough).
+*/
+int cbmtape_tail(const uint8_t* tap, int tap_size, int tap_pos, uint8_t* out, int max_out_size);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*== IMPLEMENTATION ==========================================================*/
+#ifdef COMMON_IMPL
+#include <string.h>
+#include <stdlib.h>
+
+#define CBMTAPE_HEADER_SIZE (20)
+#define CBMTAPE_SYNC_SIZE (9)
+#define CBMTAPE_HEADER_BLOCK_SIZE (192)
+
+typedef enum {
+    CBMTAPE_PAUSE,
+    CBMTAPE_SHORT,
+    CBMTAPE_MEDIUM,
+    CBMTAPE_LONG,
+} _cbmtape_pulse_t;
+
+/* pulse lengths in units of 8 cycles, pauses are clamped to 255, and the offset of each pulse in the .tap */
+static int _cbmtape_pulses(const uint8_t* tap, int tap_size, uint8_t* out, int* offsets) {
+    const int version = tap[12];
+    int num = 0;
+    int pos = CBMTAPE_HEADER_SIZE;
+    while (pos < tap_size) {
+        offsets[num] = pos;
+        uint8_t len = tap[pos++];
+        if (len == 0) {
+            /* version 0: an overflow, version 1: followed by a 24-bit cycle count */
+            if (version == 1) {
+                pos += 3;
+            }
+            len = 255;
+        }
+        out[num++] = len;
+    }
+    return num;
+}
+
+/* read a byte starting with the long-medium marker, returns -1 on error */
+static int _cbmtape_read_byte(const uint8_t* cls, int num, int* pos) {
+    int i = *pos;
+    if ((i + 20) > num) {
+        return -1;
+    }
+    if ((cls[i] != CBMTAPE_LONG) || (cls[i+1] != CBMTAPE_MEDIUM)) {
+        return -1;
+    }
+    i += 2;
+    int byte = 0;
+    int parity = 1;
+    for (int bit = 0; bit < 9; bit++, i += 2) {
+        int val;
+        if ((cls[i] == CBMTAPE_SHORT) && (cls[i+1] == CBMTAPE_MEDIUM)) {
+            val = 0;
+        }
+        else if ((cls[i] == CBMTAPE_MEDIUM) && (cls[i+1] == CBMTAPE_SHORT)) {
+            val = 1;
+        }
+        else {
+            return -1;
+        }
+        if (bit < 8) {
+            byte |= val << bit;
+            parity ^= val;
+        }
+        else if (val != parity) {
+            return -1;
+        }
+    }
+    *pos = i;
+    return byte;
+}
+
+/*
+    Read the next block into buf (without sync bytes and checksum), returns
+    the payload size or -1 at the end of the tape. Blocks with read errors
+    or a bad checksum are skipped.
+*/
+static int _cbmtape_read_block(const uint8_t* cls, int num, int* pos, uint8_t* buf, int max_size) {
+    while (*pos < (num - 1)) {
+        /* find the first byte marker */
+        if ((cls[*pos] != CBMTAPE_LONG) || (cls[*pos + 1] != CBMTAPE_MEDIUM)) {
+            (*pos)++;
+            continue;
+        }
+        int size = 0;
+        int byte;
+        bool ok = true;
+        while ((byte = _cbmtape_read_byte(cls, num, pos)) >= 0) {
+            if (size < (max_size + CBMTAPE_SYNC_SIZE + 1)) {
+                buf[size] = (uint8_t) byte;
+            }
+            else {
+                ok = false;
+            }
+            size++;
+        }
+        if (!ok || (size < (CBMTAPE_SYNC_SIZE + 1))) {
+            /* skip the broken byte and search for the next block */
+            (*pos)++;
+            continue;
+        }
+        /* the sync countdown and the checksum */
+        if ((buf[0] & 0x7F) != 0x09) {
+            (*pos)++;
+            continue;
+        }
+        const int payload = size - CBMTAPE_SYNC_SIZE - 1;
+        uint8_t check = 0;
+        for (int i = 0; i < payload; i++) {
+            check ^= buf[CBMTAPE_SYNC_SIZE + i];
+        }
+        if (check != buf[size - 1]) {
+            continue;
+        }
+        memmove(buf, buf + CBMTAPE_SYNC_SIZE, (size_t)payload);
+        return payload;
+    }
+    return -1;
+}
+
+int cbmtape_to_prg(const uint8_t* tap, int tap_size, uint16_t reloc_addr, uint8_t* prg, int max_prg_size, int* tap_end) {
+    if (tap_end) {
+        *tap_end = 0;
+    }
+    if (!tap || (tap_size <= CBMTAPE_HEADER_SIZE) || (0 != memcmp(tap, "C64-TAPE-RAW", 12)) || (tap[12] > 1)) {
+        return 0;
+    }
+    uint8_t* cls = (uint8_t*) malloc((size_t)tap_size);
+    int* offsets = (int*) malloc((size_t)tap_size * sizeof(int));
+    int num = _cbmtape_pulses(tap, tap_size, cls, offsets);
+
+    /* the short pulse is the shortest frequent one (leaders and half of each
+       bit), the medium pulse is about as frequent in long programs
+    */
+    int hist[256] = { 0 };
+    for (int i = 0; i < num; i++) {
+        hist[cls[i]]++;
+    }
+    int peak[256] = { 0 };
+    int max_peak = 0;
+    for (int i = 0x10; i < 0x80; i++) {
+        peak[i] = hist[i-1] + hist[i] + hist[i+1];
+        if (peak[i] > max_peak) {
+            max_peak = peak[i];
+        }
+    }
+    int s = 0x10;
+    for (int i = 0x10; i < 0x80; i++) {
+        if ((peak[i] > 0) && (peak[i] >= (max_peak / 4)) && (peak[i] >= peak[i+1])) {
+            s = i;
+            break;
+        }
+    }
+    /* nominal lengths are about S, 1.4*S and 1.8*S */
+    for (int i = 0; i < num; i++) {
+        const int len = cls[i] * 100;
+        if ((len < (s * 60)) || (len > (s * 220))) {
+            cls[i] = CBMTAPE_PAUSE;
+        }
+        else if (len < (s * 119)) {
+            cls[i] = CBMTAPE_SHORT;
+        }
+        else if (len < (s * 158)) {
+            cls[i] = CBMTAPE_MEDIUM;
+        }
+        else {
+            cls[i] = CBMTAPE_LONG;
+        }
+    }
+
+    uint8_t* buf = (uint8_t*) malloc(0x10000 + CBMTAPE_SYNC_SIZE + 1);
+    uint8_t header[CBMTAPE_HEADER_BLOCK_SIZE];
+    bool has_header = false;
+    int result = 0;
+    int pos = 0;
+    int size;
+    while ((size = _cbmtape_read_block(cls, num, &pos, buf, 0x10000)) >= 0) {
+        const bool is_repeat = (size == CBMTAPE_HEADER_BLOCK_SIZE) && (0 == memcmp(header, buf, sizeof(header)));
+        if (has_header && !is_repeat) {
+            const uint16_t start = (uint16_t)(header[1] | (header[2] << 8));
+            const uint16_t end = (uint16_t)(header[3] | (header[4] << 8));
+            const int len = (int)end - (int)start;
+            if ((len > 0) && (size == len)) {
+                if ((len + 2) <= max_prg_size) {
+                    const uint16_t addr = ((header[0] == 1) && (reloc_addr != 0)) ? reloc_addr : start;
+                    prg[0] = (uint8_t) addr;
+                    prg[1] = (uint8_t) (addr >> 8);
+                    memcpy(prg + 2, buf, (size_t)len);
+                    result = len + 2;
+                    /* the repeat of the data block belongs to the program too */
+                    int repeat_pos = pos;
+                    if ((len == _cbmtape_read_block(cls, num, &repeat_pos, buf, 0x10000)) && (0 == memcmp(buf, prg + 2, (size_t)len))) {
+                        pos = repeat_pos;
+                    }
+                    if (tap_end) {
+                        *tap_end = (pos < num) ? offsets[pos] : tap_size;
+                    }
+                }
+                break;
+            }
+        }
+        /* a program header, or the repeat of the current one */
+        if ((size == CBMTAPE_HEADER_BLOCK_SIZE) && ((buf[0] == 1) || (buf[0] == 3))) {
+            memcpy(header, buf, sizeof(header));
+            has_header = true;
+        }
+    }
+    free(buf);
+    free(offsets);
+    free(cls);
+    return result;
+}
+
+int cbmtape_tail(const uint8_t* tap, int tap_size, int tap_pos, uint8_t* out, int max_out_size) {
+    if (!tap || !out || (tap_pos < CBMTAPE_HEADER_SIZE) || (tap_pos >= tap_size)) {
+        return 0;
+    }
+    const int data_size = tap_size - tap_pos;
+    const int size = CBMTAPE_HEADER_SIZE + data_size;
+    if (size > max_out_size) {
+        return 0;
+    }
+    /* same header with the new data size */
+    memcpy(out, tap, CBMTAPE_HEADER_SIZE);
+    out[16] = (uint8_t) data_size;
+    out[17] = (uint8_t) (data_size >> 8);
+    out[18] = (uint8_t) (data_size >> 16);
+    out[19] = (uint8_t) (data_size >> 24);
+    memcpy(out + CBMTAPE_HEADER_SIZE, tap + tap_pos, (size_t)data_size);
+    return size;
+}
+#endif /* COMMON_IMPL */
@@ -1,21 +1,50 @@
 #pragma once
 /*
     Emulator frame timing helper functions.
+
+    Elapsed time is accumulated in nanoseconds, clock_frame_time() hands out
+    whole microseconds and carries the remainder into the next frame, and
+    clock_frame_ticks() does the same in ticks of a system clock, so the
+    emulated clock doesn't drift from the host clock over long sessions.
+
+    With clock_set_fixed_fps() every frame advances by exactly 1/fps seconds
+    regardless of the host frame duration (for deterministic headless runs).
 */
 void clock_init(void);
 uint32_t clock_frame_time(void);
+uint32_t clock_frame_ticks(uint32_t freq_hz);
 uint32_t clock_frame_count_60hz(void);
+// 0 goes back to host frame timing, survives clock_init()
+void clock_set_fixed_fps(uint32_t fps);
+
+// convert a time delta into ticks of a freq_hz clock, the sub-tick remainder
+// is carried in *frac (in units of 1/1e9 tick), usable without COMMON_IMPL
+static inline uint32_t clock_ns_to_ticks(uint64_t delta_ns, uint32_t freq_hz, uint64_t* frac) {
+    const uint64_t acc = delta_ns * freq_hz + *frac;
+    *frac = acc % 1000000000;
+    return (uint32_t) (acc / 1000000000);
+}
 
 /*== IMPLEMENTATION ==========================================================*/
 #ifdef COMMON_IMPL
 #include "sokol_app.h"
 #include <assert.h>
 
+// prevent death-spiral on host systems that are too slow to emulate
+// in real time, or during long frames (e.g. debugging)
+#define CLOCK_MAX_FRAME_NS (24000000)
+
 typedef struct {
     bool valid;
-    uint64_t cur_time;
+    uint64_t cur_time;      // microseconds handed out by clock_frame_time()
+    uint64_t elapsed_ns;    // emulated time accumulated from frame durations
+    uint64_t num_frames;
+    uint64_t tick_ns;       // elapsed_ns already converted into ticks
+    uint64_t tick_frac;     // sub-tick remainder in units of 1/1e9 tick
+    uint32_t tick_freq;
 } clock_state_t;
 static clock_state_t clck;
+static uint32_t clock_fixed_fps;
 
 void clock_init(void) {
     clck = (clock_state_t) {
@@ -24,18 +53,52 @@ void clock_init(void) {
     };
 }
 
+void clock_set_fixed_fps(uint32_t fps) {
+    clock_fixed_fps = fps;
+}
+
+// advance emulated time by one host frame
+static void clock_advance(void) {
+    clck.num_frames++;
+    if (clock_fixed_fps > 0) {
+        // exact frame boundaries, no rounding error accumulates
+        clck.elapsed_ns = (clck.num_frames * 1000000000) / clock_fixed_fps;
+    }
+    else {
+        uint64_t frame_ns = (uint64_t) (sapp_frame_duration() * 1000000000.0 + 0.5);
+        if (frame_ns > CLOCK_MAX_FRAME_NS) {
+            frame_ns = CLOCK_MAX_FRAME_NS;
+        }
+        clck.elapsed_ns += frame_ns;
+    }
+}
+
 uint32_t clock_frame_time(void) {
     assert(clck.valid);
-    uint32_t frame_time_us = (uint32_t) (sapp_frame_duration() * 1000000.0);
-    // prevent death-spiral on host systems that are too slow to emulate
-    // in real time, or during long frames (e.g. debugging)
-    if (frame_time_us > 24000) {
-        frame_time_us = 24000;
-    }
-    clck.cur_time += frame_time_us;
+    clock_advance();
+    const uint64_t now_us = clck.elapsed_ns / 1000;
+    const uint32_t frame_time_us = (uint32_t) (now_us - clck.cur_time);
+    clck.cur_time = now_us;
     return frame_time_us;
 }
 
+/* Same as clock_frame_time() but returns a tick budget for a system clock
+   running at freq_hz, call once per frame instead of clock_frame_time().
+*/
+uint32_t clock_frame_ticks(uint32_t freq_hz) {
+    assert(clck.valid && (freq_hz > 0));
+    clock_advance();
+    clck.cur_time = clck.elapsed_ns / 1000;
+    if (freq_hz != clck.tick_freq) {
+        clck.tick_freq = freq_hz;
+        clck.tick_frac = 0;
+    }
+    const uint64_t delta_ns = clck.elapsed_ns - clck.tick_ns;
+    clck.tick_ns = clck.elapsed_ns;
+    // delta_ns is at most CLOCK_MAX_FRAME_NS (or one fixed frame), so this can't overflow
+    return clock_ns_to_ticks(delta_ns, freq_hz, &clck.tick_frac);
+}
+
 uint32_t clock_frame_count_60hz(void) {
     assert(clck.valid);
     return (uint32_t) (clck.cur_time / 16667);
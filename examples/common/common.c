@@ -1,9 +1,15 @@
 #define COMMON_IMPL
 #include <stdint.h>
 #include <stdbool.h>
+#include "cbmtape.h"
 #include "clock.h"
 #include "fs.h"
 #include "gfx.h"
+#include "emuthread.h"
 #include "keybuf.h"
 #include "prof.h"
+#include "runahead.h"
+#include "snapshot.h"
+#include "bootcache.h"
+#include "warp.h"
 
@@ -5,9 +5,16 @@
 #include "sokol_args.h"
 #include "sokol_time.h"
 #include "sokol_debugtext.h"
+#include "cbmtape.h"
 #include "clock.h"
 #include "prof.h"
 #include "fs.h"
 #include "gfx.h"
+#include "emuthread.h"
 #include "keybuf.h"
+#include "runahead.h"
+#include "snapshot.h"
+#include "bootcache.h"
+#include "warp.h"
 #include <ctype.h> // isupper, islower, toupper, tolower
+#include <stdlib.h> // atoi, malloc
@@ -0,0 +1,398 @@
+#pragma once
+/*
+    Run the emulator on a dedicated worker thread.
+
+    By default the front-ends call xxx_exec() from app_frame() on the render
+    thread, so a slow gfx_draw() or ImGui frame delays emulation. With this
+    module the emulation runs on a worker thread which is paced by the audio
+    clock (it runs the next frame when the audio stream has room for its
+    samples, or by the wall clock when there is no audio device):
+
+    - finished frames are copied into a triple buffer, app_frame() picks up
+      the newest one for gfx_draw() without waiting for the emulator, the
+      frame's tick count and execution time are published with it for the
+      status bar (emuthread_ticks(), emuthread_exec_time_ms())
+    - app_input() events are forwarded through a lock-free single-producer/
+      single-consumer queue and applied on the worker between frames
+    - per-frame work on the emulator (like feeding the keyboard buffer)
+      belongs into exec_cb, so it runs on the worker
+    - code on the render thread which changes emulator state only now and
+      then (loading a file) brackets it with emuthread_pause() and
+      emuthread_resume(), which waits for the worker to finish its frame,
+      the debugger UI only pauses for frames where ui_input_pending() says
+      it may reboot, step or poke the emulator, otherwise it reads the
+      emulator state while the worker runs
+
+    Usage:
+
+        static uint32_t exec_frame(uint32_t frame_time_us) {
+            return xxx_exec(&sys, frame_time_us);
+        }
+        static void display_size(int* width, int* height) {
+            *width = xxx_display_width(&sys);
+            *height = xxx_display_height(&sys);
+        }
+        static void handle_input(const sapp_event* event) {
+            ...xxx_key_down()...
+        }
+
+        app_init():     emuthread_init(&(emuthread_desc_t){ .exec_cb=exec_frame, ... });
+        app_frame():    emuthread_frame(state.frame_time_us);
+                        gfx_draw(emuthread_display_width(), emuthread_display_height());
+        app_input():    emuthread_input(event);
+        app_cleanup():  emuthread_shutdown();
+
+    Without thread support (Windows, Emscripten), or with mode "off" (from
+    the "thread" command line arg), everything runs inline on the render
+    thread exactly as before.
+
+    Framebuffers are expected in RGBA8 format (no gfx indexed mode).
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "sokol_app.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t (*exec_cb)(uint32_t micro_seconds);    // run the emulator for a frame, returns the executed ticks
+    void (*input_cb)(const sapp_event* event);      // apply an input event to the emulator
+    void (*display_cb)(int* width, int* height);    // current emulator display size in pixels
+    const char* mode;                               // "on" (default) or "off"
+    uint32_t frame_time_us;                         // emulated time per worker frame (default 16667)
+} emuthread_desc_t;
+
+void emuthread_init(const emuthread_desc_t* desc);
+// stop the worker thread, call before discarding the emulator
+void emuthread_shutdown(void);
+// true if the emulator runs on the worker thread
+bool emuthread_threaded(void);
+// inline: run one frame, threaded: pick up the newest finished frame for gfx_draw()
+void emuthread_frame(uint32_t frame_time_us);
+// display size of the frame picked up by emuthread_frame()
+int emuthread_display_width(void);
+int emuthread_display_height(void);
+// executed ticks and host time of the frame picked up by emuthread_frame()
+uint32_t emuthread_ticks(void);
+double emuthread_exec_time_ms(void);
+// forward an input event to input_cb
+void emuthread_input(const sapp_event* event);
+// wait until the worker is between frames and keep it there, may be nested
+void emuthread_pause(void);
+void emuthread_resume(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*== IMPLEMENTATION ==========================================================*/
+#ifdef COMMON_IMPL
+#include "sokol_audio.h"    // gfx.h must be included before (for the framebuffer and draw source)
+#include "sokol_time.h"
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#define _EMUTHREAD_THREADS (1)
+#endif
+
+#define EMUTHREAD_NUM_EVENTS (64)   // must be 2^n
+#define _EMUTHREAD_FRESH (4)        // flag in the triple buffer exchange index
+
+typedef struct {
+    uint32_t* pixels;
+    size_t capacity;    // allocated size of pixels in bytes
+    int width;
+    int height;
+    uint32_t ticks;
+    double exec_time_ms;
+} emuthread_buffer_t;
+
+typedef struct {
+    bool valid;
+    uint32_t (*exec_cb)(uint32_t micro_seconds);
+    void (*input_cb)(const sapp_event* event);
+    void (*display_cb)(int* width, int* height);
+    uint32_t frame_time_us;
+    int width;
+    int height;
+    uint32_t ticks;
+    double exec_time_ms;
+    #ifdef _EMUTHREAD_THREADS
+    bool threaded;
+    pthread_t thread;
+    pthread_mutex_t lock;           // held by the worker while running a frame, or by emuthread_pause()
+    int pause_count;                // nesting of emuthread_pause(), render thread only
+    atomic_bool pause_requested;
+    atomic_bool quit;
+    // triple buffer: the worker fills 'back', the render thread reads 'front',
+    // 'ready' holds the newest finished frame (with the _EMUTHREAD_FRESH bit)
+    emuthread_buffer_t buffers[3];
+    int back;
+    int front;
+    atomic_int ready;
+    // input events, written by the render thread, read by the worker
+    sapp_event events[EMUTHREAD_NUM_EVENTS];
+    atomic_uint event_head;
+    atomic_uint event_tail;
+    #endif
+} emuthread_state_t;
+static emuthread_state_t emuthread;
+
+#ifdef _EMUTHREAD_THREADS
+static void _emuthread_sleep_us(uint32_t us) {
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = (long)us * 1000 };
+    nanosleep(&ts, 0);
+}
+
+static void _emuthread_drain_events(void) {
+    uint32_t tail = atomic_load_explicit(&emuthread.event_tail, memory_order_relaxed);
+    const uint32_t head = atomic_load_explicit(&emuthread.event_head, memory_order_acquire);
+    while (tail != head) {
+        emuthread.input_cb(&emuthread.events[tail & (EMUTHREAD_NUM_EVENTS - 1)]);
+        tail++;
+    }
+    atomic_store_explicit(&emuthread.event_tail, tail, memory_order_release);
+}
+
+// grow a buffer to hold num_bytes, only called by the buffer's current owner
+static bool _emuthread_reserve(emuthread_buffer_t* buf, size_t num_bytes) {
+    if (num_bytes > buf->capacity) {
+        uint32_t* pixels = (uint32_t*) realloc(buf->pixels, num_bytes);
+        if (!pixels) {
+            return false;
+        }
+        buf->pixels = pixels;
+        buf->capacity = num_bytes;
+    }
+    return true;
+}
+
+// copy the finished frame and its stats into the back buffer and make it the
+// newest one, the back buffer is only grown here when the display size changes
+static void _emuthread_publish(uint32_t ticks, double exec_time_ms) {
+    emuthread_buffer_t* buf = &emuthread.buffers[emuthread.back];
+    int width, height;
+    emuthread.display_cb(&width, &height);
+    const size_t num_bytes = (size_t)width * (size_t)height * sizeof(uint32_t);
+    assert(num_bytes <= gfx_framebuffer_size());
+    if (!_emuthread_reserve(buf, num_bytes)) {
+        // out of memory, skip this frame
+        return;
+    }
+    buf->width = width;
+    buf->height = height;
+    buf->ticks = ticks;
+    buf->exec_time_ms = exec_time_ms;
+    memcpy(buf->pixels, gfx_framebuffer(), num_bytes);
+    emuthread.back = atomic_exchange(&emuthread.ready, emuthread.back | _EMUTHREAD_FRESH) & 3;
+}
+
+// true if the audio stream has no room for another frame of samples yet
+static bool _emuthread_audio_full(void) {
+    const int frame_samples = (int) (((uint64_t)saudio_sample_rate() * emuthread.frame_time_us) / 1000000);
+    return saudio_expect() < frame_samples;
+}
+
+static void* _emuthread_worker(void* arg) {
+    (void)arg;
+    const bool audio_clock = saudio_isvalid();
+    uint64_t start = stm_now();
+    uint64_t emulated_us = 0;
+    while (!atomic_load(&emuthread.quit)) {
+        if (atomic_load(&emuthread.pause_requested)) {
+            _emuthread_sleep_us(100);
+            continue;
+        }
+        if (audio_clock) {
+            if (_emuthread_audio_full()) {
+                _emuthread_sleep_us(1000);
+                continue;
+            }
+        }
+        else {
+            const uint64_t host_us = (uint64_t) stm_us(stm_since(start));
+            if (host_us < emulated_us) {
+                _emuthread_sleep_us(1000);
+                continue;
+            }
+            if (host_us > (emulated_us + 100000)) {
+                // too far behind (or was paused), don't try to catch up
+                emulated_us = host_us;
+            }
+            emulated_us += emuthread.frame_time_us;
+        }
+        pthread_mutex_lock(&emuthread.lock);
+        _emuthread_drain_events();
+        const uint64_t exec_start = stm_now();
+        const uint32_t ticks = emuthread.exec_cb(emuthread.frame_time_us);
+        _emuthread_publish(ticks, stm_ms(stm_since(exec_start)));
+        pthread_mutex_unlock(&emuthread.lock);
+    }
+    return 0;
+}
+#endif
+
+static void _emuthread_display_size(void) {
+    emuthread.display_cb(&emuthread.width, &emuthread.height);
+}
+
+void emuthread_init(const emuthread_desc_t* desc) {
+    assert(desc && desc->exec_cb && desc->input_cb && desc->display_cb);
+    memset(&emuthread, 0, sizeof(emuthread));
+    emuthread.valid = true;
+    emuthread.exec_cb = desc->exec_cb;
+    emuthread.input_cb = desc->input_cb;
+    emuthread.display_cb = desc->display_cb;
+    emuthread.frame_time_us = desc->frame_time_us ? desc->frame_time_us : 16667;
+    _emuthread_display_size();
+    #ifdef _EMUTHREAD_THREADS
+    if (desc->mode && (0 == strcmp(desc->mode, "off"))) {
+        return;
+    }
+    // sized for the current display, _emuthread_publish() grows them if needed
+    const size_t num_bytes = (size_t)emuthread.width * (size_t)emuthread.height * sizeof(uint32_t);
+    for (int i = 0; i < 3; i++) {
+        emuthread.buffers[i].pixels = (uint32_t*) calloc(1, num_bytes ? num_bytes : sizeof(uint32_t));
+        assert(emuthread.buffers[i].pixels);
+        emuthread.buffers[i].capacity = num_bytes;
+        emuthread.buffers[i].width = emuthread.width;
+        emuthread.buffers[i].height = emuthread.height;
+    }
+    emuthread.back = 0;
+    atomic_init(&emuthread.ready, 1);
+    emuthread.front = 2;
+    atomic_init(&emuthread.pause_requested, false);
+    atomic_init(&emuthread.quit, false);
+    atomic_init(&emuthread.event_head, 0);
+    atomic_init(&emuthread.event_tail, 0);
+    pthread_mutex_init(&emuthread.lock, 0);
+    emuthread.threaded = (0 == pthread_create(&emuthread.thread, 0, _emuthread_worker, 0));
+    if (!emuthread.threaded) {
+        for (int i = 0; i < 3; i++) {
+            free(emuthread.buffers[i].pixels);
+            emuthread.buffers[i].pixels = 0;
+            emuthread.buffers[i].capacity = 0;
+        }
+        pthread_mutex_destroy(&emuthread.lock);
+    }
+    #endif
+}
+
+void emuthread_shutdown(void) {
+    assert(emuthread.valid);
+    #ifdef _EMUTHREAD_THREADS
+    if (emuthread.threaded) {
+        atomic_store(&emuthread.quit, true);
+        pthread_join(emuthread.thread, 0);
+        pthread_mutex_destroy(&emuthread.lock);
+        gfx_set_draw_source(0);
+        for (int i = 0; i < 3; i++) {
+            free(emuthread.buffers[i].pixels);
+            emuthread.buffers[i].pixels = 0;
+            emuthread.buffers[i].capacity = 0;
+        }
+        emuthread.threaded = false;
+    }
+    #endif
+    emuthread.valid = false;
+}
+
+bool emuthread_threaded(void) {
+    #ifdef _EMUTHREAD_THREADS
+    return emuthread.valid && emuthread.threaded;
+    #else
+    return false;
+    #endif
+}
+
+void emuthread_frame(uint32_t frame_time_us) {
+    assert(emuthread.valid);
+    #ifdef _EMUTHREAD_THREADS
+    if (emuthread.threaded) {
+        if (atomic_load(&emuthread.ready) & _EMUTHREAD_FRESH) {
+            emuthread.front = atomic_exchange(&emuthread.ready, emuthread.front) & 3;
+        }
+        const emuthread_buffer_t* buf = &emuthread.buffers[emuthread.front];
+        emuthread.width = buf->width;
+        emuthread.height = buf->height;
+        emuthread.ticks = buf->ticks;
+        emuthread.exec_time_ms = buf->exec_time_ms;
+        gfx_set_draw_source(buf->pixels);
+        return;
+    }
+    #endif
+    const uint64_t exec_start = stm_now();
+    emuthread.ticks = emuthread.exec_cb(frame_time_us);
+    emuthread.exec_time_ms = stm_ms(stm_since(exec_start));
+    _emuthread_display_size();
+}
+
+int emuthread_display_width(void) {
+    return emuthread.width;
+}
+
+int emuthread_display_height(void) {
+    return emuthread.height;
+}
+
+uint32_t emuthread_ticks(void) {
+    return emuthread.ticks;
+}
+
+double emuthread_exec_time_ms(void) {
+    return emuthread.exec_time_ms;
+}
+
+void emuthread_input(const sapp_event* event) {
+    assert(emuthread.valid && event);
+    #ifdef _EMUTHREAD_THREADS
+    if (emuthread.threaded) {
+        const uint32_t head = atomic_load_explicit(&emuthread.event_head, memory_order_relaxed);
+        const uint32_t tail = atomic_load_explicit(&emuthread.event_tail, memory_order_acquire);
+        if ((head - tail) < EMUTHREAD_NUM_EVENTS) {
+            emuthread.events[head & (EMUTHREAD_NUM_EVENTS - 1)] = *event;
+            atomic_store_explicit(&emuthread.event_head, head + 1, memory_order_release);
+        }
+        else {
+            // queue is full, apply the event directly instead of dropping it
+            emuthread_pause();
+            _emuthread_drain_events();
+            emuthread.input_cb(event);
+            emuthread_resume();
+        }
+        return;
+    }
+    #endif
+    emuthread.input_cb(event);
+}
+
+void emuthread_pause(void) {
+    assert(emuthread.valid);
+    #ifdef _EMUTHREAD_THREADS
+    if (emuthread.threaded && (0 == emuthread.pause_count++)) {
+        atomic_store(&emuthread.pause_requested, true);
+        pthread_mutex_lock(&emuthread.lock);
+    }
+    #endif
+}
+
+void emuthread_resume(void) {
+    assert(emuthread.valid);
+    #ifdef _EMUTHREAD_THREADS
+    if (emuthread.threaded) {
+        assert(emuthread.pause_count > 0);
+        if (0 == --emuthread.pause_count) {
+            pthread_mutex_unlock(&emuthread.lock);
+            atomic_store(&emuthread.pause_requested, false);
+        }
+    }
+    #endif
+}
+
+#endif /* COMMON_IMPL */
@@ -1,6 +1,25 @@
 #pragma once
 /*
     Simple file access functions.
+
+    On native POSIX platforms fs_start_load_file() maps the file read-only
+    into memory and completes immediately, there's no size limit and no copy,
+    the mapping is released in fs_reset(). Everywhere else (Emscripten,
+    Windows, dropped files in the browser, base64 and memory loads) data goes
+    through a FS_MAX_SIZE buffer which is only allocated on first use.
+
+    In both cases the data is followed by a zero byte, so text files can be
+    used as C strings.
+
+    Compressed files (.gz, .zip and raw .deflate) are decompressed with
+    inflate.h in fs_dowork(), a limited amount per call so that large
+    files don't stall a frame. fs_ptr() stays null until the data is
+    complete, fs_filename() and fs_ext() then refer to the file inside the
+    archive (the gzip name field, the first file in a zip, or the file name
+    without the .gz suffix).
+
+    If loading or decompressing fails, fs_failed() returns true until the
+    next fs_reset() or load, so front-ends can report the error.
 */
 void fs_init(void);
 void fs_dowork(void);
@@ -10,21 +29,46 @@ bool fs_load_base64(const char* name, const char* payload);
 void fs_load_mem(const char* path, const uint8_t* ptr, uint32_t size);
 uint32_t fs_size(void);
 const uint8_t* fs_ptr(void);
+bool fs_failed(void);
 void fs_reset(void);
 bool fs_ext(const char* str);
 const char* fs_filename(void);
 
 /*== IMPLEMENTATION ==========================================================*/
 #ifdef COMMON_IMPL
+#include "inflate.h"
 #include "sokol_fetch.h"
 #include "sokol_app.h"
 #include <string.h>
 #include <assert.h>
 #include <ctype.h>
+#include <stdlib.h>
+#if !defined(__EMSCRIPTEN__) && !defined(_WIN32)
+#define FS_USE_MMAP (1)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#define FS_USE_MMAP (0)
+#endif
 
 #define FS_EXT_SIZE (16)
 #define FS_FNAME_SIZE (32)
 #define FS_MAX_SIZE (1024 * 1024)
+#define FS_UNPACK_CHUNK_SIZE (1024 * 1024)  // decompressed bytes per fs_dowork()
+
+// decompression in progress
+typedef struct {
+    bool active;
+    inflate_t inf;
+    uint8_t* buf;           // decompressed data, followed by a zero byte
+    size_t buf_size;        // capacity without the zero byte
+    bool check;             // crc and size are known
+    uint32_t expected_crc;
+    uint32_t expected_size;
+    uint32_t crc;
+} fs_unpack_t;
 
 typedef struct {
     bool valid;
@@ -32,11 +76,20 @@ typedef struct {
     char ext[FS_EXT_SIZE];
     uint8_t* ptr;
     uint32_t size;
-    uint8_t buf[FS_MAX_SIZE + 1];
+    bool failed;            // the last load or decompression failed
+    uint8_t* buf;           // FS_MAX_SIZE + 1 bytes, allocated on first use
+    #if FS_USE_MMAP
+    void* map_ptr;          // current file mapping, or 0
+    size_t map_size;
+    #endif
+    fs_unpack_t unpack;
 } fs_state_t;
 static fs_state_t fs;
 
 void fs_init(void) {
+    if (fs.buf) {
+        free(fs.buf);
+    }
     memset(&fs, 0, sizeof(fs));
     fs.valid = true;
     sfetch_setup(&(sfetch_desc_t){
@@ -46,9 +99,22 @@ void fs_init(void) {
     });
 }
 
+static void fs_unpack_dowork(void);
+
 void fs_dowork(void) {
     assert(fs.valid);
     sfetch_dowork();
+    if (fs.unpack.active) {
+        fs_unpack_dowork();
+    }
+}
+
+static uint8_t* fs_buffer(void) {
+    if (!fs.buf) {
+        fs.buf = (uint8_t*) malloc(FS_MAX_SIZE + 1);
+        assert(fs.buf);
+    }
+    return fs.buf;
 }
 
 static void fs_strcpy(char* dst, const char* src, size_t buf_size) {
@@ -107,9 +173,10 @@ static bool fs_base64_decode(const char* src) {
 
     // output length
     int olen = (count / 4) * 3;
-    if (olen >= (int)sizeof(fs.buf)) {
+    if (olen > FS_MAX_SIZE) {
         return false;
     }
+    uint8_t* buf = fs_buffer();
 
     // decode loop
     count = 0;
@@ -127,9 +194,9 @@ static bool fs_base64_decode(const char* src) {
         count++;
         if (count == 4) {
             count = 0;
-            fs.buf[fs.size++] = (block[0] << 2) | (block[1] >> 4);
-            fs.buf[fs.size++] = (block[1] << 4) | (block[2] >> 2);
-            fs.buf[fs.size++] = (block[2] << 6) | block[3];
+            buf[fs.size++] = (block[0] << 2) | (block[1] >> 4);
+            buf[fs.size++] = (block[1] << 4) | (block[2] >> 2);
+            buf[fs.size++] = (block[2] << 6) | block[3];
             if (pad > 0) {
                 if (pad <= 2) {
                     fs.size -= pad;
@@ -156,8 +223,249 @@ const char* fs_filename(void) {
 
 void fs_reset(void) {
     assert(fs.valid);
+    #if FS_USE_MMAP
+    if (fs.map_ptr) {
+        munmap(fs.map_ptr, fs.map_size);
+        fs.map_ptr = 0;
+        fs.map_size = 0;
+    }
+    #endif
+    if (fs.unpack.buf) {
+        free(fs.unpack.buf);
+    }
+    memset(&fs.unpack, 0, sizeof(fs.unpack));
     fs.ptr = 0;
     fs.size = 0;
+    fs.failed = false;
+}
+
+static void fs_fail(void) {
+    fs_reset();
+    fs.failed = true;
+}
+
+static uint16_t fs_rd16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t fs_rd32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool fs_unpack_alloc(size_t size) {
+    fs.unpack.buf = (uint8_t*) malloc(size + 1);
+    if (!fs.unpack.buf) {
+        return false;
+    }
+    fs.unpack.buf_size = size;
+    return true;
+}
+
+static void fs_unpack_start(const uint8_t* src, size_t src_size, size_t dst_size) {
+    if (dst_size == 0) {
+        // size unknown, start with a guess and grow as needed
+        dst_size = (src_size * 4) + (64 * 1024);
+    }
+    if (fs_unpack_alloc(dst_size)) {
+        inflate_init(&fs.unpack.inf, src, src_size, fs.unpack.buf, fs.unpack.buf_size);
+        fs.unpack.active = true;
+    }
+}
+
+// strip the last extension from the current filename (foo.tap.gz => foo.tap)
+static void fs_strip_ext(void) {
+    char name[FS_FNAME_SIZE];
+    memcpy(name, fs.fname, sizeof(name));
+    char* dot = strrchr(name, '.');
+    if (dot) {
+        *dot = 0;
+    }
+    fs_copy_filename_and_ext(name);
+}
+
+/* gzip (RFC 1952), only the first member is decompressed */
+static bool fs_start_gzip(const uint8_t* ptr, uint32_t size) {
+    if ((size < 18) || (ptr[0] != 0x1F) || (ptr[1] != 0x8B) || (ptr[2] != 8)) {
+        return false;
+    }
+    const uint8_t flags = ptr[3];
+    uint32_t pos = 10;
+    if (flags & 4) {    // FEXTRA
+        pos += 2 + fs_rd16(ptr + pos);
+        if (pos >= size) {
+            return false;
+        }
+    }
+    const char* name = 0;
+    if (flags & 8) {    // FNAME
+        name = (const char*)ptr + pos;
+        while ((pos < size) && ptr[pos]) {
+            pos++;
+        }
+        pos++;
+    }
+    if (flags & 16) {   // FCOMMENT
+        while ((pos < size) && ptr[pos]) {
+            pos++;
+        }
+        pos++;
+    }
+    if (flags & 2) {    // FHCRC
+        pos += 2;
+    }
+    if ((pos + 8) > size) {
+        return false;
+    }
+    if (name && name[0]) {
+        fs_copy_filename_and_ext(name);
+    }
+    else {
+        fs_strip_ext();
+    }
+    fs.unpack.check = true;
+    fs.unpack.expected_crc = fs_rd32(ptr + size - 8);
+    fs.unpack.expected_size = fs_rd32(ptr + size - 4);
+    fs_unpack_start(ptr + pos, size - 8 - pos, fs.unpack.expected_size);
+    return fs.unpack.active;
+}
+
+/* check the decompressed data, and replace the compressed data with it */
+static bool fs_unpack_finish(uint32_t size) {
+    fs_unpack_t* u = &fs.unpack;
+    if (u->check && ((u->crc != u->expected_crc) || (size != u->expected_size))) {
+        return false;
+    }
+    uint8_t* buf = u->buf;
+    u->buf = 0;
+    fs_reset();
+    buf[size] = 0;
+    fs.ptr = buf;
+    fs.size = size;
+    fs.unpack.buf = buf;
+    return true;
+}
+
+/* zip, the first stored or deflated file in the central directory is used */
+static bool fs_start_zip(const uint8_t* ptr, uint32_t size) {
+    // find the end of central directory record, followed by a comment of up to 64 KB
+    if (size < 22) {
+        return false;
+    }
+    uint32_t eocd = size - 22;
+    while ((fs_rd32(ptr + eocd) != 0x06054B50) && (eocd > 0) && ((size - eocd) < (22 + 0xFFFF))) {
+        eocd--;
+    }
+    if (fs_rd32(ptr + eocd) != 0x06054B50) {
+        return false;
+    }
+    const uint32_t num_entries = fs_rd16(ptr + eocd + 10);
+    uint32_t pos = fs_rd32(ptr + eocd + 16);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        if (((pos + 46) > size) || (fs_rd32(ptr + pos) != 0x02014B50)) {
+            return false;
+        }
+        const uint16_t flags = fs_rd16(ptr + pos + 8);
+        const uint16_t method = fs_rd16(ptr + pos + 10);
+        const uint32_t crc = fs_rd32(ptr + pos + 16);
+        const uint32_t packed_size = fs_rd32(ptr + pos + 20);
+        const uint32_t unpacked_size = fs_rd32(ptr + pos + 24);
+        const uint16_t name_len = fs_rd16(ptr + pos + 28);
+        const uint32_t entry_len = 46 + name_len + fs_rd16(ptr + pos + 30) + fs_rd16(ptr + pos + 32);
+        const uint32_t local = fs_rd32(ptr + pos + 42);
+        if ((pos + 46 + name_len) > size) {
+            return false;
+        }
+        const char* name = (const char*)ptr + pos + 46;
+        const bool is_dir = (name_len == 0) || (name[name_len - 1] == '/');
+        // skip directories, encrypted entries and unsupported methods
+        if (!is_dir && !(flags & 1) && ((method == 0) || (method == 8))) {
+            if (((local + 30) > size) || (fs_rd32(ptr + local) != 0x04034B50)) {
+                return false;
+            }
+            const uint32_t data = local + 30 + fs_rd16(ptr + local + 26) + fs_rd16(ptr + local + 28);
+            if ((data > size) || (packed_size > (size - data))) {
+                return false;
+            }
+            char fname[FS_FNAME_SIZE * 2];
+            const uint32_t len = (name_len < sizeof(fname)) ? name_len : (uint32_t)(sizeof(fname) - 1);
+            memcpy(fname, name, len);
+            fname[len] = 0;
+            fs_copy_filename_and_ext(fname);
+            fs.unpack.check = true;
+            fs.unpack.expected_crc = crc;
+            fs.unpack.expected_size = unpacked_size;
+            if (method == 0) {
+                // stored, copy right away and let fs_dowork() finish up
+                if ((packed_size != unpacked_size) || !fs_unpack_alloc(unpacked_size)) {
+                    return false;
+                }
+                memcpy(fs.unpack.buf, ptr + data, unpacked_size);
+                fs.unpack.crc = inflate_crc32(0, fs.unpack.buf, unpacked_size);
+                return fs_unpack_finish(unpacked_size);
+            }
+            else {
+                fs_unpack_start(ptr + data, packed_size, unpacked_size);
+            }
+            return fs.unpack.active;
+        }
+        pos += entry_len;
+    }
+    return false;
+}
+
+/* called when the file data is complete, starts decompression if needed */
+static void fs_loaded(uint8_t* ptr, uint32_t size) {
+    bool compressed = true;
+    bool started = false;
+    if (fs_ext("gz")) {
+        started = fs_start_gzip(ptr, size);
+    }
+    else if (fs_ext("zip")) {
+        started = fs_start_zip(ptr, size);
+    }
+    else if (fs_ext("deflate")) {
+        fs_strip_ext();
+        fs_unpack_start(ptr, size, 0);
+        started = fs.unpack.active;
+    }
+    else {
+        compressed = false;
+    }
+    if (!compressed) {
+        fs.ptr = ptr;
+        fs.size = size;
+    }
+    else if (!started) {
+        fs_fail();
+    }
+}
+
+static void fs_unpack_dowork(void) {
+    fs_unpack_t* u = &fs.unpack;
+    const size_t start_pos = u->inf.dst_pos;
+    inflate_status_t res = inflate_run(&u->inf, FS_UNPACK_CHUNK_SIZE);
+    u->crc = inflate_crc32(u->crc, u->buf + start_pos, u->inf.dst_pos - start_pos);
+    if (res == INFLATE_STATUS_FULL) {
+        // unknown or wrong size in the header, grow the output buffer
+        const size_t new_size = u->buf_size * 2;
+        uint8_t* new_buf = (new_size < UINT32_MAX) ? (uint8_t*) realloc(u->buf, new_size + 1) : 0;
+        if (!new_buf) {
+            res = INFLATE_STATUS_ERROR;
+        }
+        else {
+            u->buf = new_buf;
+            u->buf_size = new_size;
+            inflate_set_output(&u->inf, u->buf, u->buf_size);
+            return;
+        }
+    }
+    if (res == INFLATE_STATUS_MORE) {
+        return;
+    }
+    if ((res == INFLATE_STATUS_DONE) && fs_unpack_finish((uint32_t) u->inf.dst_pos)) {
+        return;
+    }
+    fs_fail();
 }
 
 void fs_load_mem(const char* path, const uint8_t* ptr, uint32_t size) {
@@ -165,11 +473,11 @@ void fs_load_mem(const char* path, const uint8_t* ptr, uint32_t size) {
     fs_reset();
     if ((size > 0) && (size <= FS_MAX_SIZE)) {
         fs_copy_filename_and_ext(path);
-        fs.size = size;
-        fs.ptr = fs.buf;
-        memcpy(fs.ptr, ptr, size);
+        uint8_t* buf = fs_buffer();
+        memcpy(buf, ptr, size);
         /* zero-terminate in case this is a text file */
-        fs.ptr[fs.size] = 0;
+        buf[size] = 0;
+        fs_loaded(buf, size);
     }
 }
 
@@ -178,7 +486,10 @@ bool fs_load_base64(const char* name, const char* payload) {
     fs_reset();
     fs_copy_filename_and_ext(name);
     if (fs_base64_decode(payload)) {
-        fs.ptr = fs.buf;
+        const uint32_t size = fs.size;
+        fs.size = 0;
+        fs.buf[size] = 0;
+        fs_loaded(fs.buf, size);
         return true;
     }
     else {
@@ -189,25 +500,65 @@ bool fs_load_base64(const char* name, const char* payload) {
 static void fs_fetch_callback(const sfetch_response_t* response) {
     assert(fs.valid);
     if (response->fetched) {
-        fs.ptr = fs.buf;
-        fs.size = response->fetched_size;
-        assert(fs.size < sizeof(fs.buf));
+        const uint32_t size = response->fetched_size;
+        assert(size <= FS_MAX_SIZE);
         // in case it's a text file, zero-terminate the data
-        fs.buf[fs.size] = 0;
+        fs.buf[size] = 0;
+        fs_loaded(fs.buf, size);
+    }
+    else if (response->failed) {
+        fs_fail();
     }
-    // FIXME: signal failure
 }
 
 #if defined(__EMSCRIPTEN__)
 static void fs_emsc_dropped_file_callback(const sapp_html5_fetch_response* response) {
     if (response->succeeded) {
-        fs.ptr = fs.buf;
-        fs.size = response->fetched_size;
-        assert(fs.size < sizeof(fs.buf));
+        const uint32_t size = response->fetched_size;
+        assert(size <= FS_MAX_SIZE);
         // in case it's a text file, zero-terminate the data
-        fs.buf[fs.size] = 0;
+        fs.buf[size] = 0;
+        fs_loaded(fs.buf, size);
+    }
+    else {
+        fs_fail();
+    }
+}
+#endif
+
+#if FS_USE_MMAP
+/* Map a file read-only, followed by at least one zero byte: an anonymous
+   zero-filled mapping one byte larger than the file is reserved first,
+   and the file is mapped over its start.
+*/
+static bool fs_map_file(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode) || (st.st_size <= 0) || (st.st_size >= (off_t)UINT32_MAX)) {
+        close(fd);
+        return false;
+    }
+    const size_t size = (size_t) st.st_size;
+    const size_t map_size = size + 1;
+    uint8_t* ptr = (uint8_t*) mmap(0, map_size, PROT_READ, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    if (mmap(ptr, size, PROT_READ, MAP_PRIVATE|MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(ptr, map_size);
+        close(fd);
+        return false;
     }
-    // FIXME: signal failure
+    // the mapping keeps its own reference to the file
+    close(fd);
+    fs.map_ptr = ptr;
+    fs.map_size = map_size;
+    fs_loaded(ptr, (uint32_t) size);
+    return true;
 }
 #endif
 
@@ -215,10 +566,15 @@ void fs_start_load_file(const char* path) {
     assert(fs.valid);
     fs_reset();
     fs_copy_filename_and_ext(path);
+    #if FS_USE_MMAP
+    if (fs_map_file(path)) {
+        return;
+    }
+    #endif
     sfetch_send(&(sfetch_request_t){
         .path = path,
         .callback = fs_fetch_callback,
-        .buffer_ptr = fs.buf,
+        .buffer_ptr = fs_buffer(),
         .buffer_size = FS_MAX_SIZE,
     });
 }
@@ -232,7 +588,7 @@ void fs_start_load_dropped_file(void) {
         sapp_html5_fetch_dropped_file(&(sapp_html5_fetch_request){
             .dropped_file_index = 0,
             .callback = fs_emsc_dropped_file_callback,
-            .buffer_ptr = fs.buf,
+            .buffer_ptr = fs_buffer(),
             .buffer_size = FS_MAX_SIZE
         });
     #else
@@ -250,4 +606,9 @@ uint32_t fs_size(void) {
     return fs.size;
 }
 
+bool fs_failed(void) {
+    assert(fs.valid);
+    return fs.failed;
+}
+
 #endif /* COMMON_IMPL */
@@ -25,6 +25,9 @@ typedef struct {
     int emu_aspect_x;
     int emu_aspect_y;
     bool rot90;
+    bool indexed;   // framebuffer holds 8-bit palette indices, see gfx_set_palette()
+    int fb_width;   // largest emulator display in pixels, the framebuffer is allocated
+    int fb_height;  // in gfx_init() (default: GFX_MAX_FB_WIDTH x GFX_MAX_FB_HEIGHT)
     void (*draw_extra_cb)(void);
 } gfx_desc_t;
 
@@ -36,14 +39,144 @@ void gfx_shutdown(void);
 void* gfx_create_texture(int w, int h);
 void gfx_update_texture(void* h, void* data, int data_byte_size);
 void gfx_destroy_texture(void* h);
+/* request green or red flash feedback, may be called from any thread, gfx_draw() shows it */
 void gfx_flash_success(void);
 void gfx_flash_error(void);
+/* set the RGBA8 colors for indexed mode (up to 256), unused entries are black */
+void gfx_set_palette(const uint32_t* colors, int num_colors);
+/* pixels read by gfx_draw() instead of the framebuffer (same layout), 0 for the framebuffer */
+void gfx_set_draw_source(const void* pixels);
+
+/*
+    CPU-side dirty-row detection: each framebuffer row is hashed and
+    compared with the hash from the previous frame, changed rows are
+    returned as up to GFX_MAX_DIRTY_SPANS spans of consecutive rows
+    (when there are more, the last span is extended over the gaps).
+
+    gfx_draw() uses this to skip the texture upload and upscale pass when
+    nothing changed. Define GFX_DIRTY_IMPL to get the implementation
+    without the rest of gfx.h (e.g. for the SDL shim).
+*/
+#define GFX_MAX_DIRTY_SPANS (8)
+
+typedef struct {
+    int first_row;
+    int num_rows;
+} gfx_row_span_t;
+
+typedef struct {
+    bool valid;
+    int width;
+    int height;
+    int num_spans;
+    gfx_row_span_t spans[GFX_MAX_DIRTY_SPANS];
+    uint64_t row_hash[GFX_MAX_FB_HEIGHT];
+} gfx_dirty_t;
+
+/* forget the previous frame, the next update reports all rows as dirty */
+void gfx_dirty_reset(gfx_dirty_t* dirty);
+/* find changed rows in a width*height framebuffer (stride in pixels), returns number of dirty rows */
+int gfx_dirty_update(gfx_dirty_t* dirty, const uint32_t* pixels, int width, int height, int stride);
+/* same for an 8-bit indexed framebuffer */
+int gfx_dirty_update_indexed(gfx_dirty_t* dirty, const uint8_t* pixels, int width, int height, int stride);
+
+/*
+    Indexed mode: with gfx_desc_t.indexed the emulator writes one byte per
+    pixel into gfx_framebuffer() (width*height bytes, tightly packed), and
+    gfx_draw() uploads an R8 texture which the upscale shader maps through
+    a 256x1 palette texture. gfx_indexed_to_rgba8() is the CPU reference of
+    that lookup, used by the SDL shim and headless tests (strides in pixels).
+*/
+#define GFX_PALETTE_SIZE (256)
+void gfx_indexed_to_rgba8(const uint8_t* src, int src_stride, const uint32_t* palette, uint32_t* dst, int dst_stride, int width, int height);
 
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
 
 /*== IMPLEMENTATION ==========================================================*/
+#if defined(COMMON_IMPL) || defined(GFX_DIRTY_IMPL)
+#include <string.h>
+#include <assert.h>
+
+void gfx_dirty_reset(gfx_dirty_t* dirty) {
+    assert(dirty);
+    dirty->valid = false;
+    dirty->num_spans = 0;
+}
+
+/* Each step is a bijection of the hash for a given 64-bit word (the tail
+   is zero-padded, the row length is fixed), so a change in a single word
+   always changes the row hash.
+*/
+static uint64_t gfx_row_hash(const uint8_t* row, int num_bytes) {
+    uint64_t h = (uint64_t)num_bytes;
+    int x = 0;
+    for (; (x + 8) <= num_bytes; x += 8) {
+        uint64_t w;
+        memcpy(&w, row + x, sizeof(w));
+        h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+    }
+    if (x < num_bytes) {
+        uint64_t w = 0;
+        memcpy(&w, row + x, (size_t)(num_bytes - x));
+        h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+    }
+    return h ^ (h >> 32);
+}
+
+/* width and stride in bytes */
+static int gfx_dirty_update_bytes(gfx_dirty_t* dirty, const uint8_t* pixels, int width, int height, int stride) {
+    assert(dirty && pixels && (height <= GFX_MAX_FB_HEIGHT));
+    if ((width != dirty->width) || (height != dirty->height)) {
+        dirty->width = width;
+        dirty->height = height;
+        dirty->valid = false;
+    }
+    int num_dirty = 0;
+    dirty->num_spans = 0;
+    for (int y = 0; y < height; y++) {
+        const uint64_t h = gfx_row_hash(pixels + y * stride, width);
+        if (dirty->valid && (h == dirty->row_hash[y])) {
+            continue;
+        }
+        dirty->row_hash[y] = h;
+        num_dirty++;
+        gfx_row_span_t* last = dirty->num_spans > 0 ? &dirty->spans[dirty->num_spans - 1] : 0;
+        if (last && ((last->first_row + last->num_rows) == y)) {
+            last->num_rows++;
+        }
+        else if (dirty->num_spans < GFX_MAX_DIRTY_SPANS) {
+            dirty->spans[dirty->num_spans++] = (gfx_row_span_t){ .first_row = y, .num_rows = 1 };
+        }
+        else {
+            last->num_rows = y + 1 - last->first_row;
+        }
+    }
+    dirty->valid = true;
+    return num_dirty;
+}
+
+int gfx_dirty_update(gfx_dirty_t* dirty, const uint32_t* pixels, int width, int height, int stride) {
+    return gfx_dirty_update_bytes(dirty, (const uint8_t*)pixels, width * 4, height, stride * 4);
+}
+
+int gfx_dirty_update_indexed(gfx_dirty_t* dirty, const uint8_t* pixels, int width, int height, int stride) {
+    return gfx_dirty_update_bytes(dirty, pixels, width, height, stride);
+}
+
+void gfx_indexed_to_rgba8(const uint8_t* src, int src_stride, const uint32_t* palette, uint32_t* dst, int dst_stride, int width, int height) {
+    assert(src && palette && dst);
+    for (int y = 0; y < height; y++) {
+        const uint8_t* s = src + y * src_stride;
+        uint32_t* d = dst + y * dst_stride;
+        for (int x = 0; x < width; x++) {
+            d[x] = palette[s[x]];
+        }
+    }
+}
+#endif /* COMMON_IMPL || GFX_DIRTY_IMPL */
+
 #ifdef COMMON_IMPL
 
 #include "sokol_gfx.h"
@@ -55,6 +188,9 @@ void gfx_flash_error(void);
 #include "shaders.glsl.h"
 #include <assert.h>
 #include <stdlib.h> // malloc/free
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #define _GFX_DEF(v,def) (v?v:def)
 
@@ -76,10 +212,17 @@ typedef struct {
     struct {
         sg_buffer vbuf;
         sg_pipeline pip;
+        sg_pipeline pal_pip;    // with palette lookup for indexed mode
         sg_image img;
         sg_pass pass;
         sg_pass_action pass_action;
     } upscale;
+    struct {
+        bool enabled;
+        bool changed;
+        sg_image img;
+        uint32_t colors[GFX_PALETTE_SIZE];
+    } palette;
     struct {
         sg_buffer vbuf;
         sg_pipeline pip;
@@ -92,15 +235,31 @@ typedef struct {
         int width;
         int height;
     } icon;
+    long flash_request;         // GFX_FLASH_* bits, set by any thread, taken by gfx_draw()
     int flash_success_count;
     int flash_error_count;
+    gfx_dirty_t dirty;
     
-    uint32_t rgba8_buffer[GFX_MAX_FB_WIDTH * GFX_MAX_FB_HEIGHT];
+    uint32_t* rgba8_buffer;     // bytes instead of RGBA8 pixels in indexed mode
+    const void* draw_source;    // if set, drawn instead of rgba8_buffer
+    size_t rgba8_buffer_size;
+    int fb_width;
+    int fb_height;
     void (*draw_extra_cb)(void);
 } gfx_state_t;
 
 static gfx_state_t gfx;
 
+#define GFX_FLASH_SUCCESS (1)
+#define GFX_FLASH_ERROR (2)
+#if defined(_MSC_VER)
+#define _GFX_FLASH_REQUEST(bits) _InterlockedOr(&gfx.flash_request, bits)
+#define _GFX_FLASH_TAKE() _InterlockedExchange(&gfx.flash_request, 0)
+#else
+#define _GFX_FLASH_REQUEST(bits) __atomic_fetch_or(&gfx.flash_request, bits, __ATOMIC_RELEASE)
+#define _GFX_FLASH_TAKE() __atomic_exchange_n(&gfx.flash_request, 0, __ATOMIC_ACQUIRE)
+#endif
+
 static const float gfx_verts[] = {
     0.0f, 0.0f, 0.0f, 0.0f,
     1.0f, 0.0f, 1.0f, 0.0f,
@@ -192,12 +351,25 @@ static const struct {
 
 void gfx_flash_success(void) {
     assert(gfx.valid);
-    gfx.flash_success_count = 20;
+    _GFX_FLASH_REQUEST(GFX_FLASH_SUCCESS);
 }
 
 void gfx_flash_error(void) {
     assert(gfx.valid);
-    gfx.flash_error_count = 20;
+    _GFX_FLASH_REQUEST(GFX_FLASH_ERROR);
+}
+
+void gfx_set_palette(const uint32_t* colors, int num_colors) {
+    assert(gfx.valid && colors && (num_colors >= 0) && (num_colors <= GFX_PALETTE_SIZE));
+    uint32_t new_colors[GFX_PALETTE_SIZE];
+    memset(new_colors, 0, sizeof(new_colors));
+    for (int i = 0; i < num_colors; i++) {
+        new_colors[i] = colors[i] | 0xFF000000;
+    }
+    if (0 != memcmp(new_colors, gfx.palette.colors, sizeof(new_colors))) {
+        memcpy(gfx.palette.colors, new_colors, sizeof(new_colors));
+        gfx.palette.changed = true;
+    }
 }
 
 uint32_t* gfx_framebuffer(void) {
@@ -207,7 +379,12 @@ uint32_t* gfx_framebuffer(void) {
 
 size_t gfx_framebuffer_size(void) {
     assert(gfx.valid);
-    return sizeof(gfx.rgba8_buffer);
+    return gfx.rgba8_buffer_size;
+}
+
+void gfx_set_draw_source(const void* pixels) {
+    assert(gfx.valid);
+    gfx.draw_source = pixels;
 }
 
 static void gfx_init_images_and_pass(void) {
@@ -216,11 +393,11 @@ static void gfx_init_images_and_pass(void) {
     sg_destroy_image(gfx.upscale.img);
     sg_destroy_pass(gfx.upscale.pass);
 
-    // a texture with the emulator's raw pixel data
+    // a texture with the emulator's raw pixel data (palette indices in indexed mode)
     gfx.emufb.img = sg_make_image(&(sg_image_desc){
         .width = gfx.emufb.width,
         .height = gfx.emufb.height,
-        .pixel_format = SG_PIXELFORMAT_RGBA8,
+        .pixel_format = gfx.palette.enabled ? SG_PIXELFORMAT_R8 : SG_PIXELFORMAT_RGBA8,
         .usage = SG_USAGE_STREAM,
         .min_filter = SG_FILTER_NEAREST,
         .mag_filter = SG_FILTER_NEAREST,
@@ -266,6 +443,14 @@ void gfx_init(const gfx_desc_t* desc) {
     });
     
     gfx.valid = true;
+
+    // allocate the emulator framebuffer for the largest display size
+    gfx.fb_width = _GFX_DEF(desc->fb_width, GFX_MAX_FB_WIDTH);
+    gfx.fb_height = _GFX_DEF(desc->fb_height, GFX_MAX_FB_HEIGHT);
+    assert((gfx.fb_width <= GFX_MAX_FB_WIDTH) && (gfx.fb_height <= GFX_MAX_FB_HEIGHT));
+    gfx.rgba8_buffer_size = (size_t)gfx.fb_width * (size_t)gfx.fb_height * (desc->indexed ? 1 : sizeof(uint32_t));
+    gfx.rgba8_buffer = (uint32_t*) calloc(1, gfx.rgba8_buffer_size);
+    assert(gfx.rgba8_buffer);
     
     gfx.border.top = desc->border_top;
     gfx.border.bottom = desc->border_bottom;
@@ -294,6 +479,34 @@ void gfx_init(const gfx_desc_t* desc) {
         .primitive_type = SG_PRIMITIVETYPE_TRIANGLE_STRIP,
         .depth.pixel_format = SG_PIXELFORMAT_NONE
     });
+
+    // indexed mode: palette texture and upscale pipeline with palette lookup
+    gfx.palette.enabled = desc->indexed;
+    if (gfx.palette.enabled) {
+        memset(gfx.palette.colors, 0, sizeof(gfx.palette.colors));
+        gfx.palette.changed = true;
+        gfx.palette.img = sg_make_image(&(sg_image_desc){
+            .width = GFX_PALETTE_SIZE,
+            .height = 1,
+            .pixel_format = SG_PIXELFORMAT_RGBA8,
+            .usage = SG_USAGE_STREAM,
+            .min_filter = SG_FILTER_NEAREST,
+            .mag_filter = SG_FILTER_NEAREST,
+            .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+            .wrap_v = SG_WRAP_CLAMP_TO_EDGE
+        });
+        gfx.upscale.pal_pip = sg_make_pipeline(&(sg_pipeline_desc){
+            .shader = sg_make_shader(upscale_pal_shader_desc(sg_query_backend())),
+            .layout = {
+                .attrs = {
+                    [0].format = SG_VERTEXFORMAT_FLOAT2,
+                    [1].format = SG_VERTEXFORMAT_FLOAT2
+                }
+            },
+            .primitive_type = SG_PRIMITIVETYPE_TRIANGLE_STRIP,
+            .depth.pixel_format = SG_PIXELFORMAT_NONE
+        });
+    }
     
     gfx.display.pass_action = (sg_pass_action) {
         .colors[0] = { .action = SG_ACTION_CLEAR, .value = { 0.05f, 0.05f, 0.05f, 1.0f } }
@@ -412,9 +625,11 @@ void gfx_draw(int emu_width, int emu_height) {
     
     // check if emulator framebuffer size has changed, need to create new backing texture
     if ((emu_width != gfx.emufb.width) || (emu_height != gfx.emufb.height)) {
+        assert((emu_width * emu_height) <= (gfx.fb_width * gfx.fb_height));
         gfx.emufb.width = emu_width;
         gfx.emufb.height = emu_height;
         gfx_init_images_and_pass();
+        gfx_dirty_reset(&gfx.dirty);
     }
     
     // if audio is off, draw speaker icon via sokol-gl
@@ -439,25 +654,74 @@ void gfx_draw(int emu_width, int emu_height) {
         sgl_end();
     }
 
-    // copy emulator pixel data into emulator framebuffer texture
-    sg_update_image(gfx.emufb.img, &(sg_image_data){
-        .subimage[0][0] = {
-            .ptr = gfx.rgba8_buffer,
-            .size = gfx.emufb.width*gfx.emufb.height*sizeof(uint32_t)
+    // copy emulator pixel data into emulator framebuffer texture and upscale
+    // it, but only if something changed since last frame (sokol-gfx can only
+    // update whole images, so any dirty row means a full upload)
+    bool redraw;
+    const void* src = gfx.draw_source ? gfx.draw_source : gfx.rgba8_buffer;
+    if (gfx.palette.enabled) {
+        const uint8_t* pixels = (const uint8_t*) src;
+        redraw = gfx_dirty_update_indexed(&gfx.dirty, pixels, gfx.emufb.width, gfx.emufb.height, gfx.emufb.width) > 0;
+        if (redraw) {
+            sg_update_image(gfx.emufb.img, &(sg_image_data){
+                .subimage[0][0] = {
+                    .ptr = pixels,
+                    .size = gfx.emufb.width*gfx.emufb.height
+                }
+            });
         }
-    });
-    
-    // upscale the original framebuffer 2x with nearest filtering
-    sg_begin_pass(gfx.upscale.pass, &gfx.upscale.pass_action);
-    sg_apply_pipeline(gfx.upscale.pip);
-    sg_apply_bindings(&(sg_bindings){
-        .vertex_buffers[0] = gfx.upscale.vbuf,
-        .fs_images[SLOT_emufb_tex] = gfx.emufb.img,
-    });
-    sg_draw(0, 4, 1);
-    sg_end_pass();
+        if (gfx.palette.changed) {
+            gfx.palette.changed = false;
+            sg_update_image(gfx.palette.img, &(sg_image_data){
+                .subimage[0][0] = SG_RANGE(gfx.palette.colors)
+            });
+            redraw = true;
+        }
+    }
+    else {
+        const uint32_t* pixels = (const uint32_t*) src;
+        redraw = gfx_dirty_update(&gfx.dirty, pixels, gfx.emufb.width, gfx.emufb.height, gfx.emufb.width) > 0;
+        if (redraw) {
+            sg_update_image(gfx.emufb.img, &(sg_image_data){
+                .subimage[0][0] = {
+                    .ptr = pixels,
+                    .size = gfx.emufb.width*gfx.emufb.height*sizeof(uint32_t)
+                }
+            });
+        }
+    }
+    if (redraw) {
+        // upscale the original framebuffer 2x with nearest filtering
+        sg_begin_pass(gfx.upscale.pass, &gfx.upscale.pass_action);
+        if (gfx.palette.enabled) {
+            sg_apply_pipeline(gfx.upscale.pal_pip);
+            sg_apply_bindings(&(sg_bindings){
+                .vertex_buffers[0] = gfx.upscale.vbuf,
+                .fs_images = {
+                    [SLOT_emufb_tex] = gfx.emufb.img,
+                    [SLOT_pal_tex] = gfx.palette.img,
+                }
+            });
+        }
+        else {
+            sg_apply_pipeline(gfx.upscale.pip);
+            sg_apply_bindings(&(sg_bindings){
+                .vertex_buffers[0] = gfx.upscale.vbuf,
+                .fs_images[SLOT_emufb_tex] = gfx.emufb.img,
+            });
+        }
+        sg_draw(0, 4, 1);
+        sg_end_pass();
+    }
     
     // tint the clear color red or green if flash feedback is requested
+    const long flash_request = _GFX_FLASH_TAKE();
+    if (flash_request & GFX_FLASH_ERROR) {
+        gfx.flash_error_count = 20;
+    }
+    if (flash_request & GFX_FLASH_SUCCESS) {
+        gfx.flash_success_count = 20;
+    }
     if (gfx.flash_error_count > 0) {
         gfx.flash_error_count--;
         gfx.display.pass_action.colors[0].value.r = 0.7f;
@@ -495,6 +759,9 @@ void gfx_shutdown() {
     sgl_shutdown();
     sdtx_shutdown();
     sg_shutdown();
+    free(gfx.rgba8_buffer);
+    gfx.rgba8_buffer = 0;
+    gfx.draw_source = 0;
 }
 
 void* gfx_create_texture(int w, int h) {
@@ -0,0 +1,513 @@
+#pragma once
+/*
+    Dependency-free, resumable deflate decoder (RFC 1951).
+
+    The whole compressed input must be available in memory, output goes
+    into a caller provided buffer which also serves as the sliding window
+    (so no separate window and no copy). inflate_run() decodes up to a
+    given number of output bytes and returns, so decompressing a large
+    file can be spread over several frames:
+
+        inflate_t inf;
+        inflate_init(&inf, src, src_size, dst, dst_size);
+        inflate_status_t res;
+        while (INFLATE_STATUS_MORE == (res = inflate_run(&inf, 1024*1024))) {
+            ...do something else...
+        }
+
+    INFLATE_STATUS_FULL means the output buffer is too small: move the
+    output into a bigger buffer, call inflate_set_output() and continue.
+
+    Container formats (gzip, zip) are handled in fs.h.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INFLATE_FAST_BITS (10)
+
+typedef enum {
+    INFLATE_STATUS_MORE,    // output budget used up, call inflate_run() again
+    INFLATE_STATUS_DONE,    // final block decoded
+    INFLATE_STATUS_FULL,    // output buffer full, provide a bigger one
+    INFLATE_STATUS_ERROR,   // corrupt or truncated input
+} inflate_status_t;
+
+typedef struct {
+    uint16_t fast[1<<INFLATE_FAST_BITS];    // (symbol<<4)|length for short codes, 0 otherwise
+    uint16_t count[16];                     // number of codes per length
+    uint16_t symbol[288];                   // symbols in canonical order
+} inflate_huff_t;
+
+typedef struct {
+    const uint8_t* src;
+    size_t src_size;
+    size_t src_pos;
+    uint64_t bit_buf;
+    int bit_cnt;
+    uint8_t* dst;
+    size_t dst_size;
+    size_t dst_pos;
+    int state;
+    bool final_block;
+    uint32_t stored_left;
+    inflate_huff_t lit;
+    inflate_huff_t dist;
+} inflate_t;
+
+void inflate_init(inflate_t* inf, const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size);
+// replace the output buffer, the first dst_pos bytes must have been copied over
+void inflate_set_output(inflate_t* inf, uint8_t* dst, size_t dst_size);
+inflate_status_t inflate_run(inflate_t* inf, size_t max_output);
+// standard CRC-32 (as used by gzip and zip), start with crc=0
+uint32_t inflate_crc32(uint32_t crc, const uint8_t* ptr, size_t num_bytes);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*== IMPLEMENTATION ==========================================================*/
+#ifdef COMMON_IMPL
+#include <string.h>
+#include <assert.h>
+
+enum {
+    _INFLATE_STATE_HEADER,
+    _INFLATE_STATE_STORED,
+    _INFLATE_STATE_HUFF,
+    _INFLATE_STATE_DONE,
+    _INFLATE_STATE_ERROR,
+};
+
+static const uint16_t _inflate_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t _inflate_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t _inflate_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t _inflate_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+void inflate_init(inflate_t* inf, const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size) {
+    assert(inf && src);
+    memset(inf, 0, sizeof(inflate_t));
+    inf->src = src;
+    inf->src_size = src_size;
+    inf->dst = dst;
+    inf->dst_size = dst_size;
+    inf->state = _INFLATE_STATE_HEADER;
+}
+
+void inflate_set_output(inflate_t* inf, uint8_t* dst, size_t dst_size) {
+    assert(inf && (dst_size >= inf->dst_pos));
+    inf->dst = dst;
+    inf->dst_size = dst_size;
+}
+
+/* fill the bit buffer with at least 56 bits if there's enough input left */
+static inline void _inflate_refill(inflate_t* inf) {
+    #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    if ((inf->src_pos + 8) <= inf->src_size) {
+        uint64_t v;
+        memcpy(&v, inf->src + inf->src_pos, 8);
+        inf->bit_buf |= v << inf->bit_cnt;
+        inf->src_pos += (63 - inf->bit_cnt) >> 3;
+        inf->bit_cnt |= 56;
+        return;
+    }
+    #endif
+    while ((inf->bit_cnt <= 56) && (inf->src_pos < inf->src_size)) {
+        inf->bit_buf |= (uint64_t)inf->src[inf->src_pos++] << inf->bit_cnt;
+        inf->bit_cnt += 8;
+    }
+}
+
+/* read n (<= 32) bits, returns -1 if the input is exhausted */
+static inline int32_t _inflate_bits(inflate_t* inf, int n) {
+    if (inf->bit_cnt < n) {
+        _inflate_refill(inf);
+        if (inf->bit_cnt < n) {
+            return -1;
+        }
+    }
+    const int32_t val = (int32_t)(inf->bit_buf & ((1ULL << n) - 1));
+    inf->bit_buf >>= n;
+    inf->bit_cnt -= n;
+    return val;
+}
+
+/* drop partial byte and give whole buffered bytes back to the input */
+static void _inflate_align(inflate_t* inf) {
+    inf->src_pos -= (size_t)(inf->bit_cnt >> 3);
+    inf->bit_buf = 0;
+    inf->bit_cnt = 0;
+}
+
+/* build decoding tables from code lengths, returns false for invalid codes */
+static bool _inflate_build(inflate_huff_t* h, const uint8_t* lengths, int num) {
+    memset(h->count, 0, sizeof(h->count));
+    for (int i = 0; i < num; i++) {
+        h->count[lengths[i]]++;
+    }
+    // over-subscribed codes are errors, incomplete codes are allowed
+    // (e.g. a single distance code), unused entries fail in decoding
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left = (left << 1) - h->count[len];
+        if (left < 0) {
+            return false;
+        }
+    }
+    uint16_t offs[16];
+    uint16_t next_code[16];
+    offs[1] = 0;
+    next_code[1] = 0;
+    for (int len = 1; len < 15; len++) {
+        offs[len + 1] = offs[len] + h->count[len];
+        next_code[len + 1] = (uint16_t)((next_code[len] + h->count[len]) << 1);
+    }
+    memset(h->fast, 0, sizeof(h->fast));
+    for (int sym = 0; sym < num; sym++) {
+        const int len = lengths[sym];
+        if (len == 0) {
+            continue;
+        }
+        h->symbol[offs[len]++] = (uint16_t)sym;
+        const uint32_t code = next_code[len]++;
+        if (len <= INFLATE_FAST_BITS) {
+            // codes are stored MSB first, the bit buffer is LSB first
+            uint32_t rev = 0;
+            for (int i = 0; i < len; i++) {
+                rev |= ((code >> i) & 1) << (len - 1 - i);
+            }
+            const uint16_t entry = (uint16_t)((sym << 4) | len);
+            for (uint32_t i = rev; i < (1<<INFLATE_FAST_BITS); i += (1u << len)) {
+                h->fast[i] = entry;
+            }
+        }
+    }
+    return true;
+}
+
+/* decode one symbol, returns -1 on error */
+static inline int _inflate_decode(inflate_t* inf, const inflate_huff_t* h) {
+    if (inf->bit_cnt < 15) {
+        _inflate_refill(inf);
+    }
+    const uint16_t entry = h->fast[inf->bit_buf & ((1<<INFLATE_FAST_BITS) - 1)];
+    if (entry) {
+        const int len = entry & 15;
+        if (len > inf->bit_cnt) {
+            return -1;
+        }
+        inf->bit_buf >>= len;
+        inf->bit_cnt -= len;
+        return entry >> 4;
+    }
+    // long code, walk the canonical code bit by bit
+    uint64_t bits = inf->bit_buf;
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (int len = 1; len < 16; len++) {
+        code |= (int)(bits & 1);
+        bits >>= 1;
+        const int count = h->count[len];
+        if ((code - count) < first) {
+            if (len > inf->bit_cnt) {
+                return -1;
+            }
+            inf->bit_buf >>= len;
+            inf->bit_cnt -= len;
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static bool _inflate_fixed_tables(inflate_t* inf) {
+    uint8_t lengths[320];
+    int i = 0;
+    for (; i < 144; i++) lengths[i] = 8;
+    for (; i < 256; i++) lengths[i] = 9;
+    for (; i < 280; i++) lengths[i] = 7;
+    for (; i < 288; i++) lengths[i] = 8;
+    for (; i < 320; i++) lengths[i] = 5;
+    return _inflate_build(&inf->lit, lengths, 288) && _inflate_build(&inf->dist, lengths + 288, 30);
+}
+
+static bool _inflate_dynamic_tables(inflate_t* inf) {
+    static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    const int32_t hlit = _inflate_bits(inf, 5);
+    const int32_t hdist = _inflate_bits(inf, 5);
+    const int32_t hclen = _inflate_bits(inf, 4);
+    if ((hlit < 0) || (hdist < 0) || (hclen < 0)) {
+        return false;
+    }
+    const int num_lit = hlit + 257;
+    const int num_dist = hdist + 1;
+    if ((num_lit > 286) || (num_dist > 30)) {
+        return false;
+    }
+    uint8_t lengths[320] = { 0 };
+    for (int i = 0; i < (hclen + 4); i++) {
+        const int32_t len = _inflate_bits(inf, 3);
+        if (len < 0) {
+            return false;
+        }
+        lengths[order[i]] = (uint8_t)len;
+    }
+    // the code length code is decoded with the literal table as scratch
+    if (!_inflate_build(&inf->lit, lengths, 19)) {
+        return false;
+    }
+    int i = 0;
+    while (i < (num_lit + num_dist)) {
+        const int sym = _inflate_decode(inf, &inf->lit);
+        if (sym < 0) {
+            return false;
+        }
+        if (sym < 16) {
+            lengths[i++] = (uint8_t)sym;
+            continue;
+        }
+        int32_t rep;
+        uint8_t val = 0;
+        if (sym == 16) {
+            if (i == 0) {
+                return false;
+            }
+            val = lengths[i - 1];
+            rep = _inflate_bits(inf, 2) + 3;
+        }
+        else if (sym == 17) {
+            rep = _inflate_bits(inf, 3) + 3;
+        }
+        else {
+            rep = _inflate_bits(inf, 7);
+            rep = (rep < 0) ? rep : (rep + 11);
+        }
+        if ((rep < 3) || ((i + rep) > (num_lit + num_dist))) {
+            return false;
+        }
+        while (rep--) {
+            lengths[i++] = val;
+        }
+    }
+    // the end-of-block code must exist
+    if (lengths[256] == 0) {
+        return false;
+    }
+    return _inflate_build(&inf->lit, lengths, num_lit) && _inflate_build(&inf->dist, lengths + num_lit, num_dist);
+}
+
+static bool _inflate_block_header(inflate_t* inf) {
+    const int32_t hdr = _inflate_bits(inf, 3);
+    if (hdr < 0) {
+        return false;
+    }
+    inf->final_block = hdr & 1;
+    switch (hdr >> 1) {
+        case 0: {
+            _inflate_align(inf);
+            if ((inf->src_pos + 4) > inf->src_size) {
+                return false;
+            }
+            const uint8_t* p = inf->src + inf->src_pos;
+            const uint32_t len = p[0] | (p[1] << 8);
+            const uint32_t nlen = p[2] | (p[3] << 8);
+            if (len != (~nlen & 0xFFFF)) {
+                return false;
+            }
+            inf->src_pos += 4;
+            inf->stored_left = len;
+            inf->state = _INFLATE_STATE_STORED;
+            return true;
+        }
+        case 1:
+            inf->state = _INFLATE_STATE_HUFF;
+            return _inflate_fixed_tables(inf);
+        case 2:
+            inf->state = _INFLATE_STATE_HUFF;
+            return _inflate_dynamic_tables(inf);
+        default:
+            return false;
+    }
+}
+
+/* decode one literal or match, returns the status to stop with, or
+   INFLATE_STATUS_MORE to continue
+*/
+static inline inflate_status_t _inflate_symbol(inflate_t* inf) {
+    const int sym = _inflate_decode(inf, &inf->lit);
+    if (sym < 256) {
+        if (sym < 0) {
+            return INFLATE_STATUS_ERROR;
+        }
+        if (inf->dst_pos >= inf->dst_size) {
+            return INFLATE_STATUS_FULL;
+        }
+        inf->dst[inf->dst_pos++] = (uint8_t)sym;
+        return INFLATE_STATUS_MORE;
+    }
+    if (sym == 256) {
+        inf->state = inf->final_block ? _INFLATE_STATE_DONE : _INFLATE_STATE_HEADER;
+        return INFLATE_STATUS_MORE;
+    }
+    const int len_idx = sym - 257;
+    if (len_idx >= 29) {
+        return INFLATE_STATUS_ERROR;
+    }
+    const int32_t len_extra = _inflate_bits(inf, _inflate_len_extra[len_idx]);
+    const int dist_idx = _inflate_decode(inf, &inf->dist);
+    if ((len_extra < 0) || (dist_idx < 0) || (dist_idx >= 30)) {
+        return INFLATE_STATUS_ERROR;
+    }
+    const int32_t dist_extra = _inflate_bits(inf, _inflate_dist_extra[dist_idx]);
+    if (dist_extra < 0) {
+        return INFLATE_STATUS_ERROR;
+    }
+    const size_t len = (size_t)(_inflate_len_base[len_idx] + len_extra);
+    const size_t dist = (size_t)(_inflate_dist_base[dist_idx] + dist_extra);
+    if (dist > inf->dst_pos) {
+        return INFLATE_STATUS_ERROR;
+    }
+    if ((inf->dst_pos + len) > inf->dst_size) {
+        return INFLATE_STATUS_FULL;
+    }
+    uint8_t* dst = inf->dst + inf->dst_pos;
+    const uint8_t* src = dst - dist;
+    if (dist >= len) {
+        memcpy(dst, src, len);
+    }
+    else if (dist == 1) {
+        memset(dst, src[0], len);
+    }
+    else {
+        // overlapping copy repeats the last dist bytes
+        for (size_t i = 0; i < len; i++) {
+            dst[i] = src[i];
+        }
+    }
+    inf->dst_pos += len;
+    return INFLATE_STATUS_MORE;
+}
+
+inflate_status_t inflate_run(inflate_t* inf, size_t max_output) {
+    assert(inf);
+    const size_t end_pos = inf->dst_pos + max_output;
+    while (true) {
+        switch (inf->state) {
+            case _INFLATE_STATE_DONE:
+                return INFLATE_STATUS_DONE;
+
+            case _INFLATE_STATE_ERROR:
+                return INFLATE_STATUS_ERROR;
+
+            case _INFLATE_STATE_HEADER:
+                if (!_inflate_block_header(inf)) {
+                    inf->state = _INFLATE_STATE_ERROR;
+                }
+                break;
+
+            case _INFLATE_STATE_STORED: {
+                if (inf->stored_left == 0) {
+                    inf->state = inf->final_block ? _INFLATE_STATE_DONE : _INFLATE_STATE_HEADER;
+                    break;
+                }
+                if (inf->dst_pos >= end_pos) {
+                    return INFLATE_STATUS_MORE;
+                }
+                if (inf->dst_pos >= inf->dst_size) {
+                    return INFLATE_STATUS_FULL;
+                }
+                size_t num = inf->stored_left;
+                if (num > (end_pos - inf->dst_pos)) {
+                    num = end_pos - inf->dst_pos;
+                }
+                if (num > (inf->dst_size - inf->dst_pos)) {
+                    num = inf->dst_size - inf->dst_pos;
+                }
+                if (num > (inf->src_size - inf->src_pos)) {
+                    inf->state = _INFLATE_STATE_ERROR;
+                    break;
+                }
+                memcpy(inf->dst + inf->dst_pos, inf->src + inf->src_pos, num);
+                inf->dst_pos += num;
+                inf->src_pos += num;
+                inf->stored_left -= (uint32_t)num;
+                break;
+            }
+
+            case _INFLATE_STATE_HUFF:
+                // fast loop while any symbol fits into the output
+                while ((inf->state == _INFLATE_STATE_HUFF) && (inf->dst_pos < end_pos) && ((inf->dst_size - inf->dst_pos) >= 258)) {
+                    if (_inflate_symbol(inf) == INFLATE_STATUS_ERROR) {
+                        inf->state = _INFLATE_STATE_ERROR;
+                    }
+                }
+                while ((inf->state == _INFLATE_STATE_HUFF) && (inf->dst_pos < end_pos)) {
+                    // close to the end of the output a symbol may not fit, keep the
+                    // input position to retry it once the output buffer has grown
+                    const size_t src_pos = inf->src_pos;
+                    const uint64_t bit_buf = inf->bit_buf;
+                    const int bit_cnt = inf->bit_cnt;
+                    const inflate_status_t res = _inflate_symbol(inf);
+                    if (res == INFLATE_STATUS_FULL) {
+                        inf->src_pos = src_pos;
+                        inf->bit_buf = bit_buf;
+                        inf->bit_cnt = bit_cnt;
+                        return INFLATE_STATUS_FULL;
+                    }
+                    else if (res == INFLATE_STATUS_ERROR) {
+                        inf->state = _INFLATE_STATE_ERROR;
+                    }
+                }
+                if (inf->state == _INFLATE_STATE_HUFF) {
+                    return INFLATE_STATUS_MORE;
+                }
+                break;
+        }
+        if (inf->state == _INFLATE_STATE_DONE) {
+            // leave src_pos behind the deflate stream (e.g. at the gzip trailer)
+            _inflate_align(inf);
+            return INFLATE_STATUS_DONE;
+        }
+    }
+}
+
+uint32_t inflate_crc32(uint32_t crc, const uint8_t* ptr, size_t num_bytes) {
+    static uint32_t table[256];
+    static bool table_valid;
+    if (!table_valid) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+            }
+            table[i] = c;
+        }
+        table_valid = true;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < num_bytes; i++) {
+        crc = table[(crc ^ ptr[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+#endif /* COMMON_IMPL */
@@ -5,16 +5,41 @@
     Special embedded commands:
 
     ${wait:20} - wait 20 frames before continuing
+    ${delay:5} - set the delay between keys to 5 frames
+    ${key:13}  - feed a raw key code
+
+    Fast paste: if the front-end provides a ready_cb, the next key is
+    fed as soon as ready_cb() reports that the guest has consumed the
+    previous key (e.g. the system's keyboard buffer is empty again). The
+    key delay then only acts as a minimum distance between keys, so it
+    can be much shorter than the fixed delay needed without the hook.
+
+    Input text is pulled through a small window from a stream source,
+    there's no upper limit on its size.
+
+    Define KEYBUF_PER_THREAD before including the implementation to give
+    each thread its own keybuf (for batch runners with one emulator
+    instance per worker thread). KEYBUF_THREAD_LOCAL is then also usable
+    for the front-end's own per-thread state behind ready_cb.
 */
 
+/* stream source callback, copy up to max_bytes into buf, return 0 at the end */
+typedef int (*keybuf_read_t)(void* user_data, uint8_t* buf, int max_bytes);
+
 typedef struct {
     int key_delay_frames;
+    /* optional: return true when the guest is ready for the next key */
+    bool (*ready_cb)(void);
 } keybuf_desc_t;
 
 /* initialize the keybuf with a base-delay between keys in 60 Hz frames */
 void keybuf_init(const keybuf_desc_t* desc);
-/* put a text for playback into keybuf */
+/* free the text copy (needed per thread with KEYBUF_PER_THREAD) */
+void keybuf_shutdown(void);
+/* put a text for playback into keybuf (the text is copied) */
 void keybuf_put(const char* text);
+/* play back text pulled from a stream source */
+void keybuf_put_stream(keybuf_read_t read_cb, void* user_data);
 /* get next key to feed into emulator, call once per frame, returns 0 if no key to feed */
 uint8_t keybuf_get(uint32_t frame_time_us);
 
@@ -25,46 +50,100 @@ uint8_t keybuf_get(uint32_t frame_time_us);
 #include <stdlib.h>
 #include <assert.h>
 
-#define KEYBUF_MAX_KEYS (64 * 1024)
+#if !defined(KEYBUF_PER_THREAD)
+#define KEYBUF_THREAD_LOCAL
+#elif defined(_MSC_VER)
+#define KEYBUF_THREAD_LOCAL __declspec(thread)
+#else
+#define KEYBUF_THREAD_LOCAL __thread
+#endif
+
+#define KEYBUF_WINDOW_SIZE (256)
+#define KEYBUF_READY_TIMEOUT (60 * 16667)
 typedef struct {
     bool valid;
+    keybuf_read_t read_cb;
+    void* user_data;
+    bool (*ready_cb)(void);
+    /* owned copy of the text passed to keybuf_put() */
+    char* text;
+    int text_len;
+    int text_pos;
+    /* window into the stream */
     int cur_pos;
+    int cur_len;
     int cur_delay_time;
     int key_delay_time;
-    uint8_t buf[KEYBUF_MAX_KEYS];
+    uint8_t buf[KEYBUF_WINDOW_SIZE];
 } keybuf_state_t;
-static keybuf_state_t keybuf;
+static KEYBUF_THREAD_LOCAL keybuf_state_t keybuf;
 
 void keybuf_init(const keybuf_desc_t* desc) {
+    if (keybuf.text) {
+        free(keybuf.text);
+    }
     keybuf = (keybuf_state_t) {
         .valid = true,
+        .ready_cb = desc->ready_cb,
         .key_delay_time = desc->key_delay_frames * 16667,
     };
 }
 
+void keybuf_shutdown(void) {
+    if (keybuf.text) {
+        free(keybuf.text);
+    }
+    keybuf = (keybuf_state_t) { .valid = false };
+}
+
+void keybuf_put_stream(keybuf_read_t read_cb, void* user_data) {
+    assert(keybuf.valid);
+    keybuf.read_cb = read_cb;
+    keybuf.user_data = user_data;
+    keybuf.cur_pos = 0;
+    keybuf.cur_len = 0;
+    keybuf.cur_delay_time = 0;
+}
+
+static int _keybuf_read_text(void* user_data, uint8_t* buf, int max_bytes) {
+    (void)user_data;
+    int num = keybuf.text_len - keybuf.text_pos;
+    if (num > max_bytes) {
+        num = max_bytes;
+    }
+    memcpy(buf, keybuf.text + keybuf.text_pos, (size_t)num);
+    keybuf.text_pos += num;
+    return num;
+}
+
 void keybuf_put(const char* text) {
     assert(keybuf.valid);
     if (!text) {
         return;
     }
-    keybuf.cur_delay_time = 0;
-    int len = (int) strlen(text);
-    if ((len+1) < KEYBUF_MAX_KEYS) {
-        strcpy((char*)keybuf.buf, text);
-    }
-    else {
-        keybuf.buf[0] = 0;
+    if (keybuf.text) {
+        free(keybuf.text);
     }
-    keybuf.cur_pos = 0;
+    keybuf.text_len = (int) strlen(text);
+    keybuf.text_pos = 0;
+    keybuf.text = (char*) malloc((size_t)keybuf.text_len + 1);
+    assert(keybuf.text);
+    memcpy(keybuf.text, text, (size_t)keybuf.text_len + 1);
+    keybuf_put_stream(_keybuf_read_text, 0);
 }
 
 static uint8_t _keybuf_peek(void) {
-    if (keybuf.cur_pos < KEYBUF_MAX_KEYS) {
-        return keybuf.buf[keybuf.cur_pos];
-    }
-    else {
-        return 0;
+    if (keybuf.cur_pos >= keybuf.cur_len) {
+        keybuf.cur_pos = 0;
+        keybuf.cur_len = keybuf.read_cb ? keybuf.read_cb(keybuf.user_data, keybuf.buf, KEYBUF_WINDOW_SIZE) : 0;
+        if (keybuf.cur_len <= 0) {
+            /* end of stream */
+            keybuf.cur_len = 0;
+            keybuf.read_cb = 0;
+            return 0;
+        }
     }
+    return keybuf.buf[keybuf.cur_pos];
 }
 
 static uint8_t _keybuf_next(void) {
@@ -115,6 +194,13 @@ uint8_t keybuf_get(uint32_t frame_time_us) {
     assert(keybuf.valid);
     uint8_t c = 0;
     if (keybuf.cur_delay_time <= 0) {
+        /* fast paste: hold back the next key until the guest is ready, but
+           not forever in case the guest doesn't use its keyboard buffer
+        */
+        if (keybuf.ready_cb && (keybuf.cur_delay_time > -KEYBUF_READY_TIMEOUT) && (0 != _keybuf_peek()) && !keybuf.ready_cb()) {
+            keybuf.cur_delay_time -= (int) frame_time_us;
+            return 0;
+        }
         keybuf.cur_delay_time = keybuf.key_delay_time;
         c = _keybuf_next();
         if (c != 0) {
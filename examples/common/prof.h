@@ -1,9 +1,30 @@
+#pragma once
 /*
     A simple profiling helper module.
+
+    Values (in milliseconds) are recorded into scopes. The predefined
+    bucket types below are scopes, more can be registered by name with
+    prof_scope(), or implicitly with the PROF_BEGIN/PROF_END macros
+    which time a block of code (define PROF_DISABLED to compile them out):
+
+        PROF_BEGIN(draw);
+        ...
+        PROF_END(draw);
+
+    Scopes nest, and each thread records into its own slots without
+    locking. Per scope there is a window of the most recent values
+    (prof_stats(), for the calling thread) and a log-linear histogram of
+    all values since prof_init() (prof_percentiles(), merged over all
+    threads, approximate while other threads are still recording).
+
+    prof_set_export() selects a file written by prof_shutdown(): ".csv"
+    writes a summary table, ".json" a Chrome trace (chrome://tracing or
+    Perfetto) of every timed scope.
 */
 typedef enum {
     PROF_FRAME,     // frame time
     PROF_EMU,       // emulator time
+    PROF_HOST_FRAME,    // host time spent per frame (headless backend)
     PROF_NUM_BUCKET_TYPES,
 } prof_bucket_type_t;
 
@@ -14,23 +35,85 @@ typedef struct {
     float max_val;
 } prof_stats_t;
 
-// initialize profiling system
+typedef struct {
+    uint64_t count;
+    float avg_val;
+    float p50_val;
+    float p95_val;
+    float p99_val;
+    float max_val;
+} prof_percentiles_t;
+
+// initialize profiling system (further calls are ignored)
 void prof_init(void);
-// push a value into a profiler bucket
-void prof_push(prof_bucket_type_t type, float val);
+// write the export file if one was requested
+void prof_shutdown(void);
+// register a named scope, or return the existing one (name must outlive the profiler)
+int prof_scope(const char* name);
+// get the name of a scope
+const char* prof_scope_name(int scope);
+// start timing a scope on the calling thread
+void prof_begin(int scope);
+// stop timing the innermost scope (must match), and record its duration
+void prof_end(int scope);
+// push a value into a profiler bucket (a prof_bucket_type_t or a prof_scope() id)
+void prof_push(int scope, float val);
 // get number of values in profiler bucket
-int prof_count(prof_bucket_type_t type);
+int prof_count(int scope);
 // get a value from profiler bucket
-float prof_value(prof_bucket_type_t type, int index);
-// get average value in bucket
-prof_stats_t prof_stats(prof_bucket_type_t type);
+float prof_value(int scope, int index);
+// get average, min and max of the recent values in bucket
+prof_stats_t prof_stats(int scope);
+// get the distribution of all values in bucket
+prof_percentiles_t prof_percentiles(int scope);
+// set the file written by prof_shutdown() (.csv or .json), survives prof_init()
+void prof_set_export(const char* path);
+// write all scopes to a .csv summary or a .json Chrome trace now
+bool prof_export(const char* path);
+
+#ifndef PROF_DISABLED
+#define PROF_BEGIN(name) static int _prof_scope_##name = -1; if (_prof_scope_##name < 0) { _prof_scope_##name = prof_scope(#name); } prof_begin(_prof_scope_##name)
+#define PROF_END(name) prof_end(_prof_scope_##name)
+#else
+#define PROF_BEGIN(name)
+#define PROF_END(name)
+#endif
 
 /*== IMPLEMENTATION ==========================================================*/
 #ifdef COMMON_IMPL
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h> // malloc/free
+#include <string.h>
 #include "sokol_time.h"
 
 #define PROF_BUCKET_SIZE (128)
+#define PROF_MAX_SCOPES (16)
+#define PROF_MAX_THREADS (4)
+#define PROF_MAX_DEPTH (16)
+#define PROF_MAX_TRACE_EVENTS (64 * 1024)   // per thread, only allocated for .json export
+// histogram: values in microseconds, 16 linear sub-buckets per power of two (~6% precision)
+#define PROF_HIST_SUB_BITS (4)
+#define PROF_HIST_SUB (1 << PROF_HIST_SUB_BITS)
+#define PROF_HIST_MAX_BITS (24)             // up to ~16 seconds
+#define PROF_HIST_BUCKETS ((PROF_HIST_MAX_BITS - PROF_HIST_SUB_BITS + 1) * PROF_HIST_SUB)
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define _PROF_THREAD_LOCAL __declspec(thread)
+#define _PROF_LOAD(p) (*(p))
+#define _PROF_STORE(p, v) (*(p) = (v))
+#define _PROF_FETCH_ADD(p, v) _InterlockedExchangeAdd((volatile long*)(p), (v))
+#define _PROF_LOCK(p) while (_InterlockedExchange((volatile long*)(p), 1)) {}
+#define _PROF_UNLOCK(p) _InterlockedExchange((volatile long*)(p), 0)
+#else
+#define _PROF_THREAD_LOCAL __thread
+#define _PROF_LOAD(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+#define _PROF_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#define _PROF_FETCH_ADD(p, v) __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST)
+#define _PROF_LOCK(p) while (__atomic_exchange_n(p, 1, __ATOMIC_ACQUIRE)) {}
+#define _PROF_UNLOCK(p) __atomic_store_n(p, 0, __ATOMIC_RELEASE)
+#endif
 
 // a simple ring buffer struct
 typedef struct {
@@ -41,13 +124,76 @@ typedef struct {
 
 typedef struct {
     prof_ring_t ring;
+    double ring_sum;        // running sum of the values in ring
+    float ring_min;
+    float ring_max;
+    bool ring_minmax_dirty; // an evicted value was the min or max
+    // written only by the owning thread, read with relaxed loads by others
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t hist[PROF_HIST_BUCKETS];
 } prof_bucket_t;
 
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    int scope;
+} prof_event_t;
+
+typedef struct {
+    prof_bucket_t buckets[PROF_MAX_SCOPES];
+    prof_event_t* events;
+    int num_events;
+    int dropped_events;
+} prof_thread_t;
+
+// scope names and export settings are kept across prof_init()
+static struct {
+    long lock;
+    int generation;         // bumped by prof_init(), invalidates thread slots
+    int num_scopes;
+    const char* names[PROF_MAX_SCOPES];
+    char export_path[256];
+} prof_reg = {
+    .num_scopes = PROF_NUM_BUCKET_TYPES,
+    .names = { "frame", "emu", "host_frame" },
+};
+
 static struct {
     bool valid;
-    prof_bucket_t buckets[PROF_NUM_BUCKET_TYPES];
+    bool trace;
+    int num_threads;
+    int dropped_threads;
+    prof_thread_t threads[PROF_MAX_THREADS];
 } prof;
 
+// per-thread slot index (-1: not assigned, -2: no slot left), the prof_init()
+// generation the slot belongs to, and the scope stack
+static _PROF_THREAD_LOCAL int prof_tid = -1;
+static _PROF_THREAD_LOCAL int prof_tid_generation;
+static _PROF_THREAD_LOCAL int prof_depth;
+static _PROF_THREAD_LOCAL struct { int scope; uint64_t start; } prof_stack[PROF_MAX_DEPTH];
+
+static prof_thread_t* prof_thread(void) {
+    // a slot from before the last prof_init() is gone
+    if (prof_tid_generation != prof_reg.generation) {
+        prof_tid_generation = prof_reg.generation;
+        prof_tid = -1;
+    }
+    if (prof_tid == -1) {
+        int tid = _PROF_FETCH_ADD(&prof.num_threads, 1);
+        if (tid < PROF_MAX_THREADS) {
+            prof_tid = tid;
+        }
+        else {
+            prof_tid = -2;
+            _PROF_FETCH_ADD(&prof.dropped_threads, 1);
+        }
+    }
+    return (prof_tid >= 0) ? &prof.threads[prof_tid] : 0;
+}
+
 static int prof_ring_idx(int i) {
     return (i % PROF_BUCKET_SIZE);
 }
@@ -61,7 +207,23 @@ static int prof_ring_count(const prof_ring_t* ring) {
     }
 }
 
-static void prof_ring_put(prof_ring_t* ring, float value) {
+static void prof_ring_put(prof_bucket_t* bucket, float value) {
+    prof_ring_t* ring = &bucket->ring;
+    if (prof_ring_count(ring) == (PROF_BUCKET_SIZE - 1)) {
+        // evict the oldest value
+        float old = ring->values[ring->tail];
+        bucket->ring_sum -= old;
+        if ((old <= bucket->ring_min) || (old >= bucket->ring_max)) {
+            bucket->ring_minmax_dirty = true;
+        }
+    }
+    if ((prof_ring_count(ring) == 0) || (value < bucket->ring_min)) {
+        bucket->ring_min = value;
+    }
+    if ((prof_ring_count(ring) == 0) || (value > bucket->ring_max)) {
+        bucket->ring_max = value;
+    }
+    bucket->ring_sum += value;
     ring->values[ring->head] = value;
     ring->head = prof_ring_idx(ring->head + 1);
     if (ring->head == ring->tail) {
@@ -69,55 +231,313 @@ static void prof_ring_put(prof_ring_t* ring, float value) {
     }
 }
 
-static float prof_ring_get(prof_ring_t* ring, int index) {
+static float prof_ring_get(const prof_ring_t* ring, int index) {
     return ring->values[prof_ring_idx(ring->tail + index)];
 }
 
+static int prof_hist_idx(uint32_t us) {
+    if (us < PROF_HIST_SUB) {
+        return (int)us;
+    }
+    int msb = 31;
+    while (0 == (us & (1u << msb))) {
+        msb--;
+    }
+    if (msb >= PROF_HIST_MAX_BITS) {
+        return PROF_HIST_BUCKETS - 1;
+    }
+    const int shift = msb - PROF_HIST_SUB_BITS;
+    return (shift + 1) * PROF_HIST_SUB + (int)((us >> shift) & (PROF_HIST_SUB - 1));
+}
+
+// highest value that falls into a histogram bucket, in microseconds
+static uint32_t prof_hist_upper(int idx) {
+    if (idx < PROF_HIST_SUB) {
+        return (uint32_t)idx;
+    }
+    const int shift = idx / PROF_HIST_SUB - 1;
+    const uint32_t low = (uint32_t)(PROF_HIST_SUB + (idx % PROF_HIST_SUB)) << shift;
+    return low + (1u << shift) - 1;
+}
+
+static void prof_record(prof_thread_t* t, int scope, float val) {
+    prof_bucket_t* bucket = &t->buckets[scope];
+    prof_ring_put(bucket, val);
+    const float us_val = val * 1000.0f;
+    const uint32_t us = (us_val > 0.0f) ? ((us_val < 4.0e9f) ? (uint32_t)us_val : 0xFFFFFFFF) : 0;
+    const int idx = prof_hist_idx(us);
+    _PROF_STORE(&bucket->hist[idx], bucket->hist[idx] + 1);
+    _PROF_STORE(&bucket->count, bucket->count + 1);
+    _PROF_STORE(&bucket->total_us, bucket->total_us + us);
+    if (us > bucket->max_us) {
+        _PROF_STORE(&bucket->max_us, us);
+    }
+}
+
 // public API functions
 void prof_init(void) {
+    if (prof.valid) {
+        return;
+    }
     stm_setup();
     memset(&prof, 0, sizeof(prof));
+    prof_reg.generation++;
+    const char* ext = strrchr(prof_reg.export_path, '.');
+    prof.trace = ext && (0 == strcmp(ext, ".json"));
     prof.valid = true;
 }
 
-void prof_push(prof_bucket_type_t type, float val) {
+void prof_shutdown(void) {
+    if (prof.valid && prof_reg.export_path[0]) {
+        prof_export(prof_reg.export_path);
+    }
+    for (int i = 0; i < PROF_MAX_THREADS; i++) {
+        free(prof.threads[i].events);
+        prof.threads[i].events = 0;
+    }
+    prof.valid = false;
+}
+
+int prof_scope(const char* name) {
+    assert(name);
+    int scope = -1;
+    _PROF_LOCK(&prof_reg.lock);
+    for (int i = 0; i < prof_reg.num_scopes; i++) {
+        if (0 == strcmp(prof_reg.names[i], name)) {
+            scope = i;
+            break;
+        }
+    }
+    if ((scope < 0) && (prof_reg.num_scopes < PROF_MAX_SCOPES)) {
+        scope = prof_reg.num_scopes;
+        prof_reg.names[scope] = name;
+        _PROF_STORE(&prof_reg.num_scopes, scope + 1);
+    }
+    _PROF_UNLOCK(&prof_reg.lock);
+    assert(scope >= 0);     // increase PROF_MAX_SCOPES
+    return scope;
+}
+
+const char* prof_scope_name(int scope) {
+    assert((scope >= 0) && (scope < prof_reg.num_scopes));
+    return prof_reg.names[scope];
+}
+
+void prof_begin(int scope) {
+    assert(prof.valid);
+    assert((scope >= 0) && (scope < PROF_MAX_SCOPES));
+    if (prof_depth < PROF_MAX_DEPTH) {
+        prof_stack[prof_depth].scope = scope;
+        prof_stack[prof_depth].start = stm_now();
+    }
+    prof_depth++;
+}
+
+void prof_end(int scope) {
+    assert(prof.valid);
+    assert(prof_depth > 0);
+    prof_depth--;
+    if (prof_depth >= PROF_MAX_DEPTH) {
+        return;     // too deeply nested, not recorded
+    }
+    assert(prof_stack[prof_depth].scope == scope);
+    const uint64_t start = prof_stack[prof_depth].start;
+    const uint64_t end = stm_now();
+    prof_thread_t* t = prof_thread();
+    if (!t) {
+        return;
+    }
+    prof_record(t, scope, (float)stm_ms(stm_diff(end, start)));
+    if (prof.trace) {
+        if (!t->events) {
+            t->events = (prof_event_t*) malloc(PROF_MAX_TRACE_EVENTS * sizeof(prof_event_t));
+        }
+        if (t->events && (t->num_events < PROF_MAX_TRACE_EVENTS)) {
+            t->events[t->num_events++] = (prof_event_t){ .start = start, .end = end, .scope = scope };
+        }
+        else {
+            t->dropped_events++;
+        }
+    }
+}
+
+void prof_push(int scope, float val) {
     assert(prof.valid);
-    assert((type >= 0) && (type < PROF_NUM_BUCKET_TYPES));
-    prof_ring_put(&prof.buckets[type].ring, val);
+    assert((scope >= 0) && (scope < PROF_MAX_SCOPES));
+    prof_thread_t* t = prof_thread();
+    if (t) {
+        prof_record(t, scope, val);
+    }
 }
 
-int prof_count(prof_bucket_type_t type) {
+int prof_count(int scope) {
     assert(prof.valid);
-    assert((type >= 0) && (type < PROF_NUM_BUCKET_TYPES));
-    return prof_ring_count(&prof.buckets[type].ring);
+    assert((scope >= 0) && (scope < PROF_MAX_SCOPES));
+    prof_thread_t* t = prof_thread();
+    return t ? prof_ring_count(&t->buckets[scope].ring) : 0;
 }
 
-float prof_value(prof_bucket_type_t type, int index) {
+float prof_value(int scope, int index) {
     assert(prof.valid);
-    assert((type >= 0) && (type < PROF_NUM_BUCKET_TYPES));
-    return prof_ring_get(&prof.buckets[type].ring, index);
+    assert((scope >= 0) && (scope < PROF_MAX_SCOPES));
+    prof_thread_t* t = prof_thread();
+    return t ? prof_ring_get(&t->buckets[scope].ring, index) : 0.0f;
 }
 
-prof_stats_t prof_stats(prof_bucket_type_t type) {
+prof_stats_t prof_stats(int scope) {
     assert(prof.valid);
-    assert((type >= 0) && (type < PROF_NUM_BUCKET_TYPES));
+    assert((scope >= 0) && (scope < PROF_MAX_SCOPES));
     prof_stats_t stats = {0};
-    prof_ring_t* ring = &prof.buckets[type].ring;
+    prof_thread_t* t = prof_thread();
+    if (!t) {
+        return stats;
+    }
+    prof_bucket_t* bucket = &t->buckets[scope];
+    const prof_ring_t* ring = &bucket->ring;
     stats.count = prof_ring_count(ring);
     if (stats.count > 0) {
-        stats.min_val = 1000.0f;
-        for (int i = 0; i < stats.count; i++) {
-            float val = prof_ring_get(ring, i);
-            stats.avg_val += val;
-            if (val < stats.min_val) {
-                stats.min_val = val;
-            }
-            if (val > stats.max_val) {
-                stats.max_val = val;
+        if (bucket->ring_minmax_dirty) {
+            // only rescan when the old min or max left the window
+            bucket->ring_min = bucket->ring_max = prof_ring_get(ring, 0);
+            for (int i = 1; i < stats.count; i++) {
+                float val = prof_ring_get(ring, i);
+                if (val < bucket->ring_min) {
+                    bucket->ring_min = val;
+                }
+                if (val > bucket->ring_max) {
+                    bucket->ring_max = val;
+                }
             }
+            bucket->ring_minmax_dirty = false;
         }
-        stats.avg_val /= (float)stats.count;
+        stats.avg_val = (float)(bucket->ring_sum / stats.count);
+        stats.min_val = bucket->ring_min;
+        stats.max_val = bucket->ring_max;
     }
     return stats;
 }
+
+prof_percentiles_t prof_percentiles(int scope) {
+    assert(prof.valid);
+    assert((scope >= 0) && (scope < PROF_MAX_SCOPES));
+    prof_percentiles_t res = {0};
+    uint32_t hist[PROF_HIST_BUCKETS] = {0};
+    uint64_t total_us = 0;
+    uint32_t max_us = 0;
+    const int num_threads = (prof.num_threads < PROF_MAX_THREADS) ? prof.num_threads : PROF_MAX_THREADS;
+    for (int ti = 0; ti < num_threads; ti++) {
+        const prof_bucket_t* bucket = &prof.threads[ti].buckets[scope];
+        for (int i = 0; i < PROF_HIST_BUCKETS; i++) {
+            hist[i] += _PROF_LOAD(&bucket->hist[i]);
+        }
+        res.count += _PROF_LOAD(&bucket->count);
+        total_us += _PROF_LOAD(&bucket->total_us);
+        uint32_t bucket_max_us = _PROF_LOAD(&bucket->max_us);
+        if (bucket_max_us > max_us) {
+            max_us = bucket_max_us;
+        }
+    }
+    if (res.count == 0) {
+        return res;
+    }
+    res.avg_val = (float)((double)total_us * 0.001 / res.count);
+    res.max_val = (float)max_us * 0.001f;
+    const uint64_t rank50 = (res.count * 50 + 99) / 100;
+    const uint64_t rank95 = (res.count * 95 + 99) / 100;
+    const uint64_t rank99 = (res.count * 99 + 99) / 100;
+    // a percentile may fall into bucket 0, so 0.0 can't mean 'not found yet'
+    bool found50 = false, found95 = false, found99 = false;
+    uint64_t sum = 0;
+    for (int i = 0; i < PROF_HIST_BUCKETS; i++) {
+        if (hist[i] == 0) {
+            continue;
+        }
+        sum += hist[i];
+        const float upper = (float)prof_hist_upper(i) * 0.001f;
+        if ((sum >= rank50) && !found50) {
+            res.p50_val = upper;
+            found50 = true;
+        }
+        if ((sum >= rank95) && !found95) {
+            res.p95_val = upper;
+            found95 = true;
+        }
+        if ((sum >= rank99) && !found99) {
+            res.p99_val = upper;
+            found99 = true;
+            break;
+        }
+    }
+    // never report a percentile above the exact maximum
+    if (res.p50_val > res.max_val) res.p50_val = res.max_val;
+    if (res.p95_val > res.max_val) res.p95_val = res.max_val;
+    if (res.p99_val > res.max_val) res.p99_val = res.max_val;
+    return res;
+}
+
+void prof_set_export(const char* path) {
+    prof_reg.export_path[0] = 0;
+    if (path) {
+        strncpy(prof_reg.export_path, path, sizeof(prof_reg.export_path) - 1);
+        prof_reg.export_path[sizeof(prof_reg.export_path) - 1] = 0;
+    }
+    const char* ext = strrchr(prof_reg.export_path, '.');
+    prof.trace = ext && (0 == strcmp(ext, ".json"));
+}
+
+static void prof_write_json_string(FILE* fp, const char* str) {
+    fputc('"', fp);
+    for (; *str; str++) {
+        if ((*str == '"') || (*str == '\\')) {
+            fputc('\\', fp);
+        }
+        fputc(*str, fp);
+    }
+    fputc('"', fp);
+}
+
+bool prof_export(const char* path) {
+    assert(prof.valid && path);
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "prof: failed to open '%s'\n", path);
+        return false;
+    }
+    const char* ext = strrchr(path, '.');
+    const int num_threads = (prof.num_threads < PROF_MAX_THREADS) ? prof.num_threads : PROF_MAX_THREADS;
+    if (ext && (0 == strcmp(ext, ".json"))) {
+        fputs("{\"traceEvents\":[\n", fp);
+        bool first = true;
+        for (int ti = 0; ti < num_threads; ti++) {
+            const prof_thread_t* t = &prof.threads[ti];
+            for (int i = 0; i < t->num_events; i++) {
+                const prof_event_t* e = &t->events[i];
+                fprintf(fp, "%s{\"name\":", first ? "" : ",\n");
+                prof_write_json_string(fp, prof_reg.names[e->scope]);
+                fprintf(fp, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d}",
+                    stm_us(e->start), stm_us(stm_diff(e->end, e->start)), ti);
+                first = false;
+            }
+            if (t->dropped_events > 0) {
+                fprintf(stderr, "prof: thread %d dropped %d trace events\n", ti, t->dropped_events);
+            }
+        }
+        fputs("\n]}\n", fp);
+    }
+    else {
+        fputs("scope,count,avg_ms,p50_ms,p95_ms,p99_ms,max_ms\n", fp);
+        for (int i = 0; i < prof_reg.num_scopes; i++) {
+            prof_percentiles_t p = prof_percentiles(i);
+            if (p.count > 0) {
+                fprintf(fp, "%s,%llu,%.4f,%.4f,%.4f,%.4f,%.4f\n", prof_reg.names[i], (unsigned long long)p.count,
+                    p.avg_val, p.p50_val, p.p95_val, p.p99_val, p.max_val);
+            }
+        }
+    }
+    if (prof.dropped_threads > 0) {
+        fprintf(stderr, "prof: %d threads not recorded, increase PROF_MAX_THREADS\n", prof.dropped_threads);
+    }
+    fclose(fp);
+    return true;
+}
 #endif // COMMON_IMPL
@@ -0,0 +1,170 @@
+#pragma once
+/*
+    Run-ahead to hide the input latency of the emulated system.
+
+    Many games only react to input one or more frames after it has been
+    read. With run-ahead, after the regular frame has been emulated, the
+    system state is saved, N more frames are emulated with the current
+    input, the result of the last one is presented, and the saved state is
+    restored. The displayed image is thus N frames 'in the future', while
+    the real emulation timeline (and audio) stays untouched.
+
+    Usage in the frame callback, after the regular exec loop:
+
+        uint32_t ahead_us;
+        while ((ahead_us = runahead_exec_time(state.frame_time_us)) > 0) {
+            xxx_exec(&sys, ahead_us);
+        }
+
+    Front-ends drop audio samples while runahead_active() returns true, and
+    skip the run-ahead loop in warp mode. The optional video_cb is used to
+    switch off video decoding for the hidden frames which are never
+    presented.
+
+    The number of frames is meant to come from the "runahead" command line
+    arg (0 or missing: off). The state is saved with a plain memcpy of the
+    system struct, within the same process no pointer relocation is needed.
+
+    The status line function can be compiled out with RUNAHEAD_NO_STATUS
+    where sokol-debugtext isn't available (the SDL shim).
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RUNAHEAD_MAX_FRAMES (4)
+
+typedef struct {
+    void* sys;                      // pointer to the system struct
+    size_t sys_size;                // size of the system struct
+    int frames;                     // number of frames to run ahead, 0 is off (or the runahead_set_frames() value)
+    void (*video_cb)(bool enabled); // optional: switch video decoding on/off
+} runahead_desc_t;
+
+void runahead_init(const runahead_desc_t* desc);
+// returns microseconds to execute next, 0 when done (and the system is restored)
+uint32_t runahead_exec_time(uint32_t frame_time_us);
+// true while running hidden frames, front-ends drop audio samples in this case
+bool runahead_active(void);
+// frame count used by runahead_init() when desc->frames is 0 (for the SDL shim)
+void runahead_set_frames(int frames);
+#if !defined(RUNAHEAD_NO_STATUS)
+// draw a status line with latency gain and cost at the current sokol-debugtext cursor
+void runahead_draw_status(void);
+#endif
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*== IMPLEMENTATION ==========================================================*/
+#ifdef COMMON_IMPL
+#include "sokol_time.h"
+#if !defined(RUNAHEAD_NO_STATUS)
+#include "sokol_debugtext.h"
+#endif
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+typedef struct {
+    bool valid;
+    void* sys;
+    size_t sys_size;
+    int frames;
+    void (*video_cb)(bool enabled);
+    void* backup;
+    bool active;
+    int cur_frame;
+    uint64_t start;
+    uint32_t frame_time_us;
+    float cost_ms;              // host time per frame spent running ahead, smoothed
+} runahead_state_t;
+static runahead_state_t runahead;
+static int runahead_default_frames;
+
+void runahead_set_frames(int frames) {
+    runahead_default_frames = frames;
+}
+
+void runahead_init(const runahead_desc_t* desc) {
+    assert(desc && desc->sys && (desc->sys_size > 0));
+    if (runahead.backup) {
+        free(runahead.backup);
+    }
+    runahead = (runahead_state_t) {
+        .valid = true,
+        .sys = desc->sys,
+        .sys_size = desc->sys_size,
+        .frames = desc->frames ? desc->frames : runahead_default_frames,
+        .video_cb = desc->video_cb,
+    };
+    if (runahead.frames < 0) {
+        runahead.frames = 0;
+    }
+    else if (runahead.frames > RUNAHEAD_MAX_FRAMES) {
+        runahead.frames = RUNAHEAD_MAX_FRAMES;
+    }
+    if (runahead.frames > 0) {
+        runahead.backup = malloc(runahead.sys_size);
+        if (!runahead.backup) {
+            runahead.frames = 0;
+        }
+    }
+}
+
+uint32_t runahead_exec_time(uint32_t frame_time_us) {
+    assert(runahead.valid);
+    if (!runahead.active) {
+        if ((runahead.frames == 0) || (frame_time_us == 0)) {
+            return 0;
+        }
+        // save the real timeline before the first hidden frame
+        runahead.start = stm_now();
+        memcpy(runahead.backup, runahead.sys, runahead.sys_size);
+        runahead.active = true;
+        runahead.cur_frame = 0;
+        runahead.frame_time_us = frame_time_us;
+    }
+    else {
+        runahead.cur_frame++;
+    }
+    if (runahead.cur_frame < runahead.frames) {
+        // only the last frame is presented and needs video decoding
+        if (runahead.video_cb) {
+            runahead.video_cb(runahead.cur_frame == (runahead.frames - 1));
+        }
+        return frame_time_us;
+    }
+    // all done, back to the real timeline
+    memcpy(runahead.sys, runahead.backup, runahead.sys_size);
+    if (runahead.video_cb) {
+        runahead.video_cb(true);
+    }
+    runahead.active = false;
+    const float cost_ms = (float) stm_ms(stm_since(runahead.start));
+    runahead.cost_ms += (cost_ms - runahead.cost_ms) * 0.1f;
+    return 0;
+}
+
+bool runahead_active(void) {
+    return runahead.valid && runahead.active;
+}
+
+#if !defined(RUNAHEAD_NO_STATUS)
+void runahead_draw_status(void) {
+    if (!runahead.valid || (runahead.frames == 0) || (runahead.frame_time_us == 0)) {
+        return;
+    }
+    sdtx_printf("RUN-AHEAD %d: -%.1fms latency, cost %.2fms/frame",
+        runahead.frames,
+        (runahead.frames * runahead.frame_time_us) * 0.001f,
+        runahead.cost_ms);
+}
+#endif
+
+#endif /* COMMON_IMPL */
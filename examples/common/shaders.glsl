@@ -17,6 +17,17 @@ void main() {
 }
 @end
 
+@fs upscale_pal_fs
+uniform sampler2D emufb_tex;
+uniform sampler2D pal_tex;
+in vec2 uv;
+out vec4 frag_color;
+void main() {
+    float index = texture(emufb_tex, uv).x;
+    frag_color = texture(pal_tex, vec2((index * 255.0 + 0.5) / 256.0, 0.5));
+}
+@end
+
 @vs display_vs
 layout(location=0) in vec2 in_pos;
 layout(location=1) in vec2 in_uv;
@@ -38,6 +49,7 @@ void main() {
 @end
 
 @program upscale upscale_vs upscale_fs
+@program upscale_pal upscale_vs upscale_pal_fs
 @program display display_vs display_fs
 
 
@@ -0,0 +1,422 @@
+#pragma once
+/*
+    Save and restore the complete state of an emulated system.
+
+    A snapshot is a byte copy of the system struct (c64_t, cpc_t, ...), so
+    it can be restored in a later session where the struct, the pixel
+    buffer and the program image live at other addresses. The pointers in
+    the struct are never guessed from the data, each front-end lists them
+    in a fix-up callback (snapshot_desc_t.fixup_cb) which is called on the
+    copy when saving and loading:
+
+    - snapshot_keep(): pointers handed in with the system's desc struct
+      (pixel buffer, audio and debug callbacks, user data), these are
+      zeroed when saving and taken over from the running system on load
+    - snapshot_relocate(): pointer arrays like the mem_t page tables which
+      point into the system struct itself (RAM and ROM arrays) or into
+      static data (the unmapped pages in mem.h), these are stored as
+      offsets and re-bound on load
+
+    For example:
+
+        static void snapshot_fixup(snapshot_fixup_t* fx, void* ptr) {
+            c64_t* sys = (c64_t*) ptr;
+            snapshot_relocate(fx, &sys->mem_cpu, sizeof(sys->mem_cpu));
+            snapshot_keep(fx, &sys->debug, sizeof(sys->debug));
+            ...
+        }
+
+    Anything not listed is plain data and is restored as-is. A small header
+    with a format version, the system name, a build id and the struct size
+    makes mismatched snapshots fail to load instead of corrupting the
+    running system.
+
+    There are SNAPSHOT_NUM_SLOTS in-memory slots, on native platforms saving
+    a slot also writes [system]-[slot].snp to the current directory, which
+    can be loaded at startup with the "snapshot=path" command line arg.
+
+    Hotkeys (see snapshot_input()):
+
+        Ctrl+Shift+F1..F4   save to slot 1..4
+        Ctrl+F1..F4         load from slot 1..4
+
+    Both saving and loading are a memcpy plus the fix-up callback, so they
+    finish within the current frame.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNAPSHOT_VERSION (2)
+#define SNAPSHOT_NUM_SLOTS (4)
+
+typedef struct snapshot_fixup_t snapshot_fixup_t;
+
+typedef struct {
+    const char* system;         // system name stored in the header, e.g. "c64"
+    const char* build;          // build id, front-ends pass __DATE__ " " __TIME__
+    void* sys;                  // pointer to the system struct
+    size_t sys_size;            // size of the system struct
+    void (*fixup_cb)(snapshot_fixup_t* fx, void* sys);  // lists the pointers in a copy of the system struct
+    const char* load_path;      // optional snapshot file to load in snapshot_init()
+} snapshot_desc_t;
+
+// setup the snapshot module, loads desc->load_path if provided
+void snapshot_init(const snapshot_desc_t* desc);
+// save system state into a slot (0..SNAPSHOT_NUM_SLOTS-1)
+bool snapshot_save(int slot);
+// restore system state from a slot
+bool snapshot_load(int slot);
+// true if a slot contains a snapshot
+bool snapshot_slot_valid(int slot);
+// serialize into a buffer, returns the number of bytes written (or needed when dst is 0), 0 on error
+size_t snapshot_write(void* dst, size_t dst_size);
+// restore from a serialized snapshot, the system is unchanged on error
+bool snapshot_read(const void* src, size_t src_size);
+// read and write snapshot files (not supported on the web platform)
+bool snapshot_save_file(const char* path);
+bool snapshot_load_file(const char* path);
+// called from the fix-up callback: pointers which are re-applied from the running system
+void snapshot_keep(snapshot_fixup_t* fx, void* field, size_t size);
+// called from the fix-up callback: pointers into the system struct or static data
+void snapshot_relocate(snapshot_fixup_t* fx, void* field, size_t size);
+// load path used by snapshot_init() when desc->load_path is 0 (for the SDL shim)
+void snapshot_set_load_path(const char* path);
+#if defined(SOKOL_APP_INCLUDED)
+// handle the snapshot hotkeys, returns true if the event was consumed
+bool snapshot_input(const sapp_event* event);
+#endif
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*== IMPLEMENTATION ==========================================================*/
+#ifdef COMMON_IMPL
+#include "sokol_app.h"  // gfx.h must be included before (for gfx_flash_success/error)
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#define SNAPSHOT_MAGIC (0x4E534843)     // 'CHSN'
+#define SNAPSHOT_MAX_NAME (16)
+#define SNAPSHOT_MAX_BUILD (32)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    char system[SNAPSHOT_MAX_NAME];
+    char build[SNAPSHOT_MAX_BUILD];
+    uint32_t ptr_size;
+    uint32_t reserved;
+    uint64_t sys_size;
+} snapshot_header_t;
+
+struct snapshot_fixup_t {
+    bool load;          // false when saving
+    bool valid;         // cleared when a loaded offset is out of range
+    uint8_t* copy;      // the copy of the system struct passed to the fix-up callback
+};
+
+typedef struct {
+    bool valid;
+    char system[SNAPSHOT_MAX_NAME];
+    char build[SNAPSHOT_MAX_BUILD];
+    uint8_t* sys;
+    size_t sys_size;
+    void (*fixup_cb)(snapshot_fixup_t* fx, void* sys);
+    struct {
+        void* ptr;
+        size_t size;
+    } slots[SNAPSHOT_NUM_SLOTS];
+} snapshot_state_t;
+static snapshot_state_t snap;
+static const char* snapshot_load_path;
+
+// the static data anchor, any static in the executable
+static uintptr_t snapshot_anchor(void) {
+    return (uintptr_t)&snap;
+}
+
+static void snapshot_copy_name(char* dst, const char* src, size_t dst_size) {
+    memset(dst, 0, dst_size);
+    if (src) {
+        strncpy(dst, src, dst_size - 1);
+    }
+}
+
+void snapshot_set_load_path(const char* path) {
+    snapshot_load_path = path;
+}
+
+void snapshot_init(const snapshot_desc_t* desc) {
+    assert(desc && desc->sys && (desc->sys_size > 0));
+    for (int i = 0; i < SNAPSHOT_NUM_SLOTS; i++) {
+        free(snap.slots[i].ptr);
+    }
+    memset(&snap, 0, sizeof(snap));
+    snap.valid = true;
+    snapshot_copy_name(snap.system, desc->system, sizeof(snap.system));
+    snapshot_copy_name(snap.build, desc->build, sizeof(snap.build));
+    snap.sys = (uint8_t*) desc->sys;
+    snap.sys_size = desc->sys_size;
+    snap.fixup_cb = desc->fixup_cb;
+    const char* path = desc->load_path ? desc->load_path : snapshot_load_path;
+    if (path) {
+        if (!snapshot_load_file(path)) {
+            printf("snapshot: failed to load '%s'\n", path);
+        }
+    }
+}
+
+// offset of a field in the copy, which is the same offset in the running system
+static size_t snapshot_field_offset(snapshot_fixup_t* fx, void* field, size_t size) {
+    const size_t offset = (size_t)((uint8_t*)field - fx->copy);
+    assert((offset < snap.sys_size) && (size <= (snap.sys_size - offset)));
+    (void)size;
+    return offset;
+}
+
+void snapshot_keep(snapshot_fixup_t* fx, void* field, size_t size) {
+    assert(fx && field);
+    const size_t offset = snapshot_field_offset(fx, field, size);
+    if (fx->load) {
+        memcpy(field, snap.sys + offset, size);
+    }
+    else {
+        memset(field, 0, size);
+    }
+}
+
+// a stored pointer is 0 for null, an odd offset into the system struct, or
+// an even offset to the static data anchor (code and data move together with ASLR)
+static uintptr_t snapshot_pack(uintptr_t val) {
+    const uintptr_t sys = (uintptr_t)snap.sys;
+    if (0 == val) {
+        return 0;
+    }
+    else if ((val >= sys) && (val < (sys + snap.sys_size))) {
+        return ((val - sys) << 1) | 1;
+    }
+    else {
+        return (val - snapshot_anchor()) << 1;
+    }
+}
+
+static uintptr_t snapshot_unpack(snapshot_fixup_t* fx, uintptr_t val) {
+    if (0 == val) {
+        return 0;
+    }
+    else if (val & 1) {
+        const uintptr_t offset = val >> 1;
+        if (offset >= snap.sys_size) {
+            fx->valid = false;
+            return 0;
+        }
+        return (uintptr_t)snap.sys + offset;
+    }
+    else {
+        // shift back in the sign bit of a negative offset
+        return snapshot_anchor() + ((val >> 1) | (val & ~(UINTPTR_MAX >> 1)));
+    }
+}
+
+void snapshot_relocate(snapshot_fixup_t* fx, void* field, size_t size) {
+    assert(fx && field && (0 == (size % sizeof(uintptr_t))));
+    snapshot_field_offset(fx, field, size);
+    uint8_t* ptr = (uint8_t*) field;
+    for (size_t i = 0; i < size; i += sizeof(uintptr_t)) {
+        uintptr_t val;
+        memcpy(&val, ptr + i, sizeof(val));
+        val = fx->load ? snapshot_unpack(fx, val) : snapshot_pack(val);
+        memcpy(ptr + i, &val, sizeof(val));
+    }
+}
+
+size_t snapshot_write(void* dst, size_t dst_size) {
+    assert(snap.valid);
+    const size_t size = sizeof(snapshot_header_t) + snap.sys_size;
+    if (0 == dst) {
+        return size;
+    }
+    if (dst_size < size) {
+        return 0;
+    }
+    snapshot_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = SNAPSHOT_MAGIC;
+    hdr.version = SNAPSHOT_VERSION;
+    memcpy(hdr.system, snap.system, sizeof(hdr.system));
+    memcpy(hdr.build, snap.build, sizeof(hdr.build));
+    hdr.ptr_size = sizeof(uintptr_t);
+    hdr.sys_size = snap.sys_size;
+    uint8_t* ptr = (uint8_t*) dst;
+    memcpy(ptr, &hdr, sizeof(hdr));
+    uint8_t* data = ptr + sizeof(hdr);
+    memcpy(data, snap.sys, snap.sys_size);
+    if (snap.fixup_cb) {
+        snapshot_fixup_t fx = { .load = false, .valid = true, .copy = data };
+        snap.fixup_cb(&fx, data);
+    }
+    return size;
+}
+
+bool snapshot_read(const void* src, size_t src_size) {
+    assert(snap.valid && src);
+    snapshot_header_t hdr;
+    if (src_size < sizeof(hdr)) {
+        return false;
+    }
+    memcpy(&hdr, src, sizeof(hdr));
+    if ((hdr.magic != SNAPSHOT_MAGIC) ||
+        (hdr.version != SNAPSHOT_VERSION) ||
+        (hdr.ptr_size != sizeof(uintptr_t)) ||
+        (hdr.sys_size != snap.sys_size) ||
+        (0 != memcmp(hdr.system, snap.system, sizeof(hdr.system))) ||
+        (0 != memcmp(hdr.build, snap.build, sizeof(hdr.build))))
+    {
+        return false;
+    }
+    if (src_size != (sizeof(hdr) + snap.sys_size)) {
+        return false;
+    }
+    // fix up a copy first, so that a bad snapshot leaves the running system alone
+    uint8_t* copy = (uint8_t*) malloc(snap.sys_size);
+    if (!copy) {
+        return false;
+    }
+    memcpy(copy, (const uint8_t*)src + sizeof(hdr), snap.sys_size);
+    snapshot_fixup_t fx = { .load = true, .valid = true, .copy = copy };
+    if (snap.fixup_cb) {
+        snap.fixup_cb(&fx, copy);
+    }
+    if (fx.valid) {
+        memcpy(snap.sys, copy, snap.sys_size);
+    }
+    free(copy);
+    return fx.valid;
+}
+
+bool snapshot_slot_valid(int slot) {
+    assert(snap.valid);
+    return (slot >= 0) && (slot < SNAPSHOT_NUM_SLOTS) && (0 != snap.slots[slot].ptr);
+}
+
+bool snapshot_save(int slot) {
+    assert(snap.valid);
+    if ((slot < 0) || (slot >= SNAPSHOT_NUM_SLOTS)) {
+        return false;
+    }
+    const size_t size = snapshot_write(0, 0);
+    if (size > snap.slots[slot].size) {
+        free(snap.slots[slot].ptr);
+        snap.slots[slot].ptr = malloc(size);
+        snap.slots[slot].size = snap.slots[slot].ptr ? size : 0;
+        if (0 == snap.slots[slot].ptr) {
+            return false;
+        }
+    }
+    if (0 == (snap.slots[slot].size = snapshot_write(snap.slots[slot].ptr, snap.slots[slot].size))) {
+        free(snap.slots[slot].ptr);
+        snap.slots[slot].ptr = 0;
+        return false;
+    }
+    #if !defined(__EMSCRIPTEN__)
+    char path[64];
+    snprintf(path, sizeof(path), "%s-%d.snp", snap.system[0] ? snap.system : "snapshot", slot + 1);
+    FILE* fp = fopen(path, "wb");
+    if (fp) {
+        fwrite(snap.slots[slot].ptr, 1, snap.slots[slot].size, fp);
+        fclose(fp);
+    }
+    #endif
+    return true;
+}
+
+bool snapshot_load(int slot) {
+    assert(snap.valid);
+    if (!snapshot_slot_valid(slot)) {
+        return false;
+    }
+    return snapshot_read(snap.slots[slot].ptr, snap.slots[slot].size);
+}
+
+bool snapshot_save_file(const char* path) {
+    assert(snap.valid && path);
+    #if defined(__EMSCRIPTEN__)
+    (void)path;
+    return false;
+    #else
+    const size_t size = snapshot_write(0, 0);
+    void* buf = malloc(size);
+    if (!buf) {
+        return false;
+    }
+    const size_t written = snapshot_write(buf, size);
+    bool ok = false;
+    FILE* fp = written ? fopen(path, "wb") : 0;
+    if (fp) {
+        ok = (fwrite(buf, 1, written, fp) == written);
+        fclose(fp);
+    }
+    free(buf);
+    return ok;
+    #endif
+}
+
+bool snapshot_load_file(const char* path) {
+    assert(snap.valid && path);
+    #if defined(__EMSCRIPTEN__)
+    (void)path;
+    return false;
+    #else
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    const long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    bool ok = false;
+    void* buf = (size > 0) ? malloc((size_t)size) : 0;
+    if (buf) {
+        ok = (fread(buf, 1, (size_t)size, fp) == (size_t)size) && snapshot_read(buf, (size_t)size);
+        free(buf);
+    }
+    fclose(fp);
+    return ok;
+    #endif
+}
+
+bool snapshot_input(const sapp_event* event) {
+    if (!snap.valid || !(event->modifiers & SAPP_MODIFIER_CTRL)) {
+        return false;
+    }
+    if ((event->type != SAPP_EVENTTYPE_KEY_DOWN) && (event->type != SAPP_EVENTTYPE_KEY_UP)) {
+        return false;
+    }
+    int slot;
+    switch (event->key_code) {
+        case SAPP_KEYCODE_F1: slot = 0; break;
+        case SAPP_KEYCODE_F2: slot = 1; break;
+        case SAPP_KEYCODE_F3: slot = 2; break;
+        case SAPP_KEYCODE_F4: slot = 3; break;
+        default: return false;
+    }
+    if ((event->type == SAPP_EVENTTYPE_KEY_DOWN) && !event->key_repeat) {
+        const bool ok = (event->modifiers & SAPP_MODIFIER_SHIFT) ? snapshot_save(slot) : snapshot_load(slot);
+        if (ok) {
+            gfx_flash_success();
+        }
+        else {
+            gfx_flash_error();
+        }
+    }
+    return true;
+}
+#endif /* COMMON_IMPL */
@@ -10,6 +10,7 @@
 #include "sokol_imgui.h"
 
 static ui_draw_t ui_draw_cb;
+static bool ui_pending;
 
 void ui_init(ui_draw_t draw_cb) {
     simgui_desc_t simgui_desc = { };
@@ -31,8 +32,26 @@ void ui_draw(void) {
         ui_draw_cb();
     }
     simgui_render();
+    ui_pending = false;
 }
 
 bool ui_input(const sapp_event* event) {
+    switch (event->type) {
+        case SAPP_EVENTTYPE_KEY_DOWN:
+        case SAPP_EVENTTYPE_KEY_UP:
+        case SAPP_EVENTTYPE_CHAR:
+        case SAPP_EVENTTYPE_MOUSE_DOWN:
+        case SAPP_EVENTTYPE_MOUSE_UP:
+        case SAPP_EVENTTYPE_TOUCHES_BEGAN:
+        case SAPP_EVENTTYPE_TOUCHES_ENDED:
+            ui_pending = true;
+            break;
+        default:
+            break;
+    }
     return simgui_handle_event(event);
 }
+
+bool ui_input_pending(void) {
+    return ui_pending;
+}
@@ -12,6 +12,9 @@ void ui_init(ui_draw_t draw_cb);
 void ui_discard(void);
 void ui_draw(void);
 bool ui_input(const sapp_event* event);
+// true if ui_input() got a click or key press since the last ui_draw(),
+// only then can the next draw callback change emulator state
+bool ui_input_pending(void);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -0,0 +1,204 @@
+#pragma once
+/*
+    Automatic warp mode while the emulated system is loading from tape or disc.
+
+    The front-end provides a per-system media activity query (tape motor on,
+    floppy drive busy, ...). While it reports activity the emulator runs
+    unthrottled: each host frame executes emulated frames in a loop until a
+    host time budget is used up, audio output is muted, and only the last
+    emulated frame is presented. Normal speed resumes once the media has been
+    idle for a short while (the tape motor briefly stops between blocks).
+
+    Usage in the frame callback:
+
+        warp_begin_frame(state.frame_time_us);
+        state.ticks = 0;
+        uint32_t us;
+        while ((us = warp_exec_time()) > 0) {
+            state.ticks += xxx_exec(&sys, us);
+        }
+
+    Outside of warp mode warp_exec_time() returns the frame time once.
+
+    The mode string in warp_desc_t is meant to come from the "warp" command
+    line arg:
+
+        warp=auto   warp while media is active (default)
+        warp=on     always run unthrottled
+        warp=off    never warp
+*/
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    WARP_MODE_AUTO,
+    WARP_MODE_ON,
+    WARP_MODE_OFF,
+} warp_mode_t;
+
+typedef struct {
+    bool (*active_cb)(void);        // per-system media activity query
+    float (*progress_cb)(void);     // optional load progress 0..1, <0 if unknown
+    const char* mode;               // "auto" (default), "on" or "off"
+    uint32_t budget_us;             // host time per frame spent emulating (default: 75% of frame duration)
+    uint32_t linger_us;             // emulated time to keep warping after activity stops (default 500ms)
+} warp_desc_t;
+
+void warp_init(const warp_desc_t* desc);
+void warp_begin_frame(uint32_t frame_time_us);
+// returns microseconds to execute next, 0 when the frame is done
+uint32_t warp_exec_time(void);
+// true while warping, front-ends drop audio samples in this case
+bool warp_active(void);
+// draw a progress indicator line at the current sokol-debugtext cursor
+void warp_draw_status(void);
+
+/*== IMPLEMENTATION ==========================================================*/
+#ifdef COMMON_IMPL
+#include "sokol_app.h"
+#include "sokol_time.h"
+#include "sokol_debugtext.h"
+#include <string.h>
+#include <assert.h>
+
+// emulated time per iteration of the warp loop
+#define WARP_CHUNK_US (16667)
+
+typedef struct {
+    bool valid;
+    bool (*active_cb)(void);
+    float (*progress_cb)(void);
+    warp_mode_t mode;
+    uint32_t budget_us;
+    uint32_t linger_us;
+    bool active;
+    uint32_t linger_left_us;
+    // per-frame state
+    uint64_t frame_start;
+    uint32_t frame_time_us;
+    uint32_t num_chunks;
+    uint64_t frame_emu_us;
+    // statistics for the status line
+    uint64_t total_emu_us;      // emulated time in the current warp session
+    float speed;                // emulated time / host time, smoothed
+} warp_state_t;
+static warp_state_t warp;
+
+void warp_init(const warp_desc_t* desc) {
+    assert(desc);
+    warp = (warp_state_t) {
+        .valid = true,
+        .active_cb = desc->active_cb,
+        .progress_cb = desc->progress_cb,
+        .mode = WARP_MODE_AUTO,
+        .budget_us = desc->budget_us,
+        .linger_us = desc->linger_us ? desc->linger_us : 500000,
+    };
+    if (desc->mode) {
+        if (0 == strcmp(desc->mode, "on")) {
+            warp.mode = WARP_MODE_ON;
+        }
+        else if (0 == strcmp(desc->mode, "off")) {
+            warp.mode = WARP_MODE_OFF;
+        }
+    }
+}
+
+static bool _warp_media_active(void) {
+    switch (warp.mode) {
+        case WARP_MODE_ON:  return true;
+        case WARP_MODE_OFF: return false;
+        default:            return warp.active_cb ? warp.active_cb() : false;
+    }
+}
+
+// update the warp state after emulated_us of emulation
+static void _warp_update(uint32_t emulated_us) {
+    if (_warp_media_active()) {
+        if (!warp.active) {
+            warp.total_emu_us = 0;
+            warp.speed = 1.0f;
+        }
+        warp.active = true;
+        warp.linger_left_us = warp.linger_us;
+    }
+    else if (warp.active) {
+        if (warp.linger_left_us > emulated_us) {
+            warp.linger_left_us -= emulated_us;
+        }
+        else {
+            warp.active = false;
+            warp.linger_left_us = 0;
+        }
+    }
+}
+
+void warp_begin_frame(uint32_t frame_time_us) {
+    assert(warp.valid);
+    warp.frame_start = stm_now();
+    warp.frame_time_us = frame_time_us;
+    warp.num_chunks = 0;
+    warp.frame_emu_us = 0;
+    _warp_update(frame_time_us);
+    if (warp.active) {
+        warp.total_emu_us += frame_time_us;
+    }
+}
+
+uint32_t warp_exec_time(void) {
+    assert(warp.valid);
+    if (warp.num_chunks == 0) {
+        // the first chunk is the regular frame time, also in warp mode
+        warp.num_chunks++;
+        warp.frame_emu_us = warp.frame_time_us;
+        return warp.frame_time_us;
+    }
+    if (!warp.active) {
+        return 0;
+    }
+    _warp_update(WARP_CHUNK_US);
+    if (warp.active) {
+        warp.total_emu_us += WARP_CHUNK_US;
+    }
+    uint32_t budget_us = warp.budget_us;
+    if (budget_us == 0) {
+        budget_us = (uint32_t) (sapp_frame_duration() * 750000.0);
+    }
+    const double host_us = stm_us(stm_since(warp.frame_start));
+    if (!warp.active || (host_us >= (double)budget_us)) {
+        // frame is done, update the speed estimate from the whole frame
+        if (warp.active && (host_us > 0.0)) {
+            const float speed = (float) ((double)warp.frame_emu_us / host_us);
+            warp.speed += (speed - warp.speed) * 0.1f;
+        }
+        return 0;
+    }
+    warp.num_chunks++;
+    warp.frame_emu_us += WARP_CHUNK_US;
+    return WARP_CHUNK_US;
+}
+
+bool warp_active(void) {
+    return warp.valid && warp.active;
+}
+
+void warp_draw_status(void) {
+    if (!warp_active()) {
+        return;
+    }
+    static const char spinner[4] = { '|', '/', '-', '\\' };
+    const uint32_t secs = (uint32_t) (warp.total_emu_us / 1000000);
+    sdtx_printf("%c WARP x%.1f  %u:%02u",
+        spinner[(warp.total_emu_us / 250000) & 3], warp.speed, secs / 60, secs % 60);
+    const float progress = warp.progress_cb ? warp.progress_cb() : -1.0f;
+    if (progress >= 0.0f) {
+        const int num_bars = 20;
+        const int done = (int) (progress * num_bars + 0.5f);
+        sdtx_puts("  [");
+        for (int i = 0; i < num_bars; i++) {
+            sdtx_putc((i < done) ? '#' : '.');
+        }
+        sdtx_printf("] %d%%", (int)(progress * 100.0f + 0.5f));
+    }
+}
+#endif /* COMMON_IMPL */
@@ -42,8 +42,6 @@
 static struct {
     atom_t atom;
     uint32_t frame_time_us;
-    uint32_t ticks;
-    double emu_time_ms;
     #ifdef CHIPS_USE_UI
         ui_atom_t ui_atom;
     #endif
@@ -60,7 +58,25 @@ static struct {
 
 static void push_audio(const float* samples, int num_samples, void* user_data) {
     (void)user_data;
-    saudio_push(samples, num_samples);
+    if (!warp_active() && !runahead_active()) {
+        saudio_push(samples, num_samples);
+    }
+}
+
+// media activity query for automatic warp mode, tape loading is trapped
+// in the Atom OS, so check whether the tape position moves
+static bool warp_media_active(void) {
+    static int last_tape_pos;
+    const bool active = state.atom.tape_pos != last_tape_pos;
+    last_tape_pos = state.atom.tape_pos;
+    return active;
+}
+
+static float warp_tape_progress(void) {
+    if (state.atom.tape_size <= 0) {
+        return -1.0f;
+    }
+    return (float)state.atom.tape_pos / (float)state.atom.tape_size;
 }
 
 atom_desc_t atom_desc(atom_joystick_type_t joy_type) {
@@ -85,9 +101,25 @@ atom_desc_t atom_desc(atom_joystick_type_t joy_type) {
     };
 }
 
+// the pointers in a snapshot of the system, see snapshot.h
+static void snapshot_fixup(snapshot_fixup_t* fx, void* ptr) {
+    atom_t* sys = (atom_t*) ptr;
+    snapshot_relocate(fx, &sys->mem, sizeof(sys->mem));
+    snapshot_keep(fx, &sys->debug, sizeof(sys->debug));
+    snapshot_keep(fx, &sys->audio.callback, sizeof(sys->audio.callback));
+    snapshot_keep(fx, &sys->vdg.rgba8_buffer, sizeof(sys->vdg.rgba8_buffer));
+}
+
 #if defined(CHIPS_USE_UI)
 static void ui_draw_cb(void) {
+    const bool sync = ui_input_pending();
+    if (sync) {
+        emuthread_pause();
+    }
     ui_atom_draw(&state.ui_atom);
+    if (sync) {
+        emuthread_resume();
+    }
 }
 static void ui_boot_cb(atom_t* sys) {
     atom_desc_t desc = atom_desc(sys->joystick_type);
@@ -95,6 +127,10 @@ static void ui_boot_cb(atom_t* sys) {
 }
 #endif
 
+static uint32_t exec_frame(uint32_t frame_time_us);
+static void display_size(int* width, int* height);
+static void handle_input(const sapp_event* event);
+
 void app_init(void) {
     gfx_init(&(gfx_desc_t) {
         #ifdef CHIPS_USE_UI
@@ -104,9 +140,18 @@ void app_init(void) {
         .border_right = BORDER_RIGHT,
         .border_top = BORDER_TOP,
         .border_bottom = BORDER_BOTTOM,
+        .fb_width = atom_std_display_width(),
+        .fb_height = atom_std_display_height(),
     });
     keybuf_init(&(keybuf_desc_t){ .key_delay_frames = 10 });
     clock_init();
+    warp_init(&(warp_desc_t){
+        .active_cb = warp_media_active,
+        .progress_cb = warp_tape_progress,
+        .mode = sargs_value_def("warp", "auto"),
+    });
+    // prof-export=file.csv (summary) or file.json (Chrome trace), written at exit
+    prof_set_export(sargs_value_def("prof-export", 0));
     prof_init();
     fs_init();
     saudio_setup(&(saudio_desc){0});
@@ -118,6 +163,19 @@ void app_init(void) {
     }
     atom_desc_t desc = atom_desc(joy_type);
     atom_init(&state.atom, &desc);
+    snapshot_init(&(snapshot_desc_t){
+        .system = "atom",
+        .build = __DATE__ " " __TIME__,
+        .sys = &state.atom,
+        .sys_size = sizeof(state.atom),
+        .fixup_cb = snapshot_fixup,
+        .load_path = sargs_value_def("snapshot", 0),
+    });
+    runahead_init(&(runahead_desc_t){
+        .sys = &state.atom,
+        .sys_size = sizeof(state.atom),
+        .frames = atoi(sargs_value_def("runahead", "0")),
+    });
     #ifdef CHIPS_USE_UI
         ui_init(ui_draw_cb);
         ui_atom_init(&state.ui_atom, &(ui_atom_desc_t){
@@ -146,21 +204,46 @@ void app_init(void) {
             keybuf_put(sargs_value("input"));
         }
     }
+    emuthread_init(&(emuthread_desc_t){
+        .exec_cb = exec_frame,
+        .input_cb = handle_input,
+        .display_cb = display_size,
+        .mode = sargs_value_def("thread", "on"),
+    });
 }
 
 static void handle_file_loading(void);
-static void send_keybuf_input(void);
+static void send_keybuf_input(uint32_t frame_time_us);
 static void draw_status_bar(void);
 
+// runs on the emulation thread if enabled, see emuthread.h
+static uint32_t exec_frame(uint32_t frame_time_us) {
+    warp_begin_frame(frame_time_us);
+    uint32_t ticks = 0;
+    uint32_t exec_time_us;
+    while ((exec_time_us = warp_exec_time()) > 0) {
+        ticks += atom_exec(&state.atom, exec_time_us);
+    }
+    if (!warp_active()) {
+        while ((exec_time_us = runahead_exec_time(frame_time_us)) > 0) {
+            atom_exec(&state.atom, exec_time_us);
+        }
+    }
+    send_keybuf_input(frame_time_us);
+    return ticks;
+}
+
+static void display_size(int* width, int* height) {
+    *width = atom_display_width(&state.atom);
+    *height = atom_display_height(&state.atom);
+}
+
 void app_frame(void) {
     state.frame_time_us = clock_frame_time();
-    const uint64_t emu_start_time = stm_now();
-    state.ticks = atom_exec(&state.atom, state.frame_time_us);
-    state.emu_time_ms = stm_ms(stm_since(emu_start_time));
+    emuthread_frame(state.frame_time_us);
     draw_status_bar();
-    gfx_draw(atom_display_width(&state.atom), atom_display_height(&state.atom));
+    gfx_draw(emuthread_display_width(), emuthread_display_height());
     handle_file_loading();
-    send_keybuf_input();
 }
 
 /* keyboard input handling */
@@ -175,6 +258,14 @@ void app_input(const sapp_event* event) {
         return;
     }
     #endif
+    emuthread_input(event);
+}
+
+// applies input events to the emulator, on the emulation thread if enabled
+static void handle_input(const sapp_event* event) {
+    if (snapshot_input(event)) {
+        return;
+    }
     int c = 0;
     switch (event->type) {
         case SAPP_EVENTTYPE_CHAR:
@@ -222,19 +313,21 @@ void app_input(const sapp_event* event) {
 }
 
 void app_cleanup(void) {
+    emuthread_shutdown();
     atom_discard(&state.atom);
     #ifdef CHIPS_USE_UI
         ui_atom_discard(&state.ui_atom);
         ui_discard();
     #endif
+    prof_shutdown();
     saudio_shutdown();
     gfx_shutdown();
     sargs_shutdown();
 }
 
-static void send_keybuf_input(void) {
+static void send_keybuf_input(uint32_t frame_time_us) {
     uint8_t key_code;
-    if (0 != (key_code = keybuf_get(state.frame_time_us))) {
+    if (0 != (key_code = keybuf_get(frame_time_us))) {
         atom_key_down(&state.atom, key_code);
         atom_key_up(&state.atom, key_code);
     }
@@ -242,8 +335,13 @@ static void send_keybuf_input(void) {
 
 static void handle_file_loading(void) {
     fs_dowork();
+    if (fs_failed()) {
+        gfx_flash_error();
+        fs_reset();
+    }
     const uint32_t load_delay_frames = 48;
     if (fs_ptr() && clock_frame_count_60hz() > load_delay_frames) {
+        emuthread_pause();
         bool load_success = false;
         if (fs_ext("txt") || fs_ext("bas")) {
             load_success = true;
@@ -264,18 +362,27 @@ static void handle_file_loading(void) {
             gfx_flash_error();
         }
         fs_reset();
+        emuthread_resume();
     }
 }
 
 static void draw_status_bar(void) {
-    prof_push(PROF_EMU, (float)state.emu_time_ms);
+    prof_push(PROF_FRAME, (float)state.frame_time_us * 0.001f);
+    prof_push(PROF_EMU, (float)emuthread_exec_time_ms());
+    prof_stats_t frame_stats = prof_stats(PROF_FRAME);
+    prof_percentiles_t frame_pct = prof_percentiles(PROF_FRAME);
     prof_stats_t emu_stats = prof_stats(PROF_EMU);
+    prof_percentiles_t emu_pct = prof_percentiles(PROF_EMU);
     const float w = sapp_widthf();
     const float h = sapp_heightf();
     sdtx_canvas(w, h);
     sdtx_color3b(255, 255, 255);
     sdtx_pos(1.0f, (h / 8.0f) - 1.5f);
-    sdtx_printf("frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d", (float)state.frame_time_us * 0.001f, emu_stats.avg_val, emu_stats.min_val, emu_stats.max_val, state.ticks);
+    sdtx_printf("frame:%.2fms p95:%.2f p99:%.2f emu:%.2fms p95:%.2f p99:%.2f ticks:%d", frame_stats.avg_val, frame_pct.p95_val, frame_pct.p99_val, emu_stats.avg_val, emu_pct.p95_val, emu_pct.p99_val, emuthread_ticks());
+    sdtx_pos(1.0f, (h / 8.0f) - 2.5f);
+    warp_draw_status();
+    sdtx_pos(1.0f, (h / 8.0f) - 3.5f);
+    runahead_draw_status();
 }
 
 sapp_desc sokol_main(int argc, char* argv[]) {
@@ -47,7 +47,19 @@ static struct {
 
 static void push_audio(const float* samples, int num_samples, void* user_data) {
     (void)user_data;
-    saudio_push(samples, num_samples);
+    if (!runahead_active()) {
+        saudio_push(samples, num_samples);
+    }
+}
+
+// the pointers in a snapshot of the system, see snapshot.h
+static void snapshot_fixup(snapshot_fixup_t* fx, void* ptr) {
+    bombjack_t* sys = (bombjack_t*) ptr;
+    snapshot_relocate(fx, &sys->mainboard.mem, sizeof(sys->mainboard.mem));
+    snapshot_relocate(fx, &sys->soundboard.mem, sizeof(sys->soundboard.mem));
+    snapshot_keep(fx, &sys->debug, sizeof(sys->debug));
+    snapshot_keep(fx, &sys->audio.callback, sizeof(sys->audio.callback));
+    snapshot_keep(fx, &sys->pixel_buffer, sizeof(sys->pixel_buffer));
 }
 
 #if defined(CHIPS_USE_UI)
@@ -65,11 +77,15 @@ static void app_init(void) {
         .border_right = BORDER_RIGHT,
         .border_top = BORDER_TOP,
         .border_bottom = BORDER_BOTTOM,
+        .fb_width = bombjack_std_display_width(),
+        .fb_height = bombjack_std_display_height(),
         .emu_aspect_x = 4,
         .emu_aspect_y = 5,
         .rot90 = true
     });
     clock_init();
+    // prof-export=file.csv (summary) or file.json (Chrome trace), written at exit
+    prof_set_export(sargs_value_def("prof-export", 0));
     prof_init();
     saudio_setup(&(saudio_desc){0});
     bombjack_init(&state.sys, &(bombjack_desc_t){
@@ -100,6 +116,17 @@ static void app_init(void) {
         .debug = ui_bombjack_get_debug(&state.ui),
         #endif
     });
+    snapshot_init(&(snapshot_desc_t){
+        .system = "bombjack",
+        .build = __DATE__ " " __TIME__,
+        .sys = &state.sys,
+        .sys_size = sizeof(state.sys),
+        .fixup_cb = snapshot_fixup,
+    });
+    runahead_init(&(runahead_desc_t){
+        .sys = &state.sys,
+        .sys_size = sizeof(state.sys),
+    });
     #ifdef CHIPS_USE_UI
         ui_init(ui_draw_cb);
         ui_bombjack_init(&state.ui, &(ui_bombjack_desc_t){
@@ -125,6 +152,10 @@ static void app_frame(void) {
     state.frame_time_us = clock_frame_time();
     const uint64_t emu_start_time = stm_now();
     state.ticks = bombjack_exec(&state.sys, state.frame_time_us);
+    uint32_t ahead_us;
+    while ((ahead_us = runahead_exec_time(state.frame_time_us)) > 0) {
+        bombjack_exec(&state.sys, ahead_us);
+    }
     state.emu_time_ms = stm_ms(stm_since(emu_start_time));
     //draw_status_bar();
     gfx_draw(bombjack_display_width(&state.sys), bombjack_display_height(&state.sys));
@@ -138,6 +169,9 @@ static void app_input(const sapp_event* event) {
         return;
     }
     #endif
+    if (snapshot_input(event)) {
+        return;
+    }
     switch (event->type) {
         case SAPP_EVENTTYPE_KEY_DOWN:
             switch (event->key_code) {
@@ -178,23 +212,29 @@ static void app_cleanup(void) {
     #ifdef CHIPS_USE_UI
         ui_bombjack_discard(&state.ui);
     #endif
+    prof_shutdown();
     saudio_shutdown();
     gfx_shutdown();
+    sargs_shutdown();
 }
 
 static void draw_status_bar(void) {
+    prof_push(PROF_FRAME, (float)state.frame_time_us * 0.001f);
     prof_push(PROF_EMU, (float)state.emu_time_ms);
+    prof_stats_t frame_stats = prof_stats(PROF_FRAME);
+    prof_percentiles_t frame_pct = prof_percentiles(PROF_FRAME);
     prof_stats_t emu_stats = prof_stats(PROF_EMU);
+    prof_percentiles_t emu_pct = prof_percentiles(PROF_EMU);
     const float w = sapp_widthf();
     const float h = sapp_heightf();
     sdtx_canvas(w, h);
     sdtx_color3b(255, 255, 255);
     sdtx_pos(1.0f, (h / 8.0f) - 1.5f);
-    sdtx_printf("frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d", (float)state.frame_time_us * 0.001f, emu_stats.avg_val, emu_stats.min_val, emu_stats.max_val, state.ticks);
+    sdtx_printf("frame:%.2fms p95:%.2f p99:%.2f emu:%.2fms p95:%.2f p99:%.2f ticks:%d", frame_stats.avg_val, frame_pct.p95_val, frame_pct.p99_val, emu_stats.avg_val, emu_pct.p95_val, emu_pct.p99_val, state.ticks);
 }
 
 sapp_desc sokol_main(int argc, char* argv[]) {
-    (void)argc; (void)argv;
+    sargs_setup(&(sargs_desc){ .argc=argc, .argv=argv });
     return (sapp_desc) {
         .init_cb = app_init,
         .frame_cb = app_frame,
@@ -36,8 +36,6 @@
 static struct {
     c64_t c64;
     uint32_t frame_time_us;
-    uint32_t ticks;
-    double emu_time_ms;
     #ifdef CHIPS_USE_UI
         ui_c64_t ui_c64;
     #endif
@@ -55,7 +53,19 @@ static struct {
 // audio-streaming callback
 static void push_audio(const float* samples, int num_samples, void* user_data) {
     (void)user_data;
-    saudio_push(samples, num_samples);
+    if (!warp_active() && !runahead_active()) {
+        saudio_push(samples, num_samples);
+    }
+}
+
+// fast paste: the KERNAL keyboard buffer (count at $C6) has been emptied
+static bool keybuf_ready(void) {
+    return 0 == mem_rd(&state.c64.mem_cpu, 0xC6);
+}
+
+// media activity query for automatic warp mode
+static bool warp_media_active(void) {
+    return c64_is_tape_motor_on(&state.c64);
 }
 
 // get c64_desc_t struct based on joystick type
@@ -87,9 +97,27 @@ c64_desc_t c64_desc(c64_joystick_type_t joy_type, bool c1530_enabled, bool c1541
     };
 }
 
+// the pointers in a snapshot of the system, see snapshot.h
+static void snapshot_fixup(snapshot_fixup_t* fx, void* ptr) {
+    c64_t* sys = (c64_t*) ptr;
+    snapshot_relocate(fx, &sys->mem_cpu, sizeof(sys->mem_cpu));
+    snapshot_relocate(fx, &sys->mem_vic, sizeof(sys->mem_vic));
+    snapshot_relocate(fx, &sys->c1541.mem, sizeof(sys->c1541.mem));
+    snapshot_keep(fx, &sys->debug, sizeof(sys->debug));
+    snapshot_keep(fx, &sys->audio.callback, sizeof(sys->audio.callback));
+    snapshot_keep(fx, &sys->vic.crt.rgba8_buffer, sizeof(sys->vic.crt.rgba8_buffer));
+}
+
 #if defined(CHIPS_USE_UI)
 static void ui_draw_cb(void) {
+    const bool sync = ui_input_pending();
+    if (sync) {
+        emuthread_pause();
+    }
     ui_c64_draw(&state.ui_c64);
+    if (sync) {
+        emuthread_resume();
+    }
 }
 static void ui_boot_cb(c64_t* sys) {
     c64_desc_t desc = c64_desc(sys->joystick_type, sys->c1530.valid, sys->c1541.valid);
@@ -97,6 +125,10 @@ static void ui_boot_cb(c64_t* sys) {
 }
 #endif
 
+static uint32_t exec_frame(uint32_t frame_time_us);
+static void display_size(int* width, int* height);
+static void handle_input(const sapp_event* event);
+
 void app_init(void) {
     gfx_init(&(gfx_desc_t){
         #ifdef CHIPS_USE_UI
@@ -107,8 +139,14 @@ void app_init(void) {
         .border_top = BORDER_TOP,
         .border_bottom = BORDER_BOTTOM,
     });
-    keybuf_init(&(keybuf_desc_t){ .key_delay_frames=5 });
+    keybuf_init(&(keybuf_desc_t){ .key_delay_frames=2, .ready_cb=keybuf_ready });
     clock_init();
+    warp_init(&(warp_desc_t){
+        .active_cb = warp_media_active,
+        .mode = sargs_value_def("warp", "auto"),
+    });
+    // prof-export=file.csv (summary) or file.json (Chrome trace), written at exit
+    prof_set_export(sargs_value_def("prof-export", 0));
     prof_init();
     fs_init();
     saudio_setup(&(saudio_desc){0});
@@ -128,6 +166,25 @@ void app_init(void) {
     bool c1541_enabled = sargs_exists("c1541");
     c64_desc_t desc = c64_desc(joy_type, c1530_enabled, c1541_enabled);
     c64_init(&state.c64, &desc);
+    snapshot_init(&(snapshot_desc_t){
+        .system = "c64",
+        .build = __DATE__ " " __TIME__,
+        .sys = &state.c64,
+        .sys_size = sizeof(state.c64),
+        .fixup_cb = snapshot_fixup,
+        .load_path = sargs_value_def("snapshot", 0),
+    });
+    // a snapshot from the command line replaces the boot state, don't cache it
+    bootcache_init(&(bootcache_desc_t){
+        .system = "c64",
+        .boot_frames = 180,
+        .mode = sargs_exists("snapshot") ? "off" : sargs_value_def("bootcache", "on"),
+    });
+    runahead_init(&(runahead_desc_t){
+        .sys = &state.c64,
+        .sys_size = sizeof(state.c64),
+        .frames = atoi(sargs_value_def("runahead", "0")),
+    });
     #ifdef CHIPS_USE_UI
         ui_init(ui_draw_cb);
         ui_c64_init(&state.ui_c64, &(ui_c64_desc_t){
@@ -159,21 +216,47 @@ void app_init(void) {
             keybuf_put(sargs_value("input"));
         }
     }
+    emuthread_init(&(emuthread_desc_t){
+        .exec_cb = exec_frame,
+        .input_cb = handle_input,
+        .display_cb = display_size,
+        .mode = sargs_value_def("thread", "on"),
+    });
 }
 
 static void handle_file_loading(void);
-static void send_keybuf_input(void);
+static void send_keybuf_input(uint32_t frame_time_us);
 static void draw_status_bar(void);
 
+// runs on the emulation thread if enabled, see emuthread.h
+static uint32_t exec_frame(uint32_t frame_time_us) {
+    warp_begin_frame(frame_time_us);
+    uint32_t ticks = 0;
+    uint32_t exec_time_us;
+    while ((exec_time_us = warp_exec_time()) > 0) {
+        ticks += c64_exec(&state.c64, exec_time_us);
+        bootcache_frame(exec_time_us);
+    }
+    if (!warp_active()) {
+        while ((exec_time_us = runahead_exec_time(frame_time_us)) > 0) {
+            c64_exec(&state.c64, exec_time_us);
+        }
+    }
+    send_keybuf_input(frame_time_us);
+    return ticks;
+}
+
+static void display_size(int* width, int* height) {
+    *width = c64_display_width(&state.c64);
+    *height = c64_display_height(&state.c64);
+}
+
 void app_frame(void) {
     state.frame_time_us = clock_frame_time();
-    const uint64_t emu_start_time = stm_now();
-    state.ticks = c64_exec(&state.c64, state.frame_time_us);
-    state.emu_time_ms = stm_ms(stm_since(emu_start_time));
+    emuthread_frame(state.frame_time_us);
     draw_status_bar();
-    gfx_draw(c64_display_width(&state.c64), c64_display_height(&state.c64));
+    gfx_draw(emuthread_display_width(), emuthread_display_height());
     handle_file_loading();
-    send_keybuf_input();
 }
 
 void app_input(const sapp_event* event) {
@@ -187,6 +270,14 @@ void app_input(const sapp_event* event) {
         return;
     }
     #endif
+    emuthread_input(event);
+}
+
+// applies input events to the emulator, on the emulation thread if enabled
+static void handle_input(const sapp_event* event) {
+    if (snapshot_input(event)) {
+        return;
+    }
     const bool shift = event->modifiers & SAPP_MODIFIER_SHIFT;
     switch (event->type) {
         int c;
@@ -240,19 +331,21 @@ void app_input(const sapp_event* event) {
 }
 
 void app_cleanup(void) {
+    emuthread_shutdown();
     c64_discard(&state.c64);
     #ifdef CHIPS_USE_UI
         ui_c64_discard(&state.ui_c64);
         ui_discard();
     #endif
+    prof_shutdown();
     saudio_shutdown();
     gfx_shutdown();
     sargs_shutdown();
 }
 
-static void send_keybuf_input(void) {
+static void send_keybuf_input(uint32_t frame_time_us) {
     uint8_t key_code;
-    if (0 != (key_code = keybuf_get(state.frame_time_us))) {
+    if (0 != (key_code = keybuf_get(frame_time_us))) {
         /* FIXME: this is ugly */
         c64_joystick_type_t joy_type = state.c64.joystick_type;
         state.c64.joystick_type = C64_JOYSTICKTYPE_NONE;
@@ -262,36 +355,62 @@ static void send_keybuf_input(void) {
     }
 }
 
+// instant tape loading: decode a standard KERNAL tape into a .prg and quickload it,
+// the rest of the tape goes into the tape drive for multi-part programs and loaders
+static bool tape_quickload(void) {
+    static uint8_t prg[0x10002];
+    // relocatable programs go to the BASIC start like with LOAD
+    const uint16_t txttab = mem_rd(&state.c64.mem_cpu, 0x2B) | (mem_rd(&state.c64.mem_cpu, 0x2C) << 8);
+    int tap_end = 0;
+    const int prg_size = cbmtape_to_prg(fs_ptr(), (int)fs_size(), txttab, prg, sizeof(prg), &tap_end);
+    if ((prg_size == 0) || !c64_quickload(&state.c64, prg, prg_size)) {
+        return false;
+    }
+    uint8_t* tail = (uint8_t*) malloc(fs_size());
+    const int tail_size = tail ? cbmtape_tail(fs_ptr(), (int)fs_size(), tap_end, tail, (int)fs_size()) : 0;
+    if ((tail_size > 0) && c64_insert_tape(&state.c64, tail, tail_size)) {
+        // the KERNAL starts the motor when the program loads the next part
+        c64_tape_play(&state.c64);
+    }
+    free(tail);
+    return true;
+}
+
 static void handle_file_loading(void) {
     fs_dowork();
-    const uint32_t load_delay_frames = 180;
-    if (fs_ptr() && clock_frame_count_60hz() > load_delay_frames) {
+    if (fs_failed()) {
+        gfx_flash_error();
+        fs_reset();
+    }
+    if (fs_ptr() && bootcache_ready()) {
+        emuthread_pause();
         bool load_success = false;
+        bool tape_loaded = false;
         if (fs_ext("txt") || fs_ext("bas")) {
             load_success = true;
             keybuf_put((const char*)fs_ptr());
         }
         else if (fs_ext("tap")) {
-            load_success = c64_insert_tape(&state.c64, fs_ptr(), fs_size());
+            // with tape=fast, standard KERNAL tapes load instantly, others go through the tape drive
+            tape_loaded = sargs_equals("tape", "fast") && tape_quickload();
+            load_success = tape_loaded || c64_insert_tape(&state.c64, fs_ptr(), fs_size());
         }
         else if (fs_ext("bin") || fs_ext("prg") || fs_ext("")) {
             load_success = c64_quickload(&state.c64, fs_ptr(), fs_size());
         }
         if (load_success) {
-            if (clock_frame_count_60hz() > (load_delay_frames + 10)) {
-                gfx_flash_success();
-            }
-            if (fs_ext("tap")) {
+            gfx_flash_success();
+            if (fs_ext("tap") && !tape_loaded) {
                 c64_tape_play(&state.c64);
             }
             if (!sargs_exists("debug")) {
                 if (sargs_exists("input")) {
                     keybuf_put(sargs_value("input"));
                 }
-                else if (fs_ext("tap")) {
+                else if (fs_ext("tap") && !tape_loaded) {
                     keybuf_put("LOAD\n");
                 }
-                else if (fs_ext("prg")) {
+                else if (fs_ext("prg") || tape_loaded) {
                     keybuf_put("RUN\n");
                 }
             }
@@ -300,18 +419,27 @@ static void handle_file_loading(void) {
             gfx_flash_error();
         }
         fs_reset();
+        emuthread_resume();
     }
 }
 
 static void draw_status_bar(void) {
-    prof_push(PROF_EMU, (float)state.emu_time_ms);
+    prof_push(PROF_FRAME, (float)state.frame_time_us * 0.001f);
+    prof_push(PROF_EMU, (float)emuthread_exec_time_ms());
+    prof_stats_t frame_stats = prof_stats(PROF_FRAME);
+    prof_percentiles_t frame_pct = prof_percentiles(PROF_FRAME);
     prof_stats_t emu_stats = prof_stats(PROF_EMU);
+    prof_percentiles_t emu_pct = prof_percentiles(PROF_EMU);
     const float w = sapp_widthf();
     const float h = sapp_heightf();
     sdtx_canvas(w, h);
     sdtx_color3b(255, 255, 255);
     sdtx_pos(1.0f, (h / 8.0f) - 1.5f);
-    sdtx_printf("frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d", (float)state.frame_time_us * 0.001f, emu_stats.avg_val, emu_stats.min_val, emu_stats.max_val, state.ticks);
+    sdtx_printf("frame:%.2fms p95:%.2f p99:%.2f emu:%.2fms p95:%.2f p99:%.2f ticks:%d", frame_stats.avg_val, frame_pct.p95_val, frame_pct.p99_val, emu_stats.avg_val, emu_pct.p95_val, emu_pct.p99_val, emuthread_ticks());
+    sdtx_pos(1.0f, (h / 8.0f) - 2.5f);
+    warp_draw_status();
+    sdtx_pos(1.0f, (h / 8.0f) - 3.5f);
+    runahead_draw_status();
 }
 
 sapp_desc sokol_main(int argc, char* argv[]) {
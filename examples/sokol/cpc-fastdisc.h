@@ -0,0 +1,181 @@
+#pragma once
+/*
+    cpc-fastdisc.h
+
+    Opt-in accelerated disc sector transfer for the CPC 6128.
+
+    AMSDOS reads the data of a sector with this loop in its ROM (at $C6DF
+    in the 6128 AMSDOS), with interrupts disabled and BC = $FB7E (the
+    uPD765 main status register, C+1 is the data register):
+
+        loop:   INC C
+                IN A,(C)        ; read data byte
+                LD (HL),A
+                DEC C
+                INC HL
+        head:   IN A,(C)        ; read main status
+                JP P,head       ; wait for RQM
+                AND $20         ; still in execution phase?
+                JR NZ,loop
+                RET
+
+    The uPD765 emulation has the next byte ready immediately, so the loop
+    spends about 20 microseconds per byte only because of the Z80
+    instructions. The fast path hooks into the debug callback, and when
+    the CPU is about to execute the loop head while the FDC is in the
+    execution phase, it drains the sector through the FDC data register
+    into memory at HL in one go. It then updates HL and the R register like
+    the skipped iterations would have, and lets the CPU run the loop head
+    on its own. That head then sees the result phase and returns. The
+    loop is found by its instruction bytes instead of a fixed address.
+    Other loaders read the FDC with their own code and are not
+    accelerated.
+
+    The skipped iterations take no emulated time, so loading finishes
+    earlier. All other hardware keeps its cycle timing. Because the
+    loop runs with interrupts disabled, the loaded bytes are the same.
+    Firmware timers and whatever runs after loading will differ, though.
+    To compare the modes, every sector read goes into a checksum of its
+    destination address and data bytes. In standard mode the bytes are
+    taken when the CPU stores them. The two modes must produce the same
+    checksum (see tests/cpc-bench.c).
+
+    Include after systems/cpc.h. The hook goes into cpc_desc_t.debug, with
+    an optional chained debug callback for the UI debugger:
+
+        .debug = {
+            .callback = { .func = cpc_fastdisc_tick, .user_data = &fastdisc },
+            .stopped = &fastdisc.stopped,   // or the UI debugger's flag
+        },
+
+    Installing the hook moves cpc_exec() to its per-tick debug loop, so
+    only install it when the fast path is wanted.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// BC while AMSDOS polls the FDC main status register
+#define CPC_FASTDISC_STATUS_PORT (0xFB7E)
+// R register increments per skipped loop iteration (M1 cycles, ED prefix counts twice)
+#define CPC_FASTDISC_LOOP_R (11)
+// upper bound for one bulk transfer, the rest is left to the CPU
+#define CPC_FASTDISC_MAX_BYTES (0x4000)
+
+typedef struct {
+    cpc_t* sys;
+    bool enabled;           // bulk-transfer sectors, otherwise only observe
+    void (*chain_func)(void* user_data, uint64_t pins);   // optional, called first
+    void* chain_user_data;
+} cpc_fastdisc_desc_t;
+
+typedef struct {
+    cpc_t* sys;
+    bool enabled;
+    bool stopped;           // for cpc_desc_t.debug.stopped without a chained debugger
+    void (*chain_func)(void* user_data, uint64_t pins);
+    void* chain_user_data;
+    // the sector read in progress
+    bool active;
+    uint16_t head_addr;
+    // statistics
+    uint32_t num_sectors;
+    uint32_t num_fast_sectors;
+    uint32_t num_fast_bytes;
+    uint32_t data_hash;     // FNV-1a over all sector reads (destination address and data)
+} cpc_fastdisc_t;
+
+// the AMSDOS read loop, with its head at offset 6
+static const uint8_t cpc_fastdisc_loop[] = {
+    0x0C, 0xED, 0x78, 0x77, 0x0D, 0x23,
+    0xED, 0x78, 0xF2, 0x00, 0x00, 0xE6, 0x20, 0x20, 0xF1,
+};
+#define CPC_FASTDISC_HEAD_OFFSET (6)
+
+static void cpc_fastdisc_init(cpc_fastdisc_t* fd, const cpc_fastdisc_desc_t* desc) {
+    CHIPS_ASSERT(fd && desc && desc->sys);
+    memset(fd, 0, sizeof(cpc_fastdisc_t));
+    fd->sys = desc->sys;
+    fd->enabled = desc->enabled;
+    fd->chain_func = desc->chain_func;
+    fd->chain_user_data = desc->chain_user_data;
+    fd->data_hash = 0x811C9DC5;
+}
+
+static void _cpc_fastdisc_hash(cpc_fastdisc_t* fd, uint8_t val) {
+    fd->data_hash = (fd->data_hash ^ val) * 0x01000193;
+}
+
+static uint8_t _cpc_fastdisc_status(cpc_t* sys) {
+    return UPD765_GET_DATA(upd765_iorq(&sys->fdc, UPD765_CS|UPD765_RD));
+}
+
+// check for the read loop around the opcode fetch at head_addr
+static bool _cpc_fastdisc_at_loop(cpc_t* sys, uint16_t head_addr) {
+    const uint16_t addr = head_addr - CPC_FASTDISC_HEAD_OFFSET;
+    for (uint16_t i = 0; i < sizeof(cpc_fastdisc_loop); i++) {
+        uint8_t expected = cpc_fastdisc_loop[i];
+        if (i == (CPC_FASTDISC_HEAD_OFFSET + 3)) {
+            expected = head_addr & 0xFF;
+        }
+        else if (i == (CPC_FASTDISC_HEAD_OFFSET + 4)) {
+            expected = head_addr >> 8;
+        }
+        if (mem_rd(&sys->mem, addr + i) != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// read data bytes to HL while the FDC is in the execution phase, like the loop does
+static void _cpc_fastdisc_transfer(cpc_fastdisc_t* fd) {
+    cpc_t* sys = fd->sys;
+    const uint8_t mask = UPD765_STATUS_RQM|UPD765_STATUS_EXM;
+    uint16_t addr = sys->cpu.hl;
+    uint32_t num = 0;
+    while ((num < CPC_FASTDISC_MAX_BYTES) && ((_cpc_fastdisc_status(sys) & mask) == mask)) {
+        const uint8_t data = UPD765_GET_DATA(upd765_iorq(&sys->fdc, UPD765_CS|UPD765_RD|UPD765_A0));
+        mem_wr(&sys->mem, addr++, data);
+        _cpc_fastdisc_hash(fd, data);
+        num++;
+    }
+    sys->cpu.hl = addr;
+    sys->cpu.r = (sys->cpu.r & 0x80) | ((sys->cpu.r + num * CPC_FASTDISC_LOOP_R) & 0x7F);
+    fd->num_fast_sectors++;
+    fd->num_fast_bytes += num;
+}
+
+// called by cpc_exec() after each tick
+static void cpc_fastdisc_tick(void* user_data, uint64_t pins) {
+    cpc_fastdisc_t* fd = (cpc_fastdisc_t*) user_data;
+    if (fd->chain_func) {
+        fd->chain_func(fd->chain_user_data, pins);
+    }
+    cpc_t* sys = fd->sys;
+    if (fd->active) {
+        if (z80_opdone(&sys->cpu)) {
+            if ((uint16_t)(sys->cpu.pc - 1) == (uint16_t)(fd->head_addr - 3)) {
+                // about to store a data byte read by the CPU: LD (HL),A
+                _cpc_fastdisc_hash(fd, sys->cpu.af >> 8);
+            }
+            else if (!(_cpc_fastdisc_status(sys) & UPD765_STATUS_EXM)) {
+                fd->active = false;
+                fd->num_sectors++;
+            }
+        }
+    }
+    else if (z80_opdone(&sys->cpu) && (sys->cpu.bc == CPC_FASTDISC_STATUS_PORT)) {
+        // at opdone the opcode fetch has been issued, PC is one past it
+        const uint16_t head_addr = sys->cpu.pc - 1;
+        if ((_cpc_fastdisc_status(sys) & UPD765_STATUS_EXM) && _cpc_fastdisc_at_loop(sys, head_addr)) {
+            fd->active = true;
+            fd->head_addr = head_addr;
+            _cpc_fastdisc_hash(fd, sys->cpu.hl & 0xFF);
+            _cpc_fastdisc_hash(fd, sys->cpu.hl >> 8);
+            if (fd->enabled) {
+                _cpc_fastdisc_transfer(fd);
+            }
+        }
+    }
+}
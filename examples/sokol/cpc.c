@@ -18,6 +18,7 @@
 #include "chips/fdd_cpc.h"
 #include "systems/cpc.h"
 #include "cpc-roms.h"
+#include "cpc-fastdisc.h"
 #if defined(CHIPS_USE_UI)
     #define UI_DBG_USE_Z80
     #include "ui.h"
@@ -40,9 +41,8 @@
 
 static struct {
     cpc_t cpc;
+    cpc_fastdisc_t fastdisc;
     uint32_t frame_time_us;
-    uint32_t ticks;
-    double emu_time_ms;
     #if defined(CHIPS_USE_UI)
         ui_cpc_t ui_cpc;
     #endif
@@ -60,12 +60,19 @@ static struct {
 // audio-streaming callback
 static void push_audio(const float* samples, int num_samples, void* user_data) {
     (void)user_data;
-    saudio_push(samples, num_samples);
+    if (!warp_active() && !runahead_active()) {
+        saudio_push(samples, num_samples);
+    }
+}
+
+// media activity query for automatic warp mode
+static bool warp_media_active(void) {
+    return state.cpc.fdd.motor_on;
 }
 
 // get cpc_desc_t struct based on model and joystick type
 cpc_desc_t cpc_desc(cpc_type_t type, cpc_joystick_type_t joy_type) {
-    return (cpc_desc_t) {
+    cpc_desc_t desc = {
         .type = type,
         .joystick_type = joy_type,
         .pixel_buffer = { .ptr=gfx_framebuffer(), .size=gfx_framebuffer_size() },
@@ -92,11 +99,48 @@ cpc_desc_t cpc_desc(cpc_type_t type, cpc_joystick_type_t joy_type) {
         .debug = ui_cpc_get_debug(&state.ui_cpc),
         #endif
     };
+    // opt-in fast AMSDOS sector transfer (disc=fast), chains the UI debugger
+    if (sargs_equals("disc", "fast")) {
+        cpc_fastdisc_init(&state.fastdisc, &(cpc_fastdisc_desc_t){
+            .sys = &state.cpc,
+            .enabled = true,
+            .chain_func = desc.debug.callback.func,
+            .chain_user_data = desc.debug.callback.user_data,
+        });
+        desc.debug.callback.func = cpc_fastdisc_tick;
+        desc.debug.callback.user_data = &state.fastdisc;
+        if (!desc.debug.stopped) {
+            desc.debug.stopped = &state.fastdisc.stopped;
+        }
+    }
+    return desc;
+}
+
+// the pointers in a snapshot of the system, see snapshot.h
+static void snapshot_fixup(snapshot_fixup_t* fx, void* ptr) {
+    cpc_t* sys = (cpc_t*) ptr;
+    snapshot_relocate(fx, &sys->mem, sizeof(sys->mem));
+    snapshot_keep(fx, &sys->debug, sizeof(sys->debug));
+    snapshot_keep(fx, &sys->audio.callback, sizeof(sys->audio.callback));
+    snapshot_keep(fx, &sys->ga.rgba8_buffer, sizeof(sys->ga.rgba8_buffer));
+    snapshot_keep(fx, &sys->fdc.seektrack_cb, sizeof(sys->fdc.seektrack_cb));
+    snapshot_keep(fx, &sys->fdc.seeksector_cb, sizeof(sys->fdc.seeksector_cb));
+    snapshot_keep(fx, &sys->fdc.read_cb, sizeof(sys->fdc.read_cb));
+    snapshot_keep(fx, &sys->fdc.trackinfo_cb, sizeof(sys->fdc.trackinfo_cb));
+    snapshot_keep(fx, &sys->fdc.driveinfo_cb, sizeof(sys->fdc.driveinfo_cb));
+    snapshot_keep(fx, &sys->fdc.user_data, sizeof(sys->fdc.user_data));
 }
 
 #if defined(CHIPS_USE_UI)
 void ui_draw_cb(void) {
+    const bool sync = ui_input_pending();
+    if (sync) {
+        emuthread_pause();
+    }
     ui_cpc_draw(&state.ui_cpc);
+    if (sync) {
+        emuthread_resume();
+    }
 }
 static void ui_boot_cb(cpc_t* sys, cpc_type_t type) {
     cpc_desc_t desc = cpc_desc(type, sys->joystick_type);
@@ -104,6 +148,10 @@ static void ui_boot_cb(cpc_t* sys, cpc_type_t type) {
 }
 #endif
 
+static uint32_t exec_frame(uint32_t frame_time_us);
+static void display_size(int* width, int* height);
+static void handle_input(const sapp_event* event);
+
 void app_init(void) {
     gfx_init(&(gfx_desc_t){
         #ifdef CHIPS_USE_UI
@@ -117,6 +165,12 @@ void app_init(void) {
     });
     keybuf_init(&(keybuf_desc_t) { .key_delay_frames=7 });
     clock_init();
+    warp_init(&(warp_desc_t){
+        .active_cb = warp_media_active,
+        .mode = sargs_value_def("warp", "auto"),
+    });
+    // prof-export=file.csv (summary) or file.json (Chrome trace), written at exit
+    prof_set_export(sargs_value_def("prof-export", 0));
     prof_init();
     saudio_setup(&(saudio_desc){0});
     fs_init();
@@ -135,6 +189,19 @@ void app_init(void) {
     }
     cpc_desc_t desc = cpc_desc(type, joy_type);
     cpc_init(&state.cpc, &desc);
+    snapshot_init(&(snapshot_desc_t){
+        .system = "cpc",
+        .build = __DATE__ " " __TIME__,
+        .sys = &state.cpc,
+        .sys_size = sizeof(state.cpc),
+        .fixup_cb = snapshot_fixup,
+        .load_path = sargs_value_def("snapshot", 0),
+    });
+    runahead_init(&(runahead_desc_t){
+        .sys = &state.cpc,
+        .sys_size = sizeof(state.cpc),
+        .frames = atoi(sargs_value_def("runahead", "0")),
+    });
     #ifdef CHIPS_USE_UI
         ui_init(ui_draw_cb);
         ui_cpc_init(&state.ui_cpc, &(ui_cpc_desc_t){
@@ -164,21 +231,46 @@ void app_init(void) {
             keybuf_put(sargs_value("input"));
         }
     }
+    emuthread_init(&(emuthread_desc_t){
+        .exec_cb = exec_frame,
+        .input_cb = handle_input,
+        .display_cb = display_size,
+        .mode = sargs_value_def("thread", "on"),
+    });
 }
 
 static void handle_file_loading(void);
-static void send_keybuf_input(void);
+static void send_keybuf_input(uint32_t frame_time_us);
 static void draw_status_bar(void);
 
+// runs on the emulation thread if enabled, see emuthread.h
+static uint32_t exec_frame(uint32_t frame_time_us) {
+    warp_begin_frame(frame_time_us);
+    uint32_t ticks = 0;
+    uint32_t exec_time_us;
+    while ((exec_time_us = warp_exec_time()) > 0) {
+        ticks += cpc_exec(&state.cpc, exec_time_us);
+    }
+    if (!warp_active()) {
+        while ((exec_time_us = runahead_exec_time(frame_time_us)) > 0) {
+            cpc_exec(&state.cpc, exec_time_us);
+        }
+    }
+    send_keybuf_input(frame_time_us);
+    return ticks;
+}
+
+static void display_size(int* width, int* height) {
+    *width = cpc_display_width(&state.cpc);
+    *height = cpc_display_height(&state.cpc);
+}
+
 void app_frame(void) {
     state.frame_time_us = clock_frame_time();
-    const uint64_t emu_start_time = stm_now();
-    state.ticks = cpc_exec(&state.cpc, state.frame_time_us);
-    state.emu_time_ms = stm_ms(stm_since(emu_start_time));
+    emuthread_frame(state.frame_time_us);
     draw_status_bar();
-    gfx_draw(cpc_display_width(&state.cpc), cpc_display_height(&state.cpc));
+    gfx_draw(emuthread_display_width(), emuthread_display_height());
     handle_file_loading();
-    send_keybuf_input();
 }
 
 void app_input(const sapp_event* event) {
@@ -192,6 +284,14 @@ void app_input(const sapp_event* event) {
         return;
     }
     #endif
+    emuthread_input(event);
+}
+
+// applies input events to the emulator, on the emulation thread if enabled
+static void handle_input(const sapp_event* event) {
+    if (snapshot_input(event)) {
+        return;
+    }
     const bool shift = event->modifiers & SAPP_MODIFIER_SHIFT;
     switch (event->type) {
         int c;
@@ -243,19 +343,21 @@ void app_input(const sapp_event* event) {
 }
 
 void app_cleanup(void) {
+    emuthread_shutdown();
     cpc_discard(&state.cpc);
     #ifdef CHIPS_USE_UI
         ui_cpc_discard(&state.ui_cpc);
         ui_discard();
     #endif
+    prof_shutdown();
     saudio_shutdown();
     gfx_shutdown();
     sargs_shutdown();
 }
 
-static void send_keybuf_input(void) {
+static void send_keybuf_input(uint32_t frame_time_us) {
     uint8_t key_code;
-    if (0 != (key_code = keybuf_get(state.frame_time_us))) {
+    if (0 != (key_code = keybuf_get(frame_time_us))) {
         cpc_key_down(&state.cpc, key_code);
         cpc_key_up(&state.cpc, key_code);
     }
@@ -263,8 +365,13 @@ static void send_keybuf_input(void) {
 
 static void handle_file_loading(void) {
     fs_dowork();
+    if (fs_failed()) {
+        gfx_flash_error();
+        fs_reset();
+    }
     const uint32_t load_delay_frames = 120;
     if (fs_ptr() && ((clock_frame_count_60hz() > load_delay_frames) || fs_ext("sna"))) {
+        emuthread_pause();
         bool load_success = false;
         if (fs_ext("txt") || fs_ext("bas")) {
             load_success = true;
@@ -293,12 +400,17 @@ static void handle_file_loading(void) {
             gfx_flash_error();
         }
         fs_reset();
+        emuthread_resume();
     }
 }
 
 static void draw_status_bar(void) {
-    prof_push(PROF_EMU, (float)state.emu_time_ms);
+    prof_push(PROF_FRAME, (float)state.frame_time_us * 0.001f);
+    prof_push(PROF_EMU, (float)emuthread_exec_time_ms());
+    prof_stats_t frame_stats = prof_stats(PROF_FRAME);
+    prof_percentiles_t frame_pct = prof_percentiles(PROF_FRAME);
     prof_stats_t emu_stats = prof_stats(PROF_EMU);
+    prof_percentiles_t emu_pct = prof_percentiles(PROF_EMU);
     
     const uint32_t text_color = 0xFFFFFFFF;
     const uint32_t disc_active = 0xFF00EE00;
@@ -347,7 +459,11 @@ static void draw_status_bar(void) {
     sdtx_font(0);
     sdtx_color1i(text_color);
     sdtx_pos(0.0f, 1.5f);
-    sdtx_printf("frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d", (float)state.frame_time_us * 0.001f, emu_stats.avg_val, emu_stats.min_val, emu_stats.max_val, state.ticks);
+    sdtx_printf("frame:%.2fms p95:%.2f p99:%.2f emu:%.2fms p95:%.2f p99:%.2f ticks:%d", frame_stats.avg_val, frame_pct.p95_val, frame_pct.p99_val, emu_stats.avg_val, emu_pct.p95_val, emu_pct.p99_val, emuthread_ticks());
+    sdtx_pos(0.0f, -1.5f);
+    warp_draw_status();
+    sdtx_pos(0.0f, -2.5f);
+    runahead_draw_status();
 }
 
 sapp_desc sokol_main(int argc, char* argv[]) {
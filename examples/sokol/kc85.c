@@ -33,8 +33,6 @@
 static struct {
     kc85_t kc85;
     uint32_t frame_time_us;
-    uint32_t ticks;
-    double emu_time_ms;
     kc85_module_type_t delay_insert_module; // module to insert after ROM module image has been loaded
     #ifdef CHIPS_USE_UI
         ui_kc85_t ui_kc85;
@@ -64,7 +62,15 @@ static struct {
 // audio-streaming callback
 static void push_audio(const float* samples, int num_samples, void* user_data) {
     (void)user_data;
-    saudio_push(samples, num_samples);
+    if (!runahead_active()) {
+        saudio_push(samples, num_samples);
+    }
+}
+
+// fast paste: CAOS has taken the last key code (key-ready bit 0 of the
+// keyboard flags at IX+8, with IX=01F0h)
+static bool keybuf_ready(void) {
+    return 0 == (mem_rd(&state.kc85.mem, 0x01F8) & 1);
 }
 
 // a callback to patch some known problems in game snapshot files
@@ -116,9 +122,26 @@ kc85_desc_t kc85_desc(void) {
     };
 }
 
+// the pointers in a snapshot of the system, see snapshot.h
+static void snapshot_fixup(snapshot_fixup_t* fx, void* ptr) {
+    kc85_t* sys = (kc85_t*) ptr;
+    snapshot_relocate(fx, &sys->mem, sizeof(sys->mem));
+    snapshot_keep(fx, &sys->debug, sizeof(sys->debug));
+    snapshot_keep(fx, &sys->audio.callback, sizeof(sys->audio.callback));
+    snapshot_keep(fx, &sys->patch_callback, sizeof(sys->patch_callback));
+    snapshot_keep(fx, &sys->pixel_buffer, sizeof(sys->pixel_buffer));
+}
+
 #if defined(CHIPS_USE_UI)
 static void ui_draw_cb(void) {
+    const bool sync = ui_input_pending();
+    if (sync) {
+        emuthread_pause();
+    }
     ui_kc85_draw(&state.ui_kc85);
+    if (sync) {
+        emuthread_resume();
+    }
 }
 static void ui_boot_cb(kc85_t* sys) {
     kc85_desc_t desc = kc85_desc();
@@ -126,6 +149,10 @@ static void ui_boot_cb(kc85_t* sys) {
 }
 #endif
 
+static uint32_t exec_frame(uint32_t frame_time_us);
+static void display_size(int* width, int* height);
+static void handle_input(const sapp_event* event);
+
 void app_init(void) {
     gfx_init(&(gfx_desc_t) {
         #ifdef CHIPS_USE_UI
@@ -135,14 +162,37 @@ void app_init(void) {
         .border_right = BORDER_RIGHT,
         .border_top = BORDER_TOP,
         .border_bottom = BORDER_BOTTOM,
+        .fb_width = kc85_std_display_width(),
+        .fb_height = kc85_std_display_height(),
     });
-    keybuf_init(&(keybuf_desc_t){ .key_delay_frames = 10 });
+    keybuf_init(&(keybuf_desc_t){ .key_delay_frames = 3, .ready_cb = keybuf_ready });
     clock_init();
+    // prof-export=file.csv (summary) or file.json (Chrome trace), written at exit
+    prof_set_export(sargs_value_def("prof-export", 0));
     prof_init();
     saudio_setup(&(saudio_desc){0});
     fs_init();
     const kc85_desc_t desc = kc85_desc();
     kc85_init(&state.kc85, &desc);
+    snapshot_init(&(snapshot_desc_t){
+        .system = "kc85",
+        .build = __DATE__ " " __TIME__,
+        .sys = &state.kc85,
+        .sys_size = sizeof(state.kc85),
+        .fixup_cb = snapshot_fixup,
+        .load_path = sargs_value_def("snapshot", 0),
+    });
+    // a snapshot from the command line replaces the boot state, don't cache it
+    bootcache_init(&(bootcache_desc_t){
+        .system = "kc85",
+        .boot_frames = LOAD_DELAY_FRAMES,
+        .mode = sargs_exists("snapshot") ? "off" : sargs_value_def("bootcache", "on"),
+    });
+    runahead_init(&(runahead_desc_t){
+        .sys = &state.kc85,
+        .sys_size = sizeof(state.kc85),
+        .frames = atoi(sargs_value_def("runahead", "0")),
+    });
     #ifdef CHIPS_USE_UI
         ui_init(ui_draw_cb);
         ui_kc85_init(&state.ui_kc85, &(ui_kc85_desc_t){
@@ -205,21 +255,41 @@ void app_init(void) {
             keybuf_put(sargs_value("input"));
         }
     }
+    emuthread_init(&(emuthread_desc_t){
+        .exec_cb = exec_frame,
+        .input_cb = handle_input,
+        .display_cb = display_size,
+        .mode = sargs_value_def("thread", "on"),
+    });
 }
 
 static void handle_file_loading(void);
-static void send_keybuf_input(void);
+static void send_keybuf_input(uint32_t frame_time_us);
 static void draw_status_bar(void);
 
+// runs on the emulation thread if enabled, see emuthread.h
+static uint32_t exec_frame(uint32_t frame_time_us) {
+    const uint32_t ticks = kc85_exec(&state.kc85, frame_time_us);
+    bootcache_frame(frame_time_us);
+    uint32_t ahead_us;
+    while ((ahead_us = runahead_exec_time(frame_time_us)) > 0) {
+        kc85_exec(&state.kc85, ahead_us);
+    }
+    send_keybuf_input(frame_time_us);
+    return ticks;
+}
+
+static void display_size(int* width, int* height) {
+    *width = kc85_display_width(&state.kc85);
+    *height = kc85_display_height(&state.kc85);
+}
+
 void app_frame(void) {
     state.frame_time_us = clock_frame_time();
-    const uint64_t emu_start_time = stm_now();
-    state.ticks = kc85_exec(&state.kc85, state.frame_time_us);
-    state.emu_time_ms = stm_ms(stm_since(emu_start_time));
+    emuthread_frame(state.frame_time_us);
     draw_status_bar();
-    gfx_draw(kc85_display_width(&state.kc85), kc85_display_height(&state.kc85));
+    gfx_draw(emuthread_display_width(), emuthread_display_height());
     handle_file_loading();
-    send_keybuf_input();
 }
 
 void app_input(const sapp_event* event) {
@@ -233,6 +303,14 @@ void app_input(const sapp_event* event) {
         return;
     }
     #endif
+    emuthread_input(event);
+}
+
+// applies input events to the emulator, on the emulation thread if enabled
+static void handle_input(const sapp_event* event) {
+    if (snapshot_input(event)) {
+        return;
+    }
     const bool shift = event->modifiers & SAPP_MODIFIER_SHIFT;
     switch (event->type) {
         int c;
@@ -292,19 +370,21 @@ void app_input(const sapp_event* event) {
 }
 
 void app_cleanup(void) {
+    emuthread_shutdown();
     kc85_discard(&state.kc85);
     #ifdef CHIPS_USE_UI
         ui_kc85_discard(&state.ui_kc85);
         ui_discard();
     #endif
+    prof_shutdown();
     saudio_shutdown();
     gfx_shutdown();
     sargs_shutdown();
 }
 
-static void send_keybuf_input(void) {
+static void send_keybuf_input(uint32_t frame_time_us) {
     uint8_t key_code;
-    if (0 != (key_code = keybuf_get(state.frame_time_us))) {
+    if (0 != (key_code = keybuf_get(frame_time_us))) {
         kc85_key_down(&state.kc85, key_code);
         kc85_key_up(&state.kc85, key_code);
     }
@@ -312,8 +392,12 @@ static void send_keybuf_input(void) {
 
 static void handle_file_loading(void) {
     fs_dowork();
-    const uint32_t load_delay_frames = LOAD_DELAY_FRAMES;
-    if (fs_ptr() && clock_frame_count_60hz() > load_delay_frames) {
+    if (fs_failed()) {
+        gfx_flash_error();
+        fs_reset();
+    }
+    if (fs_ptr() && bootcache_ready()) {
+        emuthread_pause();
         bool load_success = false;
         if (sargs_exists("mod_image")) {
             // insert the rom module
@@ -329,9 +413,7 @@ static void handle_file_loading(void) {
             load_success = kc85_quickload(&state.kc85, fs_ptr(), fs_size());
         }
         if (load_success) {
-            if (clock_frame_count_60hz() > (load_delay_frames + 10)) {
-                gfx_flash_success();
-            }
+            gfx_flash_success();
             if (sargs_exists("input")) {
                 keybuf_put(sargs_value("input"));
             }
@@ -340,12 +422,17 @@ static void handle_file_loading(void) {
             gfx_flash_error();
         }
         fs_reset();
+        emuthread_resume();
     }
 }
 
 static void draw_status_bar(void) {
-    prof_push(PROF_EMU, (float)state.emu_time_ms);
+    prof_push(PROF_FRAME, (float)state.frame_time_us * 0.001f);
+    prof_push(PROF_EMU, (float)emuthread_exec_time_ms());
+    prof_stats_t frame_stats = prof_stats(PROF_FRAME);
+    prof_percentiles_t frame_pct = prof_percentiles(PROF_FRAME);
     prof_stats_t emu_stats = prof_stats(PROF_EMU);
+    prof_percentiles_t emu_pct = prof_percentiles(PROF_EMU);
 
     const float w = sapp_widthf();
     const float h = sapp_heightf();
@@ -382,7 +469,9 @@ static void draw_status_bar(void) {
 
     sdtx_pos(0.0f, 1.5f);
     sdtx_color1i(text_color);
-    sdtx_printf("frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d", (float)state.frame_time_us * 0.001f, emu_stats.avg_val, emu_stats.min_val, emu_stats.max_val, state.ticks);
+    sdtx_printf("frame:%.2fms p95:%.2f p99:%.2f emu:%.2fms p95:%.2f p99:%.2f ticks:%d", frame_stats.avg_val, frame_pct.p95_val, frame_pct.p99_val, emu_stats.avg_val, emu_pct.p95_val, emu_pct.p99_val, emuthread_ticks());
+    sdtx_pos(0.0f, -1.5f);
+    runahead_draw_status();
 }
 
 sapp_desc sokol_main(int argc, char* argv[]) {
@@ -71,6 +71,8 @@ void app_init(void) {
         .fonts[0] = sdtx_font_oric()
     });
     clock_init();
+    // prof-export=file.csv (summary) or file.json (Chrome trace), written at exit
+    prof_set_export(sargs_value_def("prof-export", 0));
     prof_init();
     saudio_setup(&(saudio_desc){0});
 
@@ -117,6 +119,7 @@ void app_input(const sapp_event* event) {
 void app_cleanup(void) {
     lc80_discard(&state.lc80);
     ui_lc80_discard(&state.ui_lc80);
+    prof_shutdown();
     saudio_shutdown();
     sdtx_shutdown();
     sg_shutdown();
@@ -124,14 +127,18 @@ void app_cleanup(void) {
 }
 
 static void draw_status_bar(void) {
+    prof_push(PROF_FRAME, (float)state.frame_time_us * 0.001f);
     prof_push(PROF_EMU, (float)state.emu_time_ms);
+    prof_stats_t frame_stats = prof_stats(PROF_FRAME);
+    prof_percentiles_t frame_pct = prof_percentiles(PROF_FRAME);
     prof_stats_t emu_stats = prof_stats(PROF_EMU);
+    prof_percentiles_t emu_pct = prof_percentiles(PROF_EMU);
     const float w = sapp_widthf();
     const float h = sapp_heightf();
     sdtx_canvas(w, h);
     sdtx_color3b(255, 255, 255);
     sdtx_pos(1.0f, (h / 8.0f) - 1.5f);
-    sdtx_printf("frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d", (float)state.frame_time_us * 0.001f, emu_stats.avg_val, emu_stats.min_val, emu_stats.max_val, state.ticks);
+    sdtx_printf("frame:%.2fms p95:%.2f p99:%.2f emu:%.2fms p95:%.2f p99:%.2f ticks:%d", frame_stats.avg_val, frame_pct.p95_val, frame_pct.p99_val, emu_stats.avg_val, emu_pct.p95_val, emu_pct.p99_val, state.ticks);
 }
 
 sapp_desc sokol_main(int argc, char* argv[]) {
@@ -31,6 +31,8 @@ SOFTWARE.
 //------------------------------------------------------------------------------
 #include "common.h"
 #include "modplug.h"
+#define MODPLAY_STREAM_IMPL
+#include "modplay-stream.h"
 #include "data/mods.h"
 #include <assert.h>
 
@@ -42,37 +44,29 @@ SOFTWARE.
 #define MODPLAY_USE_PUSH (1)
 /* big enough for packet_size * num_packets * num_channels */
 #define MODPLAY_SRCBUF_SAMPLES (16*1024)
+/* print underrun statistics every N frames (this player doubles as audio path soak test) */
+#define MODPLAY_STATS_FRAMES (60*10)
 
 typedef struct {
     bool mpf_valid;
     ModPlugFile* mpf;
-    int int_buf[MODPLAY_SRCBUF_SAMPLES];
+    /* decoding and int-to-float conversion run on a worker thread */
+    modplay_stream_t stream;
     #if MODPLAY_USE_PUSH
     float flt_buf[MODPLAY_SRCBUF_SAMPLES];
     #endif
+    uint32_t frame_count;
 } state_t;
 
-/* integer-to-float conversion buffer */
-
-/* common function to read sample stream from libmodplug and convert to float */
+/* common function to read the decoded sample stream, pads with silence if
+   the decoder falls behind or the file wasn't loaded
+*/
 static void read_samples(state_t* state, float* buffer, int num_samples) {
     assert(num_samples <= MODPLAY_SRCBUF_SAMPLES);
-    if (state->mpf_valid) {
-        /* NOTE: for multi-channel playback, the samples are interleaved
-           (e.g. left/right/left/right/...)
-        */
-        int res = ModPlug_Read(state->mpf, (void*)state->int_buf, (int)sizeof(int)*num_samples);
-        int samples_in_buffer = res / (int)sizeof(int);
-        int i;
-        for (i = 0; i < samples_in_buffer; i++) {
-            buffer[i] = state->int_buf[i] / (float)0x7fffffff;
-        }
-        for (; i < num_samples; i++) {
-            buffer[i] = 0.0f;
-        }
-    }
-    else {
-        /* if file wasn't loaded, fill the output buffer with silence */
+    /* NOTE: for multi-channel playback, the samples are interleaved
+       (e.g. left/right/left/right/...)
+    */
+    if (modplay_stream_read(&state->stream, buffer, num_samples) < num_samples) {
         for (int i = 0; i < num_samples; i++) {
             buffer[i] = 0.0f;
         }
@@ -136,6 +130,7 @@ void init(void* user_data) {
     if (state->mpf) {
         state->mpf_valid = true;
     }
+    modplay_stream_start(&state->stream, state->mpf, true);
 }
 
 static state_t state;   /* static structs are implicitely zero-initialized */
@@ -159,6 +154,10 @@ void frame(void* user_data) {
             read_samples(state, state->flt_buf, num_samples);
             saudio_push(state->flt_buf, num_frames);
         }
+        /* the read side statistics are owned by this thread in the push model */
+        if (++state->frame_count % MODPLAY_STATS_FRAMES == 0) {
+            modplay_stream_print_stats(&state->stream);
+        }
     #else
         (void)user_data;
     #endif
@@ -168,6 +167,8 @@ void frame(void* user_data) {
 void cleanup(void* user_data) {
     state_t* state = (state_t*) user_data;
     saudio_shutdown();
+    modplay_stream_stop(&state->stream);
+    modplay_stream_print_stats(&state->stream);
     if (state->mpf_valid) {
         ModPlug_Unload(state->mpf);
     }
@@ -0,0 +1,221 @@
+#pragma once
+/*
+    modplay-stream.h -- decode a libmodplug module on a worker thread
+
+    The worker keeps a single-producer/single-consumer ring of samples
+    filled ahead of the audio device, so a slow frame on the main thread
+    doesn't turn into an audio gap. The main thread only reads the ring
+    counters and copies samples out with modplay_stream_read().
+
+    Samples are interleaved as configured in ModPlug_SetSettings() (32 bits),
+    and are either kept as int32 or converted to float in [-1, 1].
+
+    Do this:
+        #define MODPLAY_STREAM_IMPL
+    before you include this file in *one* C file to create the implementation.
+
+    Without pthreads (Emscripten, Windows) decoding happens on demand
+    inside modplay_stream_read().
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "modplug.h"
+
+#if !defined(__EMSCRIPTEN__) && !defined(_WIN32)
+#include <pthread.h>
+#define MODPLAY_STREAM_THREADED (1)
+#else
+#define MODPLAY_STREAM_THREADED (0)
+#endif
+
+#define MODPLAY_STREAM_RING_SAMPLES (32*1024)   /* must be a power of 2 */
+#define MODPLAY_STREAM_CHUNK_SAMPLES (1024)     /* samples decoded per ModPlug_Read() */
+
+typedef struct {
+    uint32_t reads;             /* calls to modplay_stream_read() */
+    uint32_t underruns;         /* reads that found less samples than requested */
+    uint64_t missing_samples;   /* samples replaced by silence */
+    uint32_t min_fill;          /* lowest ring fill level seen by a read */
+} modplay_stream_stats_t;
+
+typedef struct {
+    ModPlugFile* mpf;
+    bool float_output;
+    /* producer owns head, consumer owns tail */
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    _Atomic bool ended;
+    _Atomic bool quit;
+    modplay_stream_stats_t stats;
+    #if MODPLAY_STREAM_THREADED
+    pthread_t thread;
+    bool thread_valid;
+    #endif
+    int32_t decode_buf[MODPLAY_STREAM_CHUNK_SAMPLES];
+    union {
+        int32_t i[MODPLAY_STREAM_RING_SAMPLES];
+        float f[MODPLAY_STREAM_RING_SAMPLES];
+    } ring;
+} modplay_stream_t;
+
+/* start decoding mpf (may be NULL, producing silence) */
+void modplay_stream_start(modplay_stream_t* s, ModPlugFile* mpf, bool float_output);
+/* stop the worker thread, the module isn't unloaded */
+void modplay_stream_stop(modplay_stream_t* s);
+/* copy up to num_samples into dst, pads with silence on underrun,
+   returns samples copied (0 once the module ended and the ring is empty)
+*/
+int modplay_stream_read(modplay_stream_t* s, void* dst, int num_samples);
+/* print and reset underrun statistics */
+void modplay_stream_print_stats(modplay_stream_t* s);
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef MODPLAY_STREAM_IMPL
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define _MODPLAY_STREAM_MASK (MODPLAY_STREAM_RING_SAMPLES-1)
+
+static void _modplay_int32_to_float(const int32_t* src, float* dst, int num) {
+    const float scale = 1.0f / (float)0x7fffffff;
+    int i = 0;
+    #if defined(__SSE2__) || defined(_M_X64)
+    const __m128 s = _mm_set1_ps(scale);
+    for (; i + 4 <= num; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(src + i))), s));
+    }
+    #elif defined(__ARM_NEON)
+    for (; i + 4 <= num; i += 4) {
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src + i)), scale));
+    }
+    #endif
+    for (; i < num; i++) {
+        dst[i] = src[i] * scale;
+    }
+}
+
+/* decode one chunk if there's room, returns false if nothing was done */
+static bool _modplay_stream_fill(modplay_stream_t* s) {
+    if (atomic_load_explicit(&s->ended, memory_order_relaxed)) {
+        return false;
+    }
+    const uint32_t head = atomic_load_explicit(&s->head, memory_order_relaxed);
+    const uint32_t tail = atomic_load_explicit(&s->tail, memory_order_acquire);
+    if ((MODPLAY_STREAM_RING_SAMPLES - (head - tail)) < MODPLAY_STREAM_CHUNK_SAMPLES) {
+        return false;
+    }
+    int num = 0;
+    if (s->mpf) {
+        num = ModPlug_Read(s->mpf, s->decode_buf, (int)sizeof(s->decode_buf)) / (int)sizeof(int32_t);
+        if (num <= 0) {
+            atomic_store_explicit(&s->ended, true, memory_order_release);
+            return false;
+        }
+    }
+    else {
+        num = MODPLAY_STREAM_CHUNK_SAMPLES;
+        memset(s->decode_buf, 0, sizeof(s->decode_buf));
+    }
+    /* copy into the ring in up to two pieces (wrap-around) */
+    const uint32_t pos = head & _MODPLAY_STREAM_MASK;
+    const int n0 = (num < (int)(MODPLAY_STREAM_RING_SAMPLES - pos)) ? num : (int)(MODPLAY_STREAM_RING_SAMPLES - pos);
+    if (s->float_output) {
+        _modplay_int32_to_float(s->decode_buf, &s->ring.f[pos], n0);
+        _modplay_int32_to_float(s->decode_buf + n0, &s->ring.f[0], num - n0);
+    }
+    else {
+        memcpy(&s->ring.i[pos], s->decode_buf, n0 * sizeof(int32_t));
+        memcpy(&s->ring.i[0], s->decode_buf + n0, (num - n0) * sizeof(int32_t));
+    }
+    atomic_store_explicit(&s->head, head + (uint32_t)num, memory_order_release);
+    return true;
+}
+
+#if MODPLAY_STREAM_THREADED
+static void* _modplay_stream_thread(void* arg) {
+    modplay_stream_t* s = (modplay_stream_t*) arg;
+    while (!atomic_load_explicit(&s->quit, memory_order_relaxed)) {
+        if (!_modplay_stream_fill(s)) {
+            /* ring is full (or the module ended), a chunk lasts >10ms at 48KHz stereo */
+            struct timespec ts = { 0, 2000000 };
+            nanosleep(&ts, 0);
+        }
+    }
+    return 0;
+}
+#endif
+
+void modplay_stream_start(modplay_stream_t* s, ModPlugFile* mpf, bool float_output) {
+    memset(s, 0, sizeof(*s));
+    s->mpf = mpf;
+    s->float_output = float_output;
+    s->stats.min_fill = MODPLAY_STREAM_RING_SAMPLES;
+    /* prime the ring so the first reads don't underrun */
+    while (_modplay_stream_fill(s));
+    #if MODPLAY_STREAM_THREADED
+    s->thread_valid = (0 == pthread_create(&s->thread, 0, _modplay_stream_thread, s));
+    #endif
+}
+
+void modplay_stream_stop(modplay_stream_t* s) {
+    #if MODPLAY_STREAM_THREADED
+    if (s->thread_valid) {
+        atomic_store(&s->quit, true);
+        pthread_join(s->thread, 0);
+        s->thread_valid = false;
+    }
+    #endif
+}
+
+int modplay_stream_read(modplay_stream_t* s, void* dst, int num_samples) {
+    #if MODPLAY_STREAM_THREADED
+    if (!s->thread_valid) {
+        while (_modplay_stream_fill(s));
+    }
+    #else
+    while (_modplay_stream_fill(s));
+    #endif
+    const uint32_t tail = atomic_load_explicit(&s->tail, memory_order_relaxed);
+    const uint32_t head = atomic_load_explicit(&s->head, memory_order_acquire);
+    const uint32_t fill = head - tail;
+    if ((fill < s->stats.min_fill) && !atomic_load_explicit(&s->ended, memory_order_relaxed)) {
+        s->stats.min_fill = fill;
+    }
+    s->stats.reads++;
+    int num = (fill < (uint32_t)num_samples) ? (int)fill : num_samples;
+    if ((num == 0) && atomic_load_explicit(&s->ended, memory_order_acquire)) {
+        return 0;
+    }
+    const uint32_t pos = tail & _MODPLAY_STREAM_MASK;
+    const int n0 = (num < (int)(MODPLAY_STREAM_RING_SAMPLES - pos)) ? num : (int)(MODPLAY_STREAM_RING_SAMPLES - pos);
+    uint8_t* ptr = (uint8_t*) dst;
+    memcpy(ptr, &s->ring.i[pos], n0 * sizeof(int32_t));
+    memcpy(ptr + n0 * sizeof(int32_t), &s->ring.i[0], (num - n0) * sizeof(int32_t));
+    atomic_store_explicit(&s->tail, tail + (uint32_t)num, memory_order_release);
+    if (num < num_samples) {
+        /* all-zero bits is silence for both int32 and float */
+        memset(ptr + num * sizeof(int32_t), 0, (num_samples - num) * sizeof(int32_t));
+        if (!atomic_load_explicit(&s->ended, memory_order_relaxed)) {
+            s->stats.underruns++;
+            s->stats.missing_samples += (uint64_t)(num_samples - num);
+        }
+        return num_samples;
+    }
+    return num;
+}
+
+void modplay_stream_print_stats(modplay_stream_t* s) {
+    printf("modplay: %u reads, %u underruns (%llu samples of silence), min ring fill %u/%u\n",
+        s->stats.reads, s->stats.underruns, (unsigned long long) s->stats.missing_samples,
+        s->stats.min_fill, MODPLAY_STREAM_RING_SAMPLES);
+    memset(&s->stats, 0, sizeof(s->stats));
+    s->stats.min_fill = MODPLAY_STREAM_RING_SAMPLES;
+}
+#endif /* MODPLAY_STREAM_IMPL */
@@ -36,6 +36,7 @@ SOFTWARE.
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h> //calloc
 #define FB_WIDTH 800
 #define FB_HEIGHT 600
 #define FAST_CODE
@@ -45,11 +46,119 @@ SOFTWARE.
 #include <litex.h> //FAST_CODE and FAST_DATA macros
 #include "lite_fb.h"
 #include "litesdk_timer.h"
+#include <console.h> //readchar_nonblock
 #define NAMCO_USE_BGRA8 //invers palette
 #endif
 
-#define FB_WIDTH_MAX 1024 //next power of 2
 #define DEFAULT_SAMPLERATE 44100
+
+/////////////////////////
+//per-phase cycle profiler
+//time is accumulated in the phase that is current at each transition (nested phases are
+//exclusive), so the cost is one counter read per phase change and a few per frame
+#ifndef NAMCO_PROF_FRAMES
+#define NAMCO_PROF_FRAMES 600 //frames between summaries, 0 disables the profiler
+#endif
+//#define NAMCO_PROF_SOUND //also split sound chip ticks from CPU ticks (costs 2 reads per sample)
+
+enum PROF_PHASE
+{
+  PROF_PHASE_OTHER, //events, vsync waits, everything not listed below
+  PROF_PHASE_CPU,
+  PROF_PHASE_SOUND,
+  PROF_PHASE_VIDEO,
+  PROF_PHASE_DRAW,
+  PROF_PHASE_AUDIO,
+  PROF_PHASE_NUM
+};
+
+#ifdef __linux__
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t prof_cycles_now(void) { return __rdtsc(); }
+#else
+#include <time.h>
+static inline uint64_t prof_cycles_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+#endif
+#else
+static inline uint64_t cpu_hal_get_cycle_count64(void) { timer0_uptime_latch_write(1); return timer0_uptime_cycles_read(); }
+#define prof_cycles_now cpu_hal_get_cycle_count64
+#endif
+
+#if NAMCO_PROF_FRAMES
+static FAST_DATA struct
+{
+  int phase;
+  uint64_t t;
+  uint64_t frame_start;
+  uint64_t frame_max;
+  uint32_t frames;
+  uint64_t cycles[PROF_PHASE_NUM];
+} prof;
+
+static inline int prof_enter(int phase)
+{
+  uint64_t t = prof_cycles_now();
+  prof.cycles[prof.phase] += t - prof.t;
+  prof.t = t;
+  int prev = prof.phase;
+  prof.phase = phase;
+  return prev;
+}
+
+void prof_dump(void)
+{
+  static const char* names[PROF_PHASE_NUM] = { "other", "cpu", "sound", "video", "draw", "audio" };
+  uint64_t total = 0;
+  for(int i = 0; i < PROF_PHASE_NUM; ++i)
+    total += prof.cycles[i];
+  if(prof.frames == 0 || total == 0)
+    return;
+  printf("prof: %u frames, %llu cycles/frame (max %llu)\n", (unsigned) prof.frames,
+    (unsigned long long) (total/prof.frames), (unsigned long long) prof.frame_max);
+  for(int i = 0; i < PROF_PHASE_NUM; ++i)
+    printf("  %-6s %10llu cycles/frame %3u.%u%%\n", names[i], (unsigned long long) (prof.cycles[i]/prof.frames),
+      (unsigned) (prof.cycles[i]*100/total), (unsigned) (prof.cycles[i]*1000/total%10));
+  for(int i = 0; i < PROF_PHASE_NUM; ++i)
+    prof.cycles[i] = 0;
+  prof.frames = 0;
+  prof.frame_max = 0;
+}
+
+void prof_frame(void)
+{
+  prof_enter(prof.phase); //flush current phase
+  if(prof.frame_start)
+  {
+    uint64_t d = prof.t - prof.frame_start;
+    if(d > prof.frame_max)
+      prof.frame_max = d;
+    if(++prof.frames == NAMCO_PROF_FRAMES)
+      prof_dump();
+  }
+  else
+    prof.cycles[prof.phase] = 0; //discard startup
+  prof.frame_start = prof.t;
+}
+
+#define NAMCO_PROF_BEGIN(phase) int _prof_prev_##phase = prof_enter(PROF_PHASE_##phase)
+#define NAMCO_PROF_END(phase) prof_enter(_prof_prev_##phase)
+#ifdef NAMCO_PROF_SOUND
+#define NAMCO_PROF_TICK_BEGIN NAMCO_PROF_BEGIN
+#define NAMCO_PROF_TICK_END NAMCO_PROF_END
+#endif
+#else
+static inline void prof_dump(void) {}
+static inline void prof_frame(void) {}
+#define NAMCO_PROF_BEGIN(phase)
+#define NAMCO_PROF_END(phase)
+#endif //NAMCO_PROF_FRAMES
+
 /////////////////////////
 //simulator declarations
 
@@ -65,6 +174,7 @@ SOFTWARE.
 #include "pengo-roms.h"
 #endif
 #include "namco-optimized.h"
+#include "clock.h" //clock_ns_to_ticks()
 #define PIXEL_SCALING 2
 #define ROTATED_90
 #define SAMPLE_CONVERT(s) ((s)*((1<<30)/NAMCO_AUDIO_SAMPLE_SCALING))
@@ -115,17 +225,20 @@ void sim_setkey(enum KEYCODE key, bool value);
 #include "sdl_fb.h"
 
 
-static uint32_t pixel_buffer[FB_WIDTH_MAX*FB_HEIGHT];
+//allocated in main() from the emulated display size
+static uint32_t *pixel_buffer;
 static fb_handle_t fb;
 
 void draw_frame(int emu_width, int emu_height)
 {
 #ifdef ROTATED_90
-	static uint32_t rotated_buffer[FB_WIDTH_MAX*FB_HEIGHT];
+	static uint32_t *rotated_buffer; //window sized
+	if(!rotated_buffer)
+		rotated_buffer = calloc(FB_WIDTH*FB_HEIGHT, sizeof(uint32_t));
 	const uint32_t *src = pixel_buffer+emu_height*emu_width;
 	uint32_t *dst = rotated_buffer;
 	dst += (FB_WIDTH-emu_height*PIXEL_SCALING)/2; //center X
-	dst += FB_WIDTH_MAX*(FB_HEIGHT-emu_width*PIXEL_SCALING)/2; //center Y
+	dst += FB_WIDTH*(FB_HEIGHT-emu_width*PIXEL_SCALING)/2; //center Y
 	src -= emu_width;
 	for(int x = 0; x < emu_height; ++x)
 	{
@@ -133,14 +246,15 @@ void draw_frame(int emu_width, int emu_height)
 		{
 			*dst = *src;
 			src += 1;
-			dst += PIXEL_SCALING*FB_WIDTH_MAX;
+			dst += PIXEL_SCALING*FB_WIDTH;
 		}
 		src -= 2*emu_width;
-		dst += PIXEL_SCALING - emu_width*PIXEL_SCALING*FB_WIDTH_MAX;
+		dst += PIXEL_SCALING - emu_width*PIXEL_SCALING*FB_WIDTH;
 	}
-	fb_update(&fb, rotated_buffer, FB_WIDTH_MAX*sizeof(rotated_buffer[0]));
+	fb_update(&fb, rotated_buffer, FB_WIDTH*sizeof(rotated_buffer[0]));
 #else
-	fb_update(&fb, pixel_buffer, emu_width*sizeof(pixel_buffer[0]));
+	fb_update_rows(&fb, pixel_buffer, emu_width*sizeof(pixel_buffer[0]), 0, emu_height);
+	fb_present(&fb);
 #endif
 }
 
@@ -172,12 +286,17 @@ bool run_sim(void)
           case SDL_KEYUP:
             if(event.key.keysym.sym == SDLK_ESCAPE)
               return false;
+            if(event.key.keysym.sym == SDLK_p && event.type==SDL_KEYDOWN)
+              prof_dump(); //on demand summary
             sim_setkey(sdl2keymap(event.key.keysym.sym), event.type==SDL_KEYDOWN);
             break;
         }
     }
     
+  prof_frame();
+  NAMCO_PROF_BEGIN(DRAW);
   draw_frame(sim_width(), sim_height());
+  NAMCO_PROF_END(DRAW);
   uint64_t t = higres_ticks() * 1000000ull / higres_ticks_freq();
   return sim_exec(t);
 }
@@ -213,10 +332,15 @@ void audio_pushbuf(const void* samples, size_t buffer_size)
 
 //returns how much is in the buffer
 #ifdef NAMCO_DEFAULT_BUFFER_SAMPLES
+static uint32_t audio_starved; //times the device queue was found empty
 int audio_fifo_space(void)
 {
+  static bool started = false;
   int queued = SDL_GetQueuedAudioSize(audio_device)/sizeof(namco_sample_t); //1 ch
   int frames = NAMCO_DEFAULT_AUDIO_SAMPLES;
+  if(queued == 0 && started)
+    ++audio_starved;
+  started = true;
   if(queued >= NAMCO_DEFAULT_BUFFER_SAMPLES)
     return 0;
   return frames; //always fixed packet size expected
@@ -228,12 +352,15 @@ int saudio_channels() { return 1; }
 #ifdef NAMCO_AUDIO_FLOAT 
 static void push_audio(const float* samples, int num_samples, void* user_data) {
     (void)user_data;
+    NAMCO_PROF_BEGIN(AUDIO);
     audio_pushbuf(samples, num_samples*sizeof(*samples));
+    NAMCO_PROF_END(AUDIO);
 }
 #else
 static void push_audio(const int32_t* samples, int num_samples, void* user_data) {
     (void)user_data;
     static int32_t samples_conv[NAMCO_MAX_AUDIO_SAMPLES];
+    NAMCO_PROF_BEGIN(AUDIO);
 #ifdef SAMPLE_CONVERT
     for(int i = 0; i < num_samples; ++i)
     	samples_conv[i] = SAMPLE_CONVERT(samples[i]);
@@ -241,6 +368,7 @@ static void push_audio(const int32_t* samples, int num_samples, void* user_data)
 #else
     audio_pushbuf(samples, num_samples*sizeof(*samples));
 #endif
+    NAMCO_PROF_END(AUDIO);
 }
 #endif
 
@@ -249,8 +377,11 @@ int main(int argc, char* argv[])
 	fb_init(FB_WIDTH, FB_HEIGHT, true, &fb);
 	audio_init(DEFAULT_SAMPLERATE, NAMCO_DEFAULT_AUDIO_SAMPLES);
 	signal(SIGINT, SIG_DFL); //allows to exit by ctrl-c
-	sim_init(pixel_buffer,  sizeof(pixel_buffer), push_audio, DEFAULT_SAMPLERATE);
+	const size_t fb_size = (size_t)sim_width()*sim_height()*sizeof(uint32_t);
+	pixel_buffer = calloc(1, fb_size);
+	sim_init(pixel_buffer, fb_size, push_audio, DEFAULT_SAMPLERATE);
     while(run_sim());
+    prof_dump();
     return 0;
 }
 
@@ -282,14 +413,19 @@ void FAST_CODE draw_frame(int emu_width, int emu_height)
 	#error no rotation
 #endif
 }
-static inline uint64_t cpu_hal_get_cycle_count64(void) { timer0_uptime_latch_write(1); return timer0_uptime_cycles_read(); }
 #define micros() ((1000000ull*cpu_hal_get_cycle_count64())/LITETIMER_BASE_FREQUENCY)
 
 bool run_sim(void)
 {
+#if NAMCO_PROF_FRAMES
+  if(readchar_nonblock() && readchar() == 'p')
+    prof_dump(); //on demand summary over the UART
+#endif
+  prof_frame();
+  NAMCO_PROF_BEGIN(DRAW);
   draw_frame(sim_width(), sim_height());
+  NAMCO_PROF_END(DRAW);
   uint64_t t = micros();
-  printf("current time %llu\n", t);
   return sim_exec(t);
 }
 
@@ -380,7 +516,12 @@ bool sim_exec(uint64_t t1)
     t0 = t1;
     if(us > 1000000/60)
       us = 1000000/60;
-    namco_exec(&sys, us);
+    //exact tick budget, the fraction of a tick left is carried to the next frame
+    static uint64_t tick_frac = 0;
+    const uint32_t num_ticks = clock_ns_to_ticks((uint64_t) us * 1000, NAMCO_CPU_CLOCK, &tick_frac);
+    NAMCO_PROF_BEGIN(CPU);
+    namco_exec_ticks(&sys, num_ticks);
+    NAMCO_PROF_END(CPU);
     return true;
 }
 
@@ -430,6 +571,8 @@ SOFTWARE.
 */
 
 #include "modplug.h"
+#define MODPLAY_STREAM_IMPL
+#include "modplay-stream.h"
 #include "data/mods.h"
 #include <assert.h>
 
@@ -441,15 +584,16 @@ SOFTWARE.
 #define MODPLAY_USE_PUSH (1)
 /* big enough for packet_size * num_packets * num_channels */
 #define MODPLAY_SRCBUF_SAMPLES (16*1024)
+/* print underrun statistics every N calls (this player doubles as audio path soak test) */
+#define MODPLAY_STATS_FRAMES (60*10)
 
 typedef struct {
     bool mpf_valid;
     ModPlugFile* mpf;
-#ifdef NAMCO_AUDIO_FLOAT
-    int src_buf[MODPLAY_SRCBUF_SAMPLES]; //needed for conversion
-#endif
+    modplay_stream_t stream; //decoding (and conversion) runs on a worker thread
     namco_sample_t dst_buf[MODPLAY_SRCBUF_SAMPLES];
     audio_cb_t audio_cb;
+    uint32_t frame_count;
 } state_t;
 
 static state_t state;
@@ -480,10 +624,15 @@ void sim_init(uint32_t *framebuffer, size_t fb_size, audio_cb_t audio_cb, int sa
         state.mpf_valid = true;
     }
     state.audio_cb = audio_cb;
+#ifdef NAMCO_AUDIO_FLOAT
+    modplay_stream_start(&state.stream, state.mpf, true);
+#else
+    modplay_stream_start(&state.stream, state.mpf, false);
+#endif
 }
 
 
-/* common function to read sample stream from libmodplug and convert to float */
+/* common function to read the decoded sample stream */
 static int read_samples(state_t* state, namco_sample_t* buffer, int num_samples) {
     assert(num_samples <= MODPLAY_SRCBUF_SAMPLES);
     if (!state->mpf_valid)
@@ -491,21 +640,7 @@ static int read_samples(state_t* state, namco_sample_t* buffer, int num_samples)
     /* NOTE: for multi-channel playback, the samples are interleaved
        (e.g. left/right/left/right/...)
     */
-#ifndef NAMCO_AUDIO_FLOAT
-    int res = ModPlug_Read(state->mpf, buffer, sizeof(namco_sample_t)*num_samples);
-    return res / (int)sizeof(int);
-#else
-    int res = ModPlug_Read(state->mpf, (void*)state->src_buf, sizeof(namco_sample_t)*num_samples);
-    int samples_in_buffer = res / (int)sizeof(int);
-    int i;
-    for (i = 0; i < samples_in_buffer; i++) {
-        buffer[i] = state->src_buf[i] / (float)0x7fffffff;
-    }
-    for (; i < num_samples; i++) {
-        buffer[i] = 0.0f;
-    }
-    return samples_in_buffer;
-#endif
+    return modplay_stream_read(&state->stream, buffer, num_samples);
 }
 
 bool sim_exec(uint64_t t1)
@@ -522,9 +657,18 @@ bool sim_exec(uint64_t t1)
   const int num_samples = num_frames * saudio_channels();
   int r = read_samples(&state, state.dst_buf, num_samples);
   if(r == 0)
+  {
+    modplay_stream_stop(&state.stream);
+    modplay_stream_print_stats(&state.stream);
     return false;
+  }
 
   state.audio_cb(state.dst_buf, r, NULL);
+  if(++state.frame_count % MODPLAY_STATS_FRAMES == 0)
+  {
+    modplay_stream_print_stats(&state.stream);
+    printf("audio device starved %u times\n", audio_starved);
+  }
   return true;
 }
 
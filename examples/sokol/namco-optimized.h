@@ -82,6 +82,13 @@ typedef int32_t namco_sample_t;
 #define NAMCO_AUDIO_SAMPLE_SCALING 0x4000
 #endif
 
+//#define NAMCO_INDEXED_PIXELS
+#ifdef NAMCO_INDEXED_PIXELS
+typedef uint8_t namco_pixel_t;      // index into namco_palette(), 32 colors
+#else
+typedef uint32_t namco_pixel_t;     // RGBA8
+#endif
+
 #define NAMCO_MAX_AUDIO_SAMPLES (1024)
 #define NAMCO_DEFAULT_AUDIO_SAMPLES (128)
 
@@ -129,7 +136,7 @@ typedef struct {
 
     // video output config
     struct {
-        void* ptr;      // pointer to a linear RGBA8 pixel buffer, at least 224*256*4 bytes
+        void* ptr;      // pointer to a linear RGBA8 pixel buffer, at least 288*224*4 bytes (1 byte per pixel with NAMCO_INDEXED_PIXELS)
         size_t size;    // size of the pixel buffer in bytes
     } pixel_buffer;
 
@@ -215,8 +222,9 @@ typedef struct {
     bool valid;
     namco_debug_t debug;
 
-    uint32_t* pixel_buffer;
-    uint32_t palette_cache[512];    // precomputed RGBA values, Pacman: 256 entries , Pengo: 512 entries
+    namco_pixel_t* pixel_buffer;
+    namco_pixel_t palette_cache[512];   // precomputed pixel values, Pacman: 256 entries , Pengo: 512 entries
+    uint32_t hw_colors[32];             // RGBA values of the 32 hardware colors
     void* user_data;
     namco_sound_t sound;
     uint8_t video_ram[0x0400];
@@ -235,6 +243,8 @@ void namco_discard(namco_t* sys);
 void namco_reset(namco_t* sys);
 // run namco_t instance for given amount of microseconds, return number of ticks executed
 uint32_t namco_exec(namco_t* sys, uint32_t micro_seconds);
+// run the emulation for an exact number of CPU clock ticks
+void namco_exec_ticks(namco_t* sys, uint32_t num_ticks);
 // set input bits
 void namco_input_set(namco_t* sys, uint32_t mask);
 // clear input bits
@@ -245,6 +255,8 @@ int namco_std_display_height(void);
 // get the current framebuffer width and height in pixels
 int namco_display_width(namco_t* sys);
 int namco_display_height(namco_t* sys);
+// get the 32 RGBA hardware colors (the palette for NAMCO_INDEXED_PIXELS)
+const uint32_t* namco_palette(namco_t* sys);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -260,6 +272,17 @@ int namco_display_height(namco_t* sys);
 #if !defined(NAMCO_PACMAN) && !defined(NAMCO_PENGO)
 #error "Please define NAMCO_PACMAN or NAMCO_PENGO before including the implementation"
 #endif
+/* optional profiling hooks, phase is one of CPU, SOUND, VIDEO (see namco-main.c),
+   the TICK variants run once per clock cycle
+*/
+#ifndef NAMCO_PROF_BEGIN
+    #define NAMCO_PROF_BEGIN(phase)
+    #define NAMCO_PROF_END(phase)
+#endif
+#ifndef NAMCO_PROF_TICK_BEGIN
+    #define NAMCO_PROF_TICK_BEGIN(phase)
+    #define NAMCO_PROF_TICK_END(phase)
+#endif
 
 #if defined NAMCO_PACMAN
     #define NAMCO_ADDR_MASK         (0x7FFF)    /* Pacman has only 15 addr pins wired */
@@ -426,7 +449,18 @@ int namco_display_height(namco_t* sys);
 #define NAMCO_VSYNC_PERIOD      (NAMCO_CPU_CLOCK / 60)
 #define NAMCO_DISPLAY_WIDTH     (288)
 #define NAMCO_DISPLAY_HEIGHT    (224)
-#define NAMCO_DISPLAY_SIZE      (NAMCO_DISPLAY_WIDTH*NAMCO_DISPLAY_HEIGHT*4)
+#define NAMCO_DISPLAY_SIZE      (NAMCO_DISPLAY_WIDTH*NAMCO_DISPLAY_HEIGHT*sizeof(namco_pixel_t))
+
+/* In indexed mode a palette cache entry has bit 7 set for black (transparent
+   in sprites), so the tile decoder doesn't need the RGBA color to decide.
+*/
+#ifdef NAMCO_INDEXED_PIXELS
+#define _NAMCO_TRANSPARENT(pix) ((pix) & 0x80)
+#define _NAMCO_PIXEL(pix) ((pix) & 0x7F)
+#else
+#define _NAMCO_TRANSPARENT(pix) ((pix) == 0xFF000000)
+#define _NAMCO_PIXEL(pix) (pix)
+#endif
 
 static void _namco_sound_init(namco_t* sys, const namco_desc_t* desc);
 static void _namco_sound_wr(namco_t* sys, uint16_t addr, uint8_t data);
@@ -441,7 +475,7 @@ void namco_init(namco_t* sys, const namco_desc_t* desc) {
 
     memset(sys, 0, sizeof(namco_t));
     sys->valid = true;
-    sys->pixel_buffer = (uint32_t*) desc->pixel_buffer.ptr;
+    sys->pixel_buffer = (namco_pixel_t*) desc->pixel_buffer.ptr;
     sys->debug = desc->debug;
     sys->vsync_count = NAMCO_VSYNC_PERIOD;
     _namco_sound_init(sys, desc);
@@ -550,7 +584,7 @@ void namco_init(namco_t* sys, const namco_desc_t* desc) {
     #endif
 
     // setup an RGBA palette from the 8-bit RGB values in PROM
-    uint32_t hw_colors[32];
+    uint32_t* hw_colors = sys->hw_colors;
     for (int i = 0; i < 32; i++) {
         /*
            Each color ROM entry describes an RGB color in 1 byte:
@@ -572,8 +606,13 @@ void namco_init(namco_t* sys, const namco_desc_t* desc) {
     }
     for (int i = 0; i < 256; i++) {
         uint8_t pal_index = sys->rom_prom[i + 0x20] & 0xF;
+#ifdef NAMCO_INDEXED_PIXELS
+        sys->palette_cache[i] = pal_index | ((hw_colors[pal_index] == 0xFF000000) ? 0x80 : 0);
+        sys->palette_cache[256 + i] = (0x10 | pal_index) | ((hw_colors[0x10 | pal_index] == 0xFF000000) ? 0x80 : 0);
+#else
         sys->palette_cache[i] = hw_colors[pal_index];
         sys->palette_cache[256 + i] = hw_colors[0x10 | pal_index];
+#endif
     }
 }
 
@@ -598,7 +637,9 @@ static uint64_t _namco_tick(namco_t* sys, uint64_t pins) {
     }
 
     // tick the sound chip
+    NAMCO_PROF_TICK_BEGIN(SOUND);
     _namco_sound_tick(sys);
+    NAMCO_PROF_TICK_END(SOUND);
 
     pins = z80_tick(&sys->cpu, pins);
 
@@ -708,9 +749,9 @@ static FAST_CODE uint16_t _namco_video_offset(uint32_t x, uint32_t y) {
 
 // 8x4 video tile decoder (used both for background tiles and sprites)
 static FAST_CODE inline void _namco_8x4(
-    uint32_t* pixel_base,
+    namco_pixel_t* pixel_base,
     uint8_t* tile_base,
-    uint32_t* palette_base,
+    namco_pixel_t* palette_base,
     uint32_t tile_stride,
     uint32_t tile_offset,
     uint32_t px,
@@ -737,10 +778,10 @@ static FAST_CODE inline void _namco_8x4(
             uint8_t p2_hi = (tile_base[tile_index]>>(7-xx)) & 1;
             uint8_t p2_lo = (tile_base[tile_index]>>(3-xx)) & 1;
             uint8_t p2 = (p2_hi<<1)|p2_lo;
-            uint32_t rgba = palette_base[(color_code<<2)|p2];
-            if (opaque || (rgba != 0xFF000000)) {
-                uint32_t* dst = &pixel_base[y*NAMCO_DISPLAY_WIDTH + x];
-                *dst = rgba;
+            namco_pixel_t pix = palette_base[(color_code<<2)|p2];
+            if (opaque || !_NAMCO_TRANSPARENT(pix)) {
+                namco_pixel_t* dst = &pixel_base[y*NAMCO_DISPLAY_WIDTH + x];
+                *dst = _NAMCO_PIXEL(pix);
             }
         }
     }
@@ -748,8 +789,8 @@ static FAST_CODE inline void _namco_8x4(
 
 // decode background tiles
 static FAST_CODE void _namco_decode_chars(namco_t* sys) {
-    uint32_t* pixel_base = sys->pixel_buffer;
-    uint32_t* pal_base = &sys->palette_cache[(sys->pal_select<<8)|(sys->clut_select<<7)];
+    namco_pixel_t* pixel_base = sys->pixel_buffer;
+    namco_pixel_t* pal_base = &sys->palette_cache[(sys->pal_select<<8)|(sys->clut_select<<7)];
     uint8_t* tile_base = &sys->rom_gfx[0x0000] + (sys->tile_select * 0x2000);
     for (uint32_t y = 0; y < 28; y++) {
         for (uint32_t x = 0; x < 36; x++) {
@@ -763,8 +804,8 @@ static FAST_CODE void _namco_decode_chars(namco_t* sys) {
 }
 
 static FAST_CODE void _namco_decode_sprites(namco_t* sys) {
-    uint32_t* pixel_base = sys->pixel_buffer;
-    uint32_t* pal_base = &sys->palette_cache[(sys->pal_select<<8)|(sys->clut_select<<7)];
+    namco_pixel_t* pixel_base = sys->pixel_buffer;
+    namco_pixel_t* pal_base = &sys->palette_cache[(sys->pal_select<<8)|(sys->clut_select<<7)];
     uint8_t* tile_base = &sys->rom_gfx[0x1000] + (sys->tile_select * 0x2000);
     #if defined(NAMCO_PACMAN)
     const int max_sprite = 6;
@@ -809,6 +850,12 @@ void _namco_decode_video(namco_t* sys) {
 uint32_t namco_exec(namco_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
     const uint32_t num_ticks = clk_us_to_ticks(NAMCO_CPU_CLOCK, micro_seconds);
+    namco_exec_ticks(sys, num_ticks);
+    return num_ticks;
+}
+
+void namco_exec_ticks(namco_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
     uint64_t pins = sys->pins;
     if (0 == sys->debug.callback.func) {
         // run without debug hook
@@ -824,8 +871,9 @@ uint32_t namco_exec(namco_t* sys, uint32_t micro_seconds) {
         }
     }
     sys->pins = pins;
+    NAMCO_PROF_BEGIN(VIDEO);
     _namco_decode_video(sys);
-    return num_ticks;
+    NAMCO_PROF_END(VIDEO);
 }
 
 void namco_input_set(namco_t* sys, uint32_t mask) {
@@ -950,6 +998,11 @@ int namco_display_height(namco_t* sys) {
     return NAMCO_DISPLAY_HEIGHT;
 }
 
+const uint32_t* namco_palette(namco_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return sys->hw_colors;
+}
+
 static void _namco_sound_init(namco_t* sys, const namco_desc_t* desc) {
     CHIPS_ASSERT(desc->audio.num_samples <= NAMCO_MAX_AUDIO_SAMPLES);
     // assume zero-initialized
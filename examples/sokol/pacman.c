@@ -10,6 +10,7 @@
 #include "chips/mem.h"
 #include "pacman-roms.h"
 #define NAMCO_PACMAN
+#define NAMCO_INDEXED_PIXELS
 #include "namco-optimized.h"
 #if defined(CHIPS_USE_UI)
     #define UI_DBG_USE_Z80
@@ -43,8 +44,16 @@ static struct {
 #define BORDER_RIGHT (8)
 #define BORDER_BOTTOM (16)
 
+// no video decoding for the hidden run-ahead frames
+static void runahead_video(bool enabled) {
+    state.sys.pixel_buffer = enabled ? (namco_pixel_t*) gfx_framebuffer() : 0;
+}
+
 static void push_audio(const namco_sample_t* samples, int num_samples, void* user_data) {
     (void)user_data;
+    if (runahead_active()) {
+        return;
+    }
 #ifdef NAMCO_AUDIO_FLOAT 
     saudio_push(samples, num_samples);
 #else
@@ -55,6 +64,16 @@ static void push_audio(const namco_sample_t* samples, int num_samples, void* use
 #endif
 }
 
+// the pointers in a snapshot of the system, see snapshot.h
+static void snapshot_fixup(snapshot_fixup_t* fx, void* ptr) {
+    namco_t* sys = (namco_t*) ptr;
+    snapshot_relocate(fx, &sys->mem, sizeof(sys->mem));
+    snapshot_keep(fx, &sys->debug, sizeof(sys->debug));
+    snapshot_keep(fx, &sys->sound.callback, sizeof(sys->sound.callback));
+    snapshot_keep(fx, &sys->user_data, sizeof(sys->user_data));
+    snapshot_keep(fx, &sys->pixel_buffer, sizeof(sys->pixel_buffer));
+}
+
 #if defined(CHIPS_USE_UI)
 static void ui_draw_cb(void) {
     ui_namco_draw(&state.ui);
@@ -70,11 +89,16 @@ static void app_init(void) {
         .border_right = BORDER_RIGHT,
         .border_top = BORDER_TOP,
         .border_bottom = BORDER_BOTTOM,
+        .fb_width = namco_std_display_width(),
+        .fb_height = namco_std_display_height(),
         .emu_aspect_x = 2,
         .emu_aspect_y = 3,
-        .rot90 = true
+        .rot90 = true,
+        .indexed = true
     });
     clock_init();
+    // prof-export=file.csv (summary) or file.json (Chrome trace), written at exit
+    prof_set_export(sargs_value_def("prof-export", 0));
     prof_init();
     saudio_setup(&(saudio_desc){0});
     namco_init(&state.sys, &(namco_desc_t){
@@ -103,6 +127,19 @@ static void app_init(void) {
         .debug = ui_namco_get_debug(&state.ui),
         #endif
     });
+    gfx_set_palette(namco_palette(&state.sys), 32);
+    snapshot_init(&(snapshot_desc_t){
+        .system = "pacman",
+        .build = __DATE__ " " __TIME__,
+        .sys = &state.sys,
+        .sys_size = sizeof(state.sys),
+        .fixup_cb = snapshot_fixup,
+    });
+    runahead_init(&(runahead_desc_t){
+        .sys = &state.sys,
+        .sys_size = sizeof(state.sys),
+        .video_cb = runahead_video,
+    });
     #ifdef CHIPS_USE_UI
         ui_init(ui_draw_cb);
         ui_namco_init(&state.ui, &(ui_namco_desc_t){
@@ -125,9 +162,15 @@ static void app_init(void) {
 static void draw_status_bar(void);
 
 static void app_frame(void) {
-    state.frame_time_us = clock_frame_time();
+    // exact tick budget, the sub-tick remainder is carried into the next frame
+    state.ticks = clock_frame_ticks(NAMCO_CPU_CLOCK);
+    state.frame_time_us = (uint32_t) (((uint64_t)state.ticks * 1000000) / NAMCO_CPU_CLOCK);
     const uint64_t emu_start_time = stm_now();
-    state.ticks = namco_exec(&state.sys, state.frame_time_us);
+    namco_exec_ticks(&state.sys, state.ticks);
+    uint32_t ahead_us;
+    while ((ahead_us = runahead_exec_time(state.frame_time_us)) > 0) {
+        namco_exec(&state.sys, ahead_us);
+    }
     state.emu_time_ms = stm_ms(stm_since(emu_start_time));
     //draw_status_bar(); //this avoid to implement fonts and many features
     gfx_draw(namco_display_width(&state.sys), namco_display_height(&state.sys));
@@ -140,6 +183,9 @@ static void app_input(const sapp_event* event) {
         return;
     }
     #endif
+    if (snapshot_input(event)) {
+        return;
+    }
     switch (event->type) {
         case SAPP_EVENTTYPE_KEY_DOWN:
             switch (event->key_code) {
@@ -174,24 +220,29 @@ static void app_cleanup(void) {
         ui_namco_discard(&state.ui);
         ui_discard();
     #endif
+    prof_shutdown();
     saudio_shutdown();
     gfx_shutdown();
+    sargs_shutdown();
 }
 
 static void draw_status_bar(void) {
+    prof_push(PROF_FRAME, (float)state.frame_time_us * 0.001f);
     prof_push(PROF_EMU, (float)state.emu_time_ms);
+    prof_stats_t frame_stats = prof_stats(PROF_FRAME);
+    prof_percentiles_t frame_pct = prof_percentiles(PROF_FRAME);
     prof_stats_t emu_stats = prof_stats(PROF_EMU);
+    prof_percentiles_t emu_pct = prof_percentiles(PROF_EMU);
     const float w = sapp_widthf();
     const float h = sapp_heightf();
     sdtx_canvas(w, h);
     sdtx_color3b(255, 255, 255);
     sdtx_pos(1.0f, (h / 8.0f) - 1.5f);
-    sdtx_printf("frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d", (float)state.frame_time_us * 0.001f, emu_stats.avg_val, emu_stats.min_val, emu_stats.max_val, state.ticks);
+    sdtx_printf("frame:%.2fms p95:%.2f p99:%.2f emu:%.2fms p95:%.2f p99:%.2f ticks:%d", frame_stats.avg_val, frame_pct.p95_val, frame_pct.p99_val, emu_stats.avg_val, emu_pct.p95_val, emu_pct.p99_val, state.ticks);
 }
 
 sapp_desc sokol_main(int argc, char* argv[]) {
-    (void)argc;
-    (void)argv;
+    sargs_setup(&(sargs_desc){ .argc=argc, .argv=argv });
     return (sapp_desc) {
         .init_cb = app_init,
         .frame_cb = app_frame,
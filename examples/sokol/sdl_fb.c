@@ -50,6 +50,34 @@ void fb_update(fb_handle_t *handle, const void *buf, size_t stride_bytes)
     SDL_RenderPresent(handle->renderer);
 }
 
+void fb_update_rows(fb_handle_t *handle, const void *buf, size_t stride_bytes, int first_row, int num_rows)
+{
+    int w, h;
+    if(SDL_QueryTexture(handle->texture, NULL, NULL, &w, &h) != 0 || first_row >= h)
+      return;
+    if(first_row + num_rows > h)
+      num_rows = h - first_row;
+    if(w > (int)(stride_bytes/4))
+      w = stride_bytes/4; //don't read past the rows of a buffer narrower than the window
+    SDL_Rect rect = { 0, first_row, w, num_rows };
+    SDL_UpdateTexture(handle->texture, &rect, (const uint8_t*)buf + first_row*stride_bytes, stride_bytes);
+}
+
+void fb_present(fb_handle_t *handle)
+{
+    SDL_RenderCopy(handle->renderer, handle->texture, NULL, NULL);
+    SDL_RenderPresent(handle->renderer);
+}
+
+bool fb_vsync_enabled(fb_handle_t *handle)
+{
+    //the vsync flag is only a request, check if the renderer really blocks on present
+    SDL_RendererInfo info;
+    if(!handle->renderer || SDL_GetRendererInfo(handle->renderer, &info) != 0)
+      return false;
+    return (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
+}
+
 void fb_deinit(fb_handle_t *handle)
 {
     SDL_DestroyTexture(handle->texture);
@@ -16,7 +16,11 @@ typedef struct
 
 bool fb_init(unsigned width, unsigned height, bool vsync, fb_handle_t *handle);
 void fb_update(fb_handle_t *handle, const void *buf, size_t stride_bytes);
+//uploads only rows first_row..first_row+num_rows-1 of buf, call fb_present() afterwards
+void fb_update_rows(fb_handle_t *handle, const void *buf, size_t stride_bytes, int first_row, int num_rows);
+void fb_present(fb_handle_t *handle);
 void fb_deinit(fb_handle_t *handle);
+bool fb_vsync_enabled(fb_handle_t *handle);
 bool fb_should_quit(void);  
 
 extern uint64_t SDL_GetPerformanceCounter(void);
@@ -16,7 +16,7 @@ common.h (in examples):
   gfx_framebuffer, gfx_framebuffer_size
   prof_push, prof_stats
   gfx_init, gfx_shutdown
-  gfx_draw
+  gfx_draw, gfx_set_palette, gfx_flash_success, gfx_flash_error
 */
 
 
@@ -45,11 +45,15 @@ stm_since, stm_ms
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h> //getenv, strtol
 #include <string.h> //memset
 #include <signal.h>
+#include <errno.h> //EINTR
 #include <pthread.h>
+#ifndef SOKOL_HAL_NULL
 #include "sdl_fb.h"
 #include <SDL2/SDL.h> //for events
+#endif
 
 #include "sokol_app.h" //no implementation requested
 
@@ -67,17 +71,71 @@ stm_since, stm_ms
 
 SOKOL_API_IMPL void _sapp_linux_run(const sapp_desc* desc);
 sapp_desc sokol_main(int argc, char* argv[]);
- 
+
+/* backends: SDL (window, audio device, input events) or null (no window, no
+   audio device, fixed frame step, for headless benchmark runs). Build with
+   -DSOKOL_HAL_NULL to drop SDL entirely, or set SOKOL_HAL_BACKEND=null
+*/
+static bool _sapp_null_backend;
+
+#define COMMON_IMPL
+#include "capture.h" //all portable
+#include "prof.h" //all portable
+#include "clock.h" //all portable
+#define RUNAHEAD_NO_STATUS //no sokol_debugtext here
+#include "runahead.h"
+#undef COMMON_IMPL
+#define GFX_DIRTY_IMPL //only the dirty-row detection from gfx.h
+#include "gfx.h"
+#undef GFX_DIRTY_IMPL
+#define COMMON_IMPL
+#include "snapshot.h" //all portable, uses gfx_flash_success/error from below
+#undef COMMON_IMPL
+
+//capture-video=file.y4m and capture-audio=file.wav, same key=value form as sokol_args
+static const char* _sapp_arg_value(int argc, char* argv[], const char* key) {
+    size_t len = strlen(key);
+    for (int i = 1; i < argc; i++) {
+        if ((0 == strncmp(argv[i], key, len)) && (argv[i][len] == '=')) {
+            return &argv[i][len+1];
+        }
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
+#ifdef SOKOL_HAL_NULL
+    _sapp_null_backend = true;
+#else
+    const char* backend = getenv("SOKOL_HAL_BACKEND");
+    _sapp_null_backend = backend && (0 == strcmp(backend, "null"));
+#endif
+    capture_init(&(capture_desc_t){
+        .video_path = _sapp_arg_value(argc, argv, "capture-video"),
+        .audio_path = _sapp_arg_value(argc, argv, "capture-audio"),
+        .fps = 60,
+    });
+    //headless runs and recordings advance emulated time by exact 1/60s steps
+    if(_sapp_null_backend || capture_active())
+        clock_set_fixed_fps(60);
+    //prof-export=file.csv (summary) or file.json (Chrome trace), written at exit
+    prof_set_export(_sapp_arg_value(argc, argv, "prof-export"));
+    //snapshot=file.snp, loaded when the app calls snapshot_init()
+    snapshot_set_load_path(_sapp_arg_value(argc, argv, "snapshot"));
+    //runahead=N, frames emulated ahead of the presented one (apps calling runahead_init())
+    const char* runahead = _sapp_arg_value(argc, argv, "runahead");
+    runahead_set_frames(runahead ? (int)strtol(runahead, NULL, 10) : 0);
+    prof_init(); //apps usually do this again in their init callback
     sapp_desc desc = sokol_main(argc, argv);
     _sapp_linux_run(&desc);
+    capture_shutdown();
+    prof_shutdown();
     return 0;
 }
 
 
 ////////////////////////////////
 //from sokol_app.h
-#include "gfx.h"
 
 SOKOL_API_IMPL int sapp_width(void) {
     return GFX_MAX_FB_WIDTH;
@@ -114,7 +172,9 @@ void _saudio_clear(void* ptr, size_t size) {
 
 
 typedef struct {
+#ifndef SOKOL_HAL_NULL
     SDL_AudioDeviceID device;
+#endif
 /*
     float* buffer;
     int buffer_byte_size;
@@ -151,10 +211,14 @@ bool _saudio_has_callback(void) {
 
 
 bool _saudio_backend_init(void) {
+	int num_channels = _saudio.num_channels;
+	_saudio.bytes_per_frame = sizeof(float)*num_channels;
+	if(_sapp_null_backend)
+		return true; //no device, pushed samples are dropped
+
+#ifndef SOKOL_HAL_NULL
 	int samplerate = _saudio.sample_rate;
 	int num_samples = _saudio.packet_frames;
-	int num_channels = _saudio.num_channels;
-	
 	static SDL_AudioSpec specs = {0}, obtanined;
 	specs.freq = samplerate;
 	specs.channels = num_channels;
@@ -164,18 +228,21 @@ bool _saudio_backend_init(void) {
 	specs.format = AUDIO_F32SYS; //float32
 
 	SDL_InitSubSystem(SDL_INIT_AUDIO);
-	_saudio.bytes_per_frame = sizeof(float)*num_channels;
 	_saudio.backend.device = SDL_OpenAudioDevice(NULL, 0, &specs, &obtanined, SDL_AUDIO_ALLOW_CHANNELS_CHANGE|SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
 	if (!_saudio.backend.device)
 		return false;
 
 	SDL_PauseAudioDevice(_saudio.backend.device, 0); //start playing
     printf("Audio ok, samplerate %d, num_samples %d, num_channels %d\n", samplerate, num_samples, num_channels);
+#endif
     return true;
 };
 
 void _saudio_backend_shutdown(void) {
-  SDL_CloseAudioDevice(_saudio.backend.device);
+#ifndef SOKOL_HAL_NULL
+  if(!_sapp_null_backend)
+    SDL_CloseAudioDevice(_saudio.backend.device);
+#endif
 };
 
 SOKOL_API_IMPL void saudio_setup(const saudio_desc* desc) {
@@ -239,9 +306,17 @@ SOKOL_API_IMPL int saudio_push(const float* frames, int num_frames) {
 
     SOKOL_ASSERT(frames && (num_frames > 0));
     if (_saudio.valid) {
+        capture_audio(frames, num_frames, _saudio.num_channels, _saudio.sample_rate);
+        if(_sapp_null_backend)
+            return num_frames;
+#ifndef SOKOL_HAL_NULL
         const int num_bytes = num_frames * _saudio.bytes_per_frame;
-		if(SDL_QueueAudio(_saudio.backend.device, frames, num_bytes) == 0)
+        PROF_BEGIN(audio);
+        int res = SDL_QueueAudio(_saudio.backend.device, frames, num_bytes);
+        PROF_END(audio);
+		if(res == 0)
 	        return num_frames;
+#endif
     }
 	return 0;
 }
@@ -249,10 +324,14 @@ SOKOL_API_IMPL int saudio_push(const float* frames, int num_frames) {
 //returns how much is in the buffer
 SOKOL_AUDIO_API_DECL int saudio_expect(void)
 {
-  int queued = SDL_GetQueuedAudioSize(_saudio.backend.device)/_saudio.bytes_per_frame;
   int frames = _saudio.packet_frames;
+  if(_sapp_null_backend)
+    return frames; //nothing is ever queued
+#ifndef SOKOL_HAL_NULL
+  int queued = SDL_GetQueuedAudioSize(_saudio.backend.device)/_saudio.bytes_per_frame;
   if(queued >= _saudio.buffer_frames)
     return 0;
+#endif
   return frames; //always fixed packet size expected
 }
 
@@ -331,15 +410,26 @@ typedef struct {
         } posix;
 } _sapp_timestamp_t;
 
+#define _SAPP_TIMING_NUM (60)        // number of frame durations averaged per window
+#define _SAPP_TIMING_MAX_SPIKES (20)  // consecutive outliers until timing is reset
+
 typedef struct {
     double last;
     double accum;
     double avg;
+    bool avg_valid;
     int spike_count;
     int num;
     _sapp_timestamp_t timestamp;
 } _sapp_timing_t;
 
+// sleep-until-deadline frame scheduler, used when presentation doesn't block on vsync
+typedef struct {
+    bool enabled;
+    uint64_t period_ns;
+    uint64_t deadline_ns;
+} _sapp_pacing_t;
+
 typedef struct {
     sapp_desc desc;
     bool valid;
@@ -362,6 +452,7 @@ typedef struct {
     float dpi_scale;
     uint64_t frame_count;
     _sapp_timing_t timing;
+    _sapp_pacing_t pacing;
     sapp_event event;
     /*
     _sapp_mouse_t mouse;
@@ -423,6 +514,18 @@ void _sapp_call_frame(void) {
     }
 }
 
+void _sapp_call_cleanup(void) {
+    if (!_sapp.cleanup_called) {
+        if (_sapp.desc.cleanup_cb) {
+            _sapp.desc.cleanup_cb();
+        }
+        else if (_sapp.desc.cleanup_userdata_cb) {
+            _sapp.desc.cleanup_userdata_cb(_sapp.desc.user_data);
+        }
+        _sapp.cleanup_called = true;
+    }
+}
+
 void _sapp_frame(void) {
     if (_sapp.first_frame) {
         _sapp.first_frame = false;
@@ -445,12 +548,90 @@ void _sapp_timestamp_init(_sapp_timestamp_t* ts) {
         ts->posix.start = (uint64_t)tspec.tv_sec*1000000000 + (uint64_t)tspec.tv_nsec;
 }
 
+uint64_t _sapp_timestamp_now_ns(void) {
+        struct timespec tspec;
+        clock_gettime(_SAPP_CLOCK_MONOTONIC, &tspec);
+        return (uint64_t)tspec.tv_sec*1000000000 + (uint64_t)tspec.tv_nsec;
+}
+
+double _sapp_timestamp_now(_sapp_timestamp_t* ts) {
+    return (double)(_sapp_timestamp_now_ns() - ts->posix.start) / 1000000000.0;
+}
+
 void _sapp_timing_init(_sapp_timing_t* t) {
     t->avg = 1.0 / 60.0;    // dummy value until first actual value is available
+    t->avg_valid = false;
     _sapp_timing_reset(t);
     _sapp_timestamp_init(&t->timestamp);
 }
 
+void _sapp_timing_put(_sapp_timing_t* t, double dur) {
+    // arbitrary upper limit to ignore outliers (e.g. during window resizing, or debugging)
+    double min_dur = 0.0;
+    double max_dur = 0.1;
+    // if we have enough samples for a useful average, use a much tighter 'valid window'
+    if (t->avg_valid) {
+        min_dur = t->avg * 0.8;
+        max_dur = t->avg * 1.2;
+    }
+    if ((dur < min_dur) || (dur > max_dur)) {
+        t->spike_count++;
+        // if there have been many spikes in a row, the display refresh rate
+        // might have changed, so a timing reset is needed
+        if (t->spike_count > _SAPP_TIMING_MAX_SPIKES) {
+            _sapp_timing_reset(t);
+            t->avg_valid = false;
+        }
+        return;
+    }
+    t->spike_count = 0;
+    t->accum += dur;
+    t->num++;
+    if (t->num == _SAPP_TIMING_NUM) {
+        t->avg = t->accum / (double)t->num;
+        t->avg_valid = true;
+        t->accum = 0.0;
+        t->num = 0;
+    }
+}
+
+void _sapp_timing_discontinuity(_sapp_timing_t* t) {
+    t->last = 0.0;
+}
+
+void _sapp_timing_measure(_sapp_timing_t* t) {
+    const double now = _sapp_timestamp_now(&t->timestamp);
+    if (t->last > 0.0) {
+        _sapp_timing_put(t, now - t->last);
+    }
+    t->last = now;
+}
+
+void _sapp_pacing_init(_sapp_pacing_t* p, bool enabled, int swap_interval) {
+    p->enabled = enabled;
+    p->period_ns = (uint64_t)swap_interval * (1000000000 / 60);
+    p->deadline_ns = 0;
+}
+
+// block until the next frame deadline, without vsync this replaces the busy loop
+void _sapp_pacing_wait(_sapp_pacing_t* p) {
+    if (!p->enabled) {
+        return;
+    }
+    const uint64_t now = _sapp_timestamp_now_ns();
+    p->deadline_ns += p->period_ns;
+    if ((p->deadline_ns < now) || (p->deadline_ns > (now + p->period_ns))) {
+        // first frame, or fell behind by more than a frame: restart the
+        // schedule instead of running a burst of frames to catch up
+        p->deadline_ns = now + p->period_ns;
+    }
+    struct timespec ts = {
+        .tv_sec = (time_t)(p->deadline_ns / 1000000000),
+        .tv_nsec = (long)(p->deadline_ns % 1000000000)
+    };
+    while (clock_nanosleep(_SAPP_CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
 void _sapp_clear(void* ptr, size_t size) {
     SOKOL_ASSERT(ptr && (size > 0));
     memset(ptr, 0, size);
@@ -529,21 +710,60 @@ void _sapp_init_state(const sapp_desc* desc) {
 #include "gfx.h" //just prototypes and defines (since no COMMON_IMPL defined)
 
 //FIXME: move this to the correct struct
+#ifndef SOKOL_HAL_NULL
 static fb_handle_t fb;
-static uint32_t rgba8_buffer[GFX_MAX_FB_WIDTH * GFX_MAX_FB_HEIGHT];
-static uint32_t rotated_buffer[GFX_MAX_FB_WIDTH*GFX_MAX_FB_HEIGHT];
+#endif
+//buffers are allocated in gfx_init() for the largest emulator display (gfx_desc.fb_width/height)
+static uint32_t *rgba8_buffer; //bytes in indexed mode
+static size_t rgba8_buffer_size;
+static uint32_t *rotated_buffer; //scaled by the emulator aspect and at least as big as the window
+static int rotated_stride;
 static gfx_desc_t gfx_desc;
+static gfx_dirty_t gfx_dirty;
+static uint32_t gfx_palette[GFX_PALETTE_SIZE];
+static uint32_t *indexed_rgba8_buffer; //indexed mode: converted on the CPU
+
+static int _gfx_max(int a, int b) { return a > b ? a : b; }
 
 void gfx_init(const gfx_desc_t* desc) {
 	gfx_desc = *desc;
     //printf("border_top %d, border_bottom %d, border_left %d, border_right %d, rot90 %d\n", desc->border_top, desc->border_bottom, desc->border_left, desc->border_right, desc->rot90);
-    memset(rotated_buffer, 0, sizeof(rotated_buffer));
-	fb_init(_sapp.desc.width, _sapp.desc.height, true, &fb);
+	if(gfx_desc.fb_width == 0) gfx_desc.fb_width = GFX_MAX_FB_WIDTH;
+	if(gfx_desc.fb_height == 0) gfx_desc.fb_height = GFX_MAX_FB_HEIGHT;
+	if(gfx_desc.emu_aspect_x == 0) gfx_desc.emu_aspect_x = 1;
+	if(gfx_desc.emu_aspect_y == 0) gfx_desc.emu_aspect_y = 1;
+	const size_t num_pixels = (size_t)gfx_desc.fb_width*gfx_desc.fb_height;
+	rgba8_buffer_size = num_pixels*(gfx_desc.indexed ? 1 : sizeof(uint32_t));
+	rgba8_buffer = calloc(1, rgba8_buffer_size);
+	if(gfx_desc.indexed)
+		indexed_rgba8_buffer = calloc(num_pixels, sizeof(uint32_t));
 	signal(SIGINT, SIG_DFL); //allows to exit by ctrl-c
+	if(_sapp_null_backend)
+		return; //no window, frames run back-to-back
+#ifndef SOKOL_HAL_NULL
+	if(gfx_desc.rot90)
+	{
+		//the whole window texture is updated from this buffer
+		rotated_stride = _gfx_max(_sapp.desc.width, gfx_desc.fb_height*gfx_desc.emu_aspect_y);
+		const int rotated_rows = _gfx_max(_sapp.desc.height, gfx_desc.fb_width*gfx_desc.emu_aspect_x);
+		rotated_buffer = calloc((size_t)rotated_stride*rotated_rows, sizeof(uint32_t));
+	}
+	fb_init(_sapp.desc.width, _sapp.desc.height, true, &fb);
+	//renderers without vsync (software, VNC, headless) need explicit frame pacing,
+	//but capturing runs as fast as the renderer allows
+	_sapp_pacing_init(&_sapp.pacing, !fb_vsync_enabled(&fb) && !capture_active(), _sapp.swap_interval);
+#endif
 }
 
 void gfx_shutdown() {
-	fb_deinit(&fb);
+#ifndef SOKOL_HAL_NULL
+	if(!_sapp_null_backend)
+		fb_deinit(&fb);
+#endif
+	free(rotated_buffer);
+	free(indexed_rgba8_buffer);
+	free(rgba8_buffer);
+	rotated_buffer = indexed_rgba8_buffer = rgba8_buffer = NULL;
 }
 
 uint32_t* gfx_framebuffer(void) {
@@ -551,22 +771,67 @@ uint32_t* gfx_framebuffer(void) {
 }
 
 size_t gfx_framebuffer_size(void) {
-    return sizeof(rgba8_buffer);
+    return rgba8_buffer_size;
+}
+
+void gfx_set_palette(const uint32_t* colors, int num_colors) {
+	uint32_t new_colors[GFX_PALETTE_SIZE] = {0};
+	for(int i = 0; i < num_colors; ++i)
+		new_colors[i] = colors[i] | 0xFF000000;
+	if(memcmp(new_colors, gfx_palette, sizeof(gfx_palette)) != 0)
+	{
+		memcpy(gfx_palette, new_colors, sizeof(gfx_palette));
+		gfx_dirty_reset(&gfx_dirty); //all rows need to be converted again
+	}
+}
+
+//no clear color to tint, snapshot hotkeys just don't give visual feedback
+void gfx_flash_success(void) {
+}
+
+void gfx_flash_error(void) {
 }
 
 void gfx_draw(int emu_width, int emu_height) {
+	const uint32_t *pixels = rgba8_buffer;
+	int dirty_rows = 0;
+	if(gfx_desc.indexed)
+	{
+		//convert only the rows that changed, the rest is still valid from previous frames
+		const uint8_t *indices = (const uint8_t *) rgba8_buffer;
+		dirty_rows = gfx_dirty_update_indexed(&gfx_dirty, indices, emu_width, emu_height, emu_width);
+		for(int i = 0; i < gfx_dirty.num_spans; ++i)
+		{
+			const gfx_row_span_t *span = &gfx_dirty.spans[i];
+			gfx_indexed_to_rgba8(indices + span->first_row*emu_width, emu_width, gfx_palette,
+				indexed_rgba8_buffer + span->first_row*emu_width, emu_width, emu_width, span->num_rows);
+		}
+		pixels = indexed_rgba8_buffer;
+	}
+	capture_video(pixels, emu_width, emu_height, gfx_desc.rot90);
+	if(_sapp_null_backend)
+		return;
+#ifndef SOKOL_HAL_NULL
+	PROF_BEGIN(draw);
 	//static int frame = 0;
 	//printf("draw emu window %dx%d, time %d, frame/60 %d\n", emu_width, emu_height, stm_now()/1000000000, ++frame/60);
-	if(gfx_desc.rot90)
+	if(!gfx_desc.indexed)
+		dirty_rows = gfx_dirty_update(&gfx_dirty, pixels, emu_width, emu_height, emu_width);
+	if(dirty_rows == 0)
+	{
+		//nothing changed, just present the previous texture (keeps vsync pacing)
+		fb_present(&fb);
+	}
+	else if(gfx_desc.rot90)
 	{
-		const uint32_t *p = rgba8_buffer+emu_height*emu_width;
+		const uint32_t *p = pixels+emu_height*emu_width;
 		for(int x = 0; x < emu_height; ++x)
 		{
 			p -= emu_width;
 			for(int y = 0; y < emu_width; ++y)
-				rotated_buffer[x*gfx_desc.emu_aspect_y+y*gfx_desc.emu_aspect_x*GFX_MAX_FB_WIDTH] = p[y]; //FIXME: optimize
+				rotated_buffer[x*gfx_desc.emu_aspect_y+y*gfx_desc.emu_aspect_x*rotated_stride] = p[y]; //FIXME: optimize
 		}
-		fb_update(&fb, rotated_buffer, GFX_MAX_FB_WIDTH*sizeof(rotated_buffer[0]));
+		fb_update(&fb, rotated_buffer, rotated_stride*sizeof(rotated_buffer[0]));
 		/*
 		const uint32_t *src = rgba8_buffer+emu_height*emu_width;
 		uint32_t *dst = rotated_buffer;
@@ -590,14 +855,27 @@ void gfx_draw(int emu_width, int emu_height) {
 	else
 	{
 		//show something that may not be right
-		fb_update(&fb, rgba8_buffer, emu_width*sizeof(rotated_buffer[0]));
+		//only upload the changed row spans
+		for(int i = 0; i < gfx_dirty.num_spans; ++i)
+		{
+			const gfx_row_span_t *span = &gfx_dirty.spans[i];
+			fb_update_rows(&fb, pixels, emu_width*sizeof(rotated_buffer[0]), span->first_row, span->num_rows);
+		}
+		fb_present(&fb);
 	}
+	PROF_END(draw);
+#else
+	(void)dirty_rows;
+#endif
 }
 
 SOKOL_APP_API_DECL double sapp_frame_duration(void)
 {
- //FIXME: measure and return averaged time
- return 1./60;
+    if(capture_active())
+        return capture_frame_duration(); //output follows emulated time
+    if(_sapp_null_backend)
+        return 1.0 / 60.0; //fixed emulated frame step
+    return _sapp.timing.avg;
 }
 
 
@@ -636,6 +914,7 @@ bool _sapp_call_event(const sapp_event* e) {
     }
 }
 
+#ifndef SOKOL_HAL_NULL
 int sdl2keymap(int k)
 {
   switch(k)
@@ -649,6 +928,147 @@ int sdl2keymap(int k)
   }
   return 0;
 }
+#endif
+
+/* null backend: runs SOKOL_HAL_FRAMES frames (default 600) back-to-back with
+   a fixed 1/60s step, replaying the key script in SOKOL_HAL_KEYS, then prints
+   host frame time stats. Script format is a comma separated list of
+   frame:key[:hold_frames], e.g. "120:5,180:1,200:left:30", hold_frames is
+   at least 1
+*/
+#define _SAPP_NULL_DEFAULT_FRAMES (600)
+#define _SAPP_NULL_DEFAULT_HOLD (2)
+#define _SAPP_NULL_MAX_KEYS (64)
+
+typedef struct {
+    uint64_t frame;
+    int hold;
+    sapp_keycode key_code;
+    uint32_t char_code;
+} _sapp_null_key_t;
+
+static int _sapp_null_keycode(const char* name, int len, uint32_t* char_code) {
+    static const struct { const char* name; int key_code; uint32_t char_code; } names[] = {
+        { "left", SAPP_KEYCODE_LEFT, 0 },
+        { "right", SAPP_KEYCODE_RIGHT, 0 },
+        { "up", SAPP_KEYCODE_UP, 0 },
+        { "down", SAPP_KEYCODE_DOWN, 0 },
+        { "space", SAPP_KEYCODE_SPACE, ' ' },
+        { "enter", SAPP_KEYCODE_ENTER, 0x0D },
+        { "escape", SAPP_KEYCODE_ESCAPE, 0 },
+    };
+    for (size_t i = 0; i < sizeof(names)/sizeof(names[0]); i++) {
+        if ((len == (int)strlen(names[i].name)) && (0 == strncmp(name, names[i].name, len))) {
+            *char_code = names[i].char_code;
+            return names[i].key_code;
+        }
+    }
+    if (len == 1) {
+        //sokol keycodes for digits and letters match their upper case ASCII code
+        char c = name[0];
+        *char_code = (uint32_t)c;
+        if ((c >= '0') && (c <= '9')) {
+            return c;
+        }
+        if ((c >= 'a') && (c <= 'z')) {
+            return c - 'a' + 'A';
+        }
+        if ((c >= 'A') && (c <= 'Z')) {
+            return c;
+        }
+    }
+    return SAPP_KEYCODE_INVALID;
+}
+
+static int _sapp_null_parse_keys(const char* str, _sapp_null_key_t* keys, int max_keys) {
+    int num_keys = 0;
+    while (str && *str && (num_keys < max_keys)) {
+        char* end;
+        _sapp_null_key_t k = { 0 };
+        k.frame = strtoull(str, &end, 10);
+        k.hold = _SAPP_NULL_DEFAULT_HOLD;
+        if ((end == str) || (*end != ':')) {
+            fprintf(stderr, "SOKOL_HAL_KEYS: expected frame:key at '%s'\n", str);
+            break;
+        }
+        const char* name = end + 1;
+        int len = (int)strcspn(name, ":,");
+        k.key_code = _sapp_null_keycode(name, len, &k.char_code);
+        str = name + len;
+        if (*str == ':') {
+            k.hold = (int)strtol(str + 1, &end, 10);
+            str = end;
+            //the KEY_UP goes out hold frames after the KEY_DOWN, so 0 would never release the key
+            if (k.hold < 1) {
+                k.hold = 1;
+            }
+        }
+        if (k.key_code != SAPP_KEYCODE_INVALID) {
+            keys[num_keys++] = k;
+        }
+        else {
+            fprintf(stderr, "SOKOL_HAL_KEYS: unknown key '%.*s'\n", len, name);
+        }
+        if (*str == ',') {
+            str++;
+        }
+    }
+    return num_keys;
+}
+
+static void _sapp_null_key_event(sapp_event_type type, const _sapp_null_key_t* k) {
+    _sapp_init_event(type);
+    _sapp.event.key_code = k->key_code;
+    _sapp.event.char_code = k->char_code;
+    _sapp_call_event(&_sapp.event);
+}
+
+static void _sapp_null_run(void) {
+    const char* frames_str = getenv("SOKOL_HAL_FRAMES");
+    uint64_t num_frames = frames_str ? strtoull(frames_str, 0, 10) : _SAPP_NULL_DEFAULT_FRAMES;
+    static _sapp_null_key_t keys[_SAPP_NULL_MAX_KEYS];
+    int num_keys = _sapp_null_parse_keys(getenv("SOKOL_HAL_KEYS"), keys, _SAPP_NULL_MAX_KEYS);
+
+    uint64_t total_ns = 0, min_ns = UINT64_MAX, max_ns = 0;
+    for (uint64_t frame = 0; frame < num_frames; frame++) {
+        //events can only be delivered once the app's init callback has run
+        if (_sapp.init_called) {
+            for (int i = 0; i < num_keys; i++) {
+                if (keys[i].frame == frame) {
+                    _sapp_null_key_event(SAPP_EVENTTYPE_KEY_DOWN, &keys[i]);
+                    if (keys[i].char_code) {
+                        _sapp_null_key_event(SAPP_EVENTTYPE_CHAR, &keys[i]);
+                    }
+                }
+                else if (keys[i].frame + keys[i].hold == frame) {
+                    _sapp_null_key_event(SAPP_EVENTTYPE_KEY_UP, &keys[i]);
+                }
+            }
+        }
+        uint64_t t0 = _sapp_timestamp_now_ns();
+        _sapp_frame();
+        uint64_t dt = _sapp_timestamp_now_ns() - t0;
+        if (frame == 0) {
+            continue; //skip the app's init
+        }
+        prof_push(PROF_HOST_FRAME, (float)dt * 1e-6f);
+        total_ns += dt;
+        if (dt < min_ns) min_ns = dt;
+        if (dt > max_ns) max_ns = dt;
+    }
+    _sapp_call_cleanup();
+
+    if (num_frames > 1) {
+        double total_s = (double)total_ns * 1e-9;
+        double fps = (double)(num_frames - 1) / total_s;
+        prof_percentiles_t p = prof_percentiles(PROF_HOST_FRAME);
+        printf("%llu frames in %.3fs (%.1f fps, %.2fx realtime)\n",
+            (unsigned long long)(num_frames - 1), total_s, fps, fps / 60.0);
+        printf("frame: avg %.3fms min %.3fms max %.3fms, p50 %.3fms p95 %.3fms p99 %.3fms\n",
+            (double)total_ns * 1e-6 / (double)(num_frames - 1), (double)min_ns * 1e-6, (double)max_ns * 1e-6,
+            p.p50_val, p.p95_val, p.p99_val);
+    }
+}
 
 void _sapp_linux_run(const sapp_desc* desc) {
     _sapp_init_state(desc);
@@ -707,8 +1127,15 @@ void _sapp_linux_run(const sapp_desc* desc) {
         }
     }
     */
+    if(_sapp_null_backend)
+    {
+      _sapp_null_run();
+      return;
+    }
+#ifndef SOKOL_HAL_NULL
     for(;;)
     {
+      _sapp_timing_measure(&_sapp.timing);
       SDL_Event event;
       while(SDL_PollEvent(&event))
       {
@@ -716,6 +1143,19 @@ void _sapp_linux_run(const sapp_desc* desc) {
         {
           case SDL_QUIT:
             return;
+          case SDL_WINDOWEVENT:
+            //like sokol_app: the frame spanning a resize or a hidden window is no duration sample
+            switch(event.window.event)
+            {
+              case SDL_WINDOWEVENT_SIZE_CHANGED:
+              case SDL_WINDOWEVENT_SHOWN:
+              case SDL_WINDOWEVENT_RESTORED:
+                _sapp_timing_discontinuity(&_sapp.timing);
+                break;
+              default:
+                break;
+            }
+            break;
           case SDL_KEYDOWN:
           case SDL_KEYUP:
             if(event.key.keysym.sym == SDLK_ESCAPE)
@@ -730,8 +1170,11 @@ void _sapp_linux_run(const sapp_desc* desc) {
             }
         }
       }
+      PROF_BEGIN(app_frame);
       _sapp_frame();
+      PROF_END(app_frame);
       //_sapp_glx_swap_buffers()
+      _sapp_pacing_wait(&_sapp.pacing);
       //printf("frame %d\n", _sapp.frame_count);
     }
 /*
@@ -743,11 +1186,8 @@ void _sapp_linux_run(const sapp_desc* desc) {
     _sapp_discard_state();
 */
 	fb_deinit(&fb);
+#endif
 }
 
 
-#define COMMON_IMPL
-#include "prof.h" //all portable
-#include "clock.h" //all portable
-
 #endif
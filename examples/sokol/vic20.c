@@ -32,8 +32,6 @@
 static struct {
     vic20_t vic20;
     uint32_t frame_time_us;
-    uint32_t ticks;
-    double exec_time_ms;
     #ifdef CHIPS_USE_UI
         ui_vic20_t ui_vic20;
     #endif
@@ -51,7 +49,19 @@ static struct {
 // audio-streaming callback
 static void push_audio(const float* samples, int num_samples, void* user_data) {
     (void)user_data;
-    saudio_push(samples, num_samples);
+    if (!warp_active() && !runahead_active()) {
+        saudio_push(samples, num_samples);
+    }
+}
+
+// fast paste: the KERNAL keyboard buffer (count at $C6) has been emptied
+static bool keybuf_ready(void) {
+    return 0 == mem_rd(&state.vic20.mem_cpu, 0xC6);
+}
+
+// media activity query for automatic warp mode
+static bool warp_media_active(void) {
+    return vic20_is_tape_motor_on(&state.vic20);
 }
 
 // get vic20_desc_t struct based on joystick type
@@ -80,9 +90,26 @@ vic20_desc_t vic20_desc(vic20_joystick_type_t joy_type, vic20_memory_config_t me
     };
 }
 
+// the pointers in a snapshot of the system, see snapshot.h
+static void snapshot_fixup(snapshot_fixup_t* fx, void* ptr) {
+    vic20_t* sys = (vic20_t*) ptr;
+    snapshot_relocate(fx, &sys->mem_cpu, sizeof(sys->mem_cpu));
+    snapshot_relocate(fx, &sys->mem_vic, sizeof(sys->mem_vic));
+    snapshot_keep(fx, &sys->debug, sizeof(sys->debug));
+    snapshot_keep(fx, &sys->audio.callback, sizeof(sys->audio.callback));
+    snapshot_keep(fx, &sys->vic.crt.rgba8_buffer, sizeof(sys->vic.crt.rgba8_buffer));
+}
+
 #if defined(CHIPS_USE_UI)
 static void ui_draw_cb(void) {
+    const bool sync = ui_input_pending();
+    if (sync) {
+        emuthread_pause();
+    }
     ui_vic20_draw(&state.ui_vic20);
+    if (sync) {
+        emuthread_resume();
+    }
 }
 static void ui_boot_cb(vic20_t* sys) {
     vic20_desc_t desc = vic20_desc(sys->joystick_type, sys->mem_config, sys->c1530.valid);
@@ -90,6 +117,10 @@ static void ui_boot_cb(vic20_t* sys) {
 }
 #endif
 
+static uint32_t exec_frame(uint32_t frame_time_us);
+static void display_size(int* width, int* height);
+static void handle_input(const sapp_event* event);
+
 void app_init(void) {
     gfx_init(&(gfx_desc_t){
         #ifdef CHIPS_USE_UI
@@ -102,8 +133,15 @@ void app_init(void) {
         .emu_aspect_x = 3,
         .emu_aspect_y = 2
     });
-    keybuf_init(&(keybuf_desc_t){ .key_delay_frames=5 });
+    keybuf_init(&(keybuf_desc_t){ .key_delay_frames=2, .ready_cb=keybuf_ready });
     clock_init();
+    // prof-export=file.csv (summary) or file.json (Chrome trace), written at exit
+    prof_set_export(sargs_value_def("prof-export", 0));
+    prof_init();
+    warp_init(&(warp_desc_t){
+        .active_cb = warp_media_active,
+        .mode = sargs_value_def("warp", "auto"),
+    });
     fs_init();
     saudio_setup(&(saudio_desc){0});
     vic20_joystick_type_t joy_type = VIC20_JOYSTICKTYPE_NONE;
@@ -131,6 +169,19 @@ void app_init(void) {
     bool c1530_enabled = sargs_exists("c1530");
     vic20_desc_t desc = vic20_desc(joy_type, mem_config, c1530_enabled);
     vic20_init(&state.vic20, &desc);
+    snapshot_init(&(snapshot_desc_t){
+        .system = "vic20",
+        .build = __DATE__ " " __TIME__,
+        .sys = &state.vic20,
+        .sys_size = sizeof(state.vic20),
+        .fixup_cb = snapshot_fixup,
+        .load_path = sargs_value_def("snapshot", 0),
+    });
+    runahead_init(&(runahead_desc_t){
+        .sys = &state.vic20,
+        .sys_size = sizeof(state.vic20),
+        .frames = atoi(sargs_value_def("runahead", "0")),
+    });
     #ifdef CHIPS_USE_UI
         ui_init(ui_draw_cb);
         ui_vic20_init(&state.ui_vic20, &(ui_vic20_desc_t){
@@ -167,22 +218,47 @@ void app_init(void) {
             keybuf_put(sargs_value("input"));
         }
     }
+    emuthread_init(&(emuthread_desc_t){
+        .exec_cb = exec_frame,
+        .input_cb = handle_input,
+        .display_cb = display_size,
+        .mode = sargs_value_def("thread", "on"),
+    });
 }
 
 static void handle_file_loading(void);
-static void send_keybuf_input(void);
+static void send_keybuf_input(uint32_t frame_time_us);
 static void draw_status_bar(void);
 
 // per frame stuff, tick the emulator, handle input, decode and draw emulator display
+// runs on the emulation thread if enabled, see emuthread.h
+static uint32_t exec_frame(uint32_t frame_time_us) {
+    warp_begin_frame(frame_time_us);
+    uint32_t ticks = 0;
+    uint32_t exec_time_us;
+    while ((exec_time_us = warp_exec_time()) > 0) {
+        ticks += vic20_exec(&state.vic20, exec_time_us);
+    }
+    if (!warp_active()) {
+        while ((exec_time_us = runahead_exec_time(frame_time_us)) > 0) {
+            vic20_exec(&state.vic20, exec_time_us);
+        }
+    }
+    send_keybuf_input(frame_time_us);
+    return ticks;
+}
+
+static void display_size(int* width, int* height) {
+    *width = vic20_display_width(&state.vic20);
+    *height = vic20_display_height(&state.vic20);
+}
+
 void app_frame(void) {
     state.frame_time_us = clock_frame_time();
-    const uint64_t exec_start_time = stm_now();
-    state.ticks = vic20_exec(&state.vic20, state.frame_time_us);
-    state.exec_time_ms = stm_ms(stm_since(exec_start_time));
+    emuthread_frame(state.frame_time_us);
     draw_status_bar();
-    gfx_draw(vic20_display_width(&state.vic20), vic20_display_height(&state.vic20));
+    gfx_draw(emuthread_display_width(), emuthread_display_height());
     handle_file_loading();
-    send_keybuf_input();
 }
     
 void app_input(const sapp_event* event) {
@@ -196,6 +272,14 @@ void app_input(const sapp_event* event) {
         return;
     }
     #endif
+    emuthread_input(event);
+}
+
+// applies input events to the emulator, on the emulation thread if enabled
+static void handle_input(const sapp_event* event) {
+    if (snapshot_input(event)) {
+        return;
+    }
     const bool shift = event->modifiers & SAPP_MODIFIER_SHIFT;
     switch (event->type) {
         int c;
@@ -249,19 +333,21 @@ void app_input(const sapp_event* event) {
 }
 
 void app_cleanup(void) {
+    emuthread_shutdown();
     vic20_discard(&state.vic20);
     #ifdef CHIPS_USE_UI
         ui_vic20_discard(&state.ui_vic20);
         ui_discard();
     #endif
+    prof_shutdown();
     saudio_shutdown();
     gfx_shutdown();
     sargs_shutdown();
 }
 
-static void send_keybuf_input(void) {
+static void send_keybuf_input(uint32_t frame_time_us) {
     uint8_t key_code;
-    if (0 != (key_code = keybuf_get(state.frame_time_us))) {
+    if (0 != (key_code = keybuf_get(frame_time_us))) {
         /* FIXME: this is ugly */
         vic20_joystick_type_t joy_type = state.vic20.joystick_type;
         state.vic20.joystick_type = VIC20_JOYSTICKTYPE_NONE;
@@ -271,17 +357,46 @@ static void send_keybuf_input(void) {
     }
 }
 
+// instant tape loading: decode a standard KERNAL tape into a .prg and quickload it,
+// the rest of the tape goes into the tape drive for multi-part programs and loaders
+static bool tape_quickload(void) {
+    static uint8_t prg[0x10002];
+    // relocatable programs go to the BASIC start like with LOAD
+    const uint16_t txttab = mem_rd(&state.vic20.mem_cpu, 0x2B) | (mem_rd(&state.vic20.mem_cpu, 0x2C) << 8);
+    int tap_end = 0;
+    const int prg_size = cbmtape_to_prg(fs_ptr(), (int)fs_size(), txttab, prg, sizeof(prg), &tap_end);
+    if ((prg_size == 0) || !vic20_quickload(&state.vic20, prg, prg_size)) {
+        return false;
+    }
+    uint8_t* tail = (uint8_t*) malloc(fs_size());
+    const int tail_size = tail ? cbmtape_tail(fs_ptr(), (int)fs_size(), tap_end, tail, (int)fs_size()) : 0;
+    if ((tail_size > 0) && vic20_insert_tape(&state.vic20, tail, tail_size)) {
+        // the KERNAL starts the motor when the program loads the next part
+        vic20_tape_play(&state.vic20);
+    }
+    free(tail);
+    return true;
+}
+
 static void handle_file_loading(void) {
     fs_dowork();
+    if (fs_failed()) {
+        gfx_flash_error();
+        fs_reset();
+    }
     const uint32_t load_delay_frames = 180;
     if (fs_ptr() && clock_frame_count_60hz() > load_delay_frames) {
+        emuthread_pause();
         bool load_success = false;
+        bool tape_loaded = false;
         if (fs_ext("txt") || fs_ext("bas")) {
             load_success = true;
             keybuf_put((const char*)fs_ptr());
         }
         else if (fs_ext("tap")) {
-            load_success = vic20_insert_tape(&state.vic20, fs_ptr(), fs_size());
+            // with tape=fast, standard KERNAL tapes load instantly, others go through the tape drive
+            tape_loaded = sargs_equals("tape", "fast") && tape_quickload();
+            load_success = tape_loaded || vic20_insert_tape(&state.vic20, fs_ptr(), fs_size());
         }
         else if (fs_ext("bin") || fs_ext("prg") || fs_ext("")) {
             if (sargs_exists("rom")) {
@@ -295,17 +410,17 @@ static void handle_file_loading(void) {
             if (clock_frame_count_60hz() > (load_delay_frames + 10)) {
                 gfx_flash_success();
             }
-            if (fs_ext("tap")) {
+            if (fs_ext("tap") && !tape_loaded) {
                 vic20_tape_play(&state.vic20);
             }
             if (!sargs_exists("debug")) {
                 if (sargs_exists("input")) {
                     keybuf_put(sargs_value("input"));
                 }
-                else if (fs_ext("tap")) {
+                else if (fs_ext("tap") && !tape_loaded) {
                     keybuf_put("LOAD\n");
                 }
-                else if (fs_ext("prg")) {
+                else if (fs_ext("prg") || tape_loaded) {
                     keybuf_put("RUN\n");
                 }
             }
@@ -314,17 +429,27 @@ static void handle_file_loading(void) {
             gfx_flash_error();
         }
         fs_reset();
+        emuthread_resume();
     }
 }
 
 static void draw_status_bar(void) {
     const float w = sapp_widthf();
     const float h = sapp_heightf();
-    double frame_time_ms = state.frame_time_us / 1000.0f;
+    prof_push(PROF_FRAME, (float)state.frame_time_us * 0.001f);
+    prof_push(PROF_EMU, (float)emuthread_exec_time_ms());
+    prof_stats_t frame_stats = prof_stats(PROF_FRAME);
+    prof_percentiles_t frame_pct = prof_percentiles(PROF_FRAME);
+    prof_stats_t emu_stats = prof_stats(PROF_EMU);
+    prof_percentiles_t emu_pct = prof_percentiles(PROF_EMU);
     sdtx_canvas(w, h);
     sdtx_color3b(255, 255, 255);
     sdtx_pos(1.0f, (h / 8.0f) - 1.5f);
-    sdtx_printf("frame:%.2fms emu:%.2fms ticks:%d", frame_time_ms, state.exec_time_ms, state.ticks);
+    sdtx_printf("frame:%.2fms p95:%.2f p99:%.2f emu:%.2fms p95:%.2f p99:%.2f ticks:%d", frame_stats.avg_val, frame_pct.p95_val, frame_pct.p99_val, emu_stats.avg_val, emu_pct.p95_val, emu_pct.p99_val, emuthread_ticks());
+    sdtx_pos(1.0f, (h / 8.0f) - 2.5f);
+    warp_draw_status();
+    sdtx_pos(1.0f, (h / 8.0f) - 3.5f);
+    runahead_draw_status();
 }
 
 sapp_desc sokol_main(int argc, char* argv[]) {
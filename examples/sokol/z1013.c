@@ -28,8 +28,6 @@
 static struct {
     z1013_t z1013;
     uint32_t frame_time_us;
-    uint32_t ticks;
-    double emu_time_ms;
     #ifdef CHIPS_USE_UI
         ui_z1013_t ui_z1013;
     #endif
@@ -59,9 +57,24 @@ z1013_desc_t z1013_desc(z1013_type_t type) {
     };
 }
 
+// the pointers in a snapshot of the system, see snapshot.h
+static void snapshot_fixup(snapshot_fixup_t* fx, void* ptr) {
+    z1013_t* sys = (z1013_t*) ptr;
+    snapshot_relocate(fx, &sys->mem, sizeof(sys->mem));
+    snapshot_keep(fx, &sys->debug, sizeof(sys->debug));
+    snapshot_keep(fx, &sys->pixel_buffer, sizeof(sys->pixel_buffer));
+}
+
 #if defined(CHIPS_USE_UI)
 static void ui_draw_cb(void) {
+    const bool sync = ui_input_pending();
+    if (sync) {
+        emuthread_pause();
+    }
     ui_z1013_draw(&state.ui_z1013);
+    if (sync) {
+        emuthread_resume();
+    }
 }
 static void ui_boot_cb(z1013_t* sys, z1013_type_t type) {
     z1013_desc_t desc = z1013_desc(type);
@@ -69,6 +82,10 @@ static void ui_boot_cb(z1013_t* sys, z1013_type_t type) {
 }
 #endif
 
+static uint32_t exec_frame(uint32_t frame_time_us);
+static void display_size(int* width, int* height);
+static void handle_input(const sapp_event* event);
+
 void app_init(void) {
     gfx_init(&(gfx_desc_t){
         #ifdef CHIPS_USE_UI
@@ -78,9 +95,13 @@ void app_init(void) {
         .border_right = BORDER_RIGHT,
         .border_top = BORDER_TOP,
         .border_bottom = BORDER_BOTTOM,
+        .fb_width = z1013_std_display_width(),
+        .fb_height = z1013_std_display_height(),
     });
     keybuf_init(&(keybuf_desc_t){ .key_delay_frames = 6 });
     clock_init();
+    // prof-export=file.csv (summary) or file.json (Chrome trace), written at exit
+    prof_set_export(sargs_value_def("prof-export", 0));
     prof_init();
     fs_init();
     z1013_type_t type = Z1013_TYPE_64;
@@ -94,6 +115,14 @@ void app_init(void) {
     }
     z1013_desc_t desc = z1013_desc(type);
     z1013_init(&state.z1013, &desc);
+    snapshot_init(&(snapshot_desc_t){
+        .system = "z1013",
+        .build = __DATE__ " " __TIME__,
+        .sys = &state.z1013,
+        .sys_size = sizeof(state.z1013),
+        .fixup_cb = snapshot_fixup,
+        .load_path = sargs_value_def("snapshot", 0),
+    });
     #ifdef CHIPS_USE_UI
         ui_init(ui_draw_cb);
         ui_z1013_init(&state.ui_z1013, &(ui_z1013_desc_t){
@@ -122,21 +151,36 @@ void app_init(void) {
             keybuf_put(sargs_value("input"));
         }
     }
+    emuthread_init(&(emuthread_desc_t){
+        .exec_cb = exec_frame,
+        .input_cb = handle_input,
+        .display_cb = display_size,
+        .mode = sargs_value_def("thread", "on"),
+    });
 }
 
 static void handle_file_loading(void);
-static void send_keybuf_input(void);
+static void send_keybuf_input(uint32_t frame_time_us);
 static void draw_status_bar(void);
 
+// runs on the emulation thread if enabled, see emuthread.h
+static uint32_t exec_frame(uint32_t frame_time_us) {
+    const uint32_t ticks = z1013_exec(&state.z1013, frame_time_us);
+    send_keybuf_input(frame_time_us);
+    return ticks;
+}
+
+static void display_size(int* width, int* height) {
+    *width = z1013_display_width(&state.z1013);
+    *height = z1013_display_height(&state.z1013);
+}
+
 void app_frame(void) {
     state.frame_time_us = clock_frame_time();
-    const uint64_t emu_start_time = stm_now();
-    state.ticks = z1013_exec(&state.z1013, state.frame_time_us);
-    state.emu_time_ms = stm_ms(stm_since(emu_start_time));
+    emuthread_frame(state.frame_time_us);
     draw_status_bar();
-    gfx_draw(z1013_display_width(&state.z1013), z1013_display_height(&state.z1013));
+    gfx_draw(emuthread_display_width(), emuthread_display_height());
     handle_file_loading();
-    send_keybuf_input();
 }
 
 void app_input(const sapp_event* event) {
@@ -150,6 +194,14 @@ void app_input(const sapp_event* event) {
         return;
     }
     #endif
+    emuthread_input(event);
+}
+
+// applies input events to the emulator, on the emulation thread if enabled
+static void handle_input(const sapp_event* event) {
+    if (snapshot_input(event)) {
+        return;
+    }
     switch (event->type) {
         int c;
         case SAPP_EVENTTYPE_CHAR:
@@ -192,18 +244,20 @@ void app_input(const sapp_event* event) {
 }
 
 void app_cleanup(void) {
+    emuthread_shutdown();
     z1013_discard(&state.z1013);
     #ifdef CHIPS_USE_UI
         ui_z1013_discard(&state.ui_z1013);
         ui_discard();
     #endif
+    prof_shutdown();
     gfx_shutdown();
     sargs_shutdown();
 }
 
-static void send_keybuf_input(void) {
+static void send_keybuf_input(uint32_t frame_time_us) {
     uint8_t key_code;
-    if (0 != (key_code = keybuf_get(state.frame_time_us))) {
+    if (0 != (key_code = keybuf_get(frame_time_us))) {
         z1013_key_down(&state.z1013, key_code);
         z1013_key_up(&state.z1013, key_code);
     }
@@ -211,8 +265,13 @@ static void send_keybuf_input(void) {
 
 static void handle_file_loading(void) {
     fs_dowork();
+    if (fs_failed()) {
+        gfx_flash_error();
+        fs_reset();
+    }
     const uint32_t load_delay_frames = 20;
     if (fs_ptr() && (clock_frame_count_60hz() > load_delay_frames)) {
+        emuthread_pause();
         bool load_success = false;
         if (fs_ext("txt") || fs_ext("bas")) {
             load_success = true;
@@ -233,18 +292,23 @@ static void handle_file_loading(void) {
             gfx_flash_error();
         }
         fs_reset();
+        emuthread_resume();
     }
 }
 
 static void draw_status_bar(void) {
-    prof_push(PROF_EMU, (float)state.emu_time_ms);
+    prof_push(PROF_FRAME, (float)state.frame_time_us * 0.001f);
+    prof_push(PROF_EMU, (float)emuthread_exec_time_ms());
+    prof_stats_t frame_stats = prof_stats(PROF_FRAME);
+    prof_percentiles_t frame_pct = prof_percentiles(PROF_FRAME);
     prof_stats_t emu_stats = prof_stats(PROF_EMU);
+    prof_percentiles_t emu_pct = prof_percentiles(PROF_EMU);
     const float w = sapp_widthf();
     const float h = sapp_heightf();
     sdtx_canvas(w, h);
     sdtx_color3b(255, 255, 255);
     sdtx_pos(1.0f, (h / 8.0f) - 1.5f);
-    sdtx_printf("frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d", (float)state.frame_time_us * 0.001f, emu_stats.avg_val, emu_stats.min_val, emu_stats.max_val, state.ticks);
+    sdtx_printf("frame:%.2fms p95:%.2f p99:%.2f emu:%.2fms p95:%.2f p99:%.2f ticks:%d", frame_stats.avg_val, frame_pct.p95_val, frame_pct.p99_val, emu_stats.avg_val, emu_pct.p95_val, emu_pct.p99_val, emuthread_ticks());
 }
 
 sapp_desc sokol_main(int argc, char* argv[]) {
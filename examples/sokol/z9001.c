@@ -36,8 +36,6 @@
 static struct {
     z9001_t z9001;
     uint32_t frame_time_us;
-    uint32_t ticks;
-    double emu_time_ms;
     #ifdef CHIPS_USE_UI
         ui_z9001_t ui_z9001;
     #endif
@@ -87,9 +85,25 @@ z9001_desc_t z9001_desc(z9001_type_t type) {
     };
 }
 
+// the pointers in a snapshot of the system, see snapshot.h
+static void snapshot_fixup(snapshot_fixup_t* fx, void* ptr) {
+    z9001_t* sys = (z9001_t*) ptr;
+    snapshot_relocate(fx, &sys->mem, sizeof(sys->mem));
+    snapshot_keep(fx, &sys->debug, sizeof(sys->debug));
+    snapshot_keep(fx, &sys->audio.callback, sizeof(sys->audio.callback));
+    snapshot_keep(fx, &sys->pixel_buffer, sizeof(sys->pixel_buffer));
+}
+
 #if defined(CHIPS_USE_UI)
 static void ui_draw_cb(void) {
+    const bool sync = ui_input_pending();
+    if (sync) {
+        emuthread_pause();
+    }
     ui_z9001_draw(&state.ui_z9001);
+    if (sync) {
+        emuthread_resume();
+    }
 }
 static void ui_boot_cb(z9001_t* sys, z9001_type_t type) {
     z9001_desc_t desc = z9001_desc(type);
@@ -97,6 +111,10 @@ static void ui_boot_cb(z9001_t* sys, z9001_type_t type) {
 }
 #endif
 
+static uint32_t exec_frame(uint32_t frame_time_us);
+static void display_size(int* width, int* height);
+static void handle_input(const sapp_event* event);
+
 void app_init(void) {
     gfx_init(&(gfx_desc_t) {
         #ifdef CHIPS_USE_UI
@@ -106,9 +124,13 @@ void app_init(void) {
         .border_right = BORDER_RIGHT,
         .border_top = BORDER_TOP,
         .border_bottom = BORDER_BOTTOM,
+        .fb_width = z9001_std_display_width(),
+        .fb_height = z9001_std_display_height(),
     });
     keybuf_init(&(keybuf_desc_t){ .key_delay_frames=12 });
     clock_init();
+    // prof-export=file.csv (summary) or file.json (Chrome trace), written at exit
+    prof_set_export(sargs_value_def("prof-export", 0));
     prof_init();
     fs_init();
     saudio_setup(&(saudio_desc){0});
@@ -120,6 +142,14 @@ void app_init(void) {
     }
     z9001_desc_t desc = z9001_desc(type);
     z9001_init(&state.z9001, &desc);
+    snapshot_init(&(snapshot_desc_t){
+        .system = "z9001",
+        .build = __DATE__ " " __TIME__,
+        .sys = &state.z9001,
+        .sys_size = sizeof(state.z9001),
+        .fixup_cb = snapshot_fixup,
+        .load_path = sargs_value_def("snapshot", 0),
+    });
     #ifdef CHIPS_USE_UI
         ui_init(ui_draw_cb);
         ui_z9001_init(&state.ui_z9001, &(ui_z9001_desc_t){
@@ -148,21 +178,36 @@ void app_init(void) {
             keybuf_put(sargs_value("input"));
         }
     }
+    emuthread_init(&(emuthread_desc_t){
+        .exec_cb = exec_frame,
+        .input_cb = handle_input,
+        .display_cb = display_size,
+        .mode = sargs_value_def("thread", "on"),
+    });
 }
 
 static void handle_file_loading(void);
-static void send_keybuf_input(void);
+static void send_keybuf_input(uint32_t frame_time_us);
 static void draw_status_bar(void);
 
+// runs on the emulation thread if enabled, see emuthread.h
+static uint32_t exec_frame(uint32_t frame_time_us) {
+    const uint32_t ticks = z9001_exec(&state.z9001, frame_time_us);
+    send_keybuf_input(frame_time_us);
+    return ticks;
+}
+
+static void display_size(int* width, int* height) {
+    *width = z9001_display_width(&state.z9001);
+    *height = z9001_display_height(&state.z9001);
+}
+
 void app_frame(void) {
     state.frame_time_us = clock_frame_time();
-    const uint64_t emu_start_time = stm_now();
-    state.ticks = z9001_exec(&state.z9001, state.frame_time_us);
-    state.emu_time_ms = stm_ms(stm_since(emu_start_time));
+    emuthread_frame(state.frame_time_us);
     draw_status_bar();
-    gfx_draw(z9001_display_width(&state.z9001), z9001_display_height(&state.z9001));
+    gfx_draw(emuthread_display_width(), emuthread_display_height());
     handle_file_loading();
-    send_keybuf_input();
 }
 
 // keyboard input handling
@@ -177,6 +222,14 @@ void app_input(const sapp_event* event) {
         return;
     }
     #endif
+    emuthread_input(event);
+}
+
+// applies input events to the emulator, on the emulation thread if enabled
+static void handle_input(const sapp_event* event) {
+    if (snapshot_input(event)) {
+        return;
+    }
     switch (event->type) {
         int c;
         case SAPP_EVENTTYPE_CHAR:
@@ -222,19 +275,21 @@ void app_input(const sapp_event* event) {
 
 // application cleanup callback
 void app_cleanup(void) {
+    emuthread_shutdown();
     z9001_discard(&state.z9001);
     #ifdef CHIPS_USE_UI
         ui_z9001_discard(&state.ui_z9001);
         ui_discard();
     #endif
+    prof_shutdown();
     saudio_shutdown();
     gfx_shutdown();
     sargs_shutdown();
 }
 
-static void send_keybuf_input(void) {
+static void send_keybuf_input(uint32_t frame_time_us) {
     uint8_t key_code;
-    if (0 != (key_code = keybuf_get(state.frame_time_us))) {
+    if (0 != (key_code = keybuf_get(frame_time_us))) {
         z9001_key_down(&state.z9001, key_code);
         z9001_key_up(&state.z9001, key_code);
     }
@@ -242,7 +297,12 @@ static void send_keybuf_input(void) {
 
 static void handle_file_loading(void) {
     fs_dowork();
+    if (fs_failed()) {
+        gfx_flash_error();
+        fs_reset();
+    }
     if (fs_ptr() && clock_frame_count_60hz() > 20) {
+        emuthread_pause();
         bool load_success = false;
         if (fs_ext("txt") || (fs_ext("bas"))) {
             load_success = true;
@@ -261,18 +321,23 @@ static void handle_file_loading(void) {
             gfx_flash_error();
         }
         fs_reset();
+        emuthread_resume();
     }
 }
 
 static void draw_status_bar(void) {
-    prof_push(PROF_EMU, (float)state.emu_time_ms);
+    prof_push(PROF_FRAME, (float)state.frame_time_us * 0.001f);
+    prof_push(PROF_EMU, (float)emuthread_exec_time_ms());
+    prof_stats_t frame_stats = prof_stats(PROF_FRAME);
+    prof_percentiles_t frame_pct = prof_percentiles(PROF_FRAME);
     prof_stats_t emu_stats = prof_stats(PROF_EMU);
+    prof_percentiles_t emu_pct = prof_percentiles(PROF_EMU);
     const float w = sapp_widthf();
     const float h = sapp_heightf();
     sdtx_canvas(w, h);
     sdtx_color3b(255, 255, 255);
     sdtx_pos(1.0f, (h / 8.0f) - 1.5f);
-    sdtx_printf("frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d", (float)state.frame_time_us * 0.001f, emu_stats.avg_val, emu_stats.min_val, emu_stats.max_val, state.ticks);
+    sdtx_printf("frame:%.2fms p95:%.2f p99:%.2f emu:%.2fms p95:%.2f p99:%.2f ticks:%d", frame_stats.avg_val, frame_pct.p95_val, frame_pct.p99_val, emu_stats.avg_val, emu_pct.p95_val, emu_pct.p99_val, emuthread_ticks());
 }
 
 sapp_desc sokol_main(int argc, char* argv[]) {
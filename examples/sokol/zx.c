@@ -33,8 +33,6 @@
 static struct {
     zx_t zx;
     uint32_t frame_time_us;
-    uint32_t ticks;
-    double emu_time_ms;
     #if defined(CHIPS_USE_UI)
         ui_zx_t ui_zx;
     #endif
@@ -52,7 +50,16 @@ static struct {
 // audio-streaming callback
 static void push_audio(const float* samples, int num_samples, void* user_data) {
     (void)user_data;
-    saudio_push(samples, num_samples);
+    if (!runahead_active()) {
+        saudio_push(samples, num_samples);
+    }
+}
+
+// fast paste: the ROM has taken the last key from LAST-K (bit 5 of FLAGS at
+// 23611 is cleared), a repeated key still needs the 6 frame delay to be
+// released and pressed again
+static bool keybuf_ready(void) {
+    return 0 == (mem_rd(&state.zx.mem, 23611) & 0x20);
 }
 
 // get zx_desc_t struct for given ZX type and joystick type
@@ -76,9 +83,25 @@ zx_desc_t zx_desc(zx_type_t type, zx_joystick_type_t joy_type) {
     };
 }
 
+// the pointers in a snapshot of the system, see snapshot.h
+static void snapshot_fixup(snapshot_fixup_t* fx, void* ptr) {
+    zx_t* sys = (zx_t*) ptr;
+    snapshot_relocate(fx, &sys->mem, sizeof(sys->mem));
+    snapshot_keep(fx, &sys->debug, sizeof(sys->debug));
+    snapshot_keep(fx, &sys->audio.callback, sizeof(sys->audio.callback));
+    snapshot_keep(fx, &sys->pixel_buffer, sizeof(sys->pixel_buffer));
+}
+
 #if defined(CHIPS_USE_UI)
 void ui_draw_cb(void) {
+    const bool sync = ui_input_pending();
+    if (sync) {
+        emuthread_pause();
+    }
     ui_zx_draw(&state.ui_zx);
+    if (sync) {
+        emuthread_resume();
+    }
 }
 static void ui_boot_cb(zx_t* sys, zx_type_t type) {
     zx_desc_t desc = zx_desc(type, sys->joystick_type);
@@ -86,6 +109,10 @@ static void ui_boot_cb(zx_t* sys, zx_type_t type) {
 }
 #endif
 
+static uint32_t exec_frame(uint32_t frame_time_us);
+static void display_size(int* width, int* height);
+static void handle_input(const sapp_event* event);
+
 void app_init(void) {
     gfx_init(&(gfx_desc_t){
         #ifdef CHIPS_USE_UI
@@ -95,9 +122,13 @@ void app_init(void) {
         .border_right = BORDER_RIGHT,
         .border_top = BORDER_TOP,
         .border_bottom = BORDER_BOTTOM,
+        .fb_width = zx_std_display_width(),
+        .fb_height = zx_std_display_height(),
     });
-    keybuf_init(&(keybuf_desc_t){ .key_delay_frames=6 });
+    keybuf_init(&(keybuf_desc_t){ .key_delay_frames=6, .ready_cb=keybuf_ready });
     clock_init();
+    // prof-export=file.csv (summary) or file.json (Chrome trace), written at exit
+    prof_set_export(sargs_value_def("prof-export", 0));
     prof_init();
     saudio_setup(&(saudio_desc){0});
     fs_init();
@@ -121,6 +152,25 @@ void app_init(void) {
     }
     zx_desc_t desc = zx_desc(type, joy_type);
     zx_init(&state.zx, &desc);
+    snapshot_init(&(snapshot_desc_t){
+        .system = "zx",
+        .build = __DATE__ " " __TIME__,
+        .sys = &state.zx,
+        .sys_size = sizeof(state.zx),
+        .fixup_cb = snapshot_fixup,
+        .load_path = sargs_value_def("snapshot", 0),
+    });
+    // a snapshot from the command line replaces the boot state, don't cache it
+    bootcache_init(&(bootcache_desc_t){
+        .system = "zx",
+        .boot_frames = 120,
+        .mode = sargs_exists("snapshot") ? "off" : sargs_value_def("bootcache", "on"),
+    });
+    runahead_init(&(runahead_desc_t){
+        .sys = &state.zx,
+        .sys_size = sizeof(state.zx),
+        .frames = atoi(sargs_value_def("runahead", "0")),
+    });
     #ifdef CHIPS_USE_UI
         ui_init(ui_draw_cb);
         ui_zx_init(&state.ui_zx, &(ui_zx_desc_t){
@@ -150,21 +200,41 @@ void app_init(void) {
             keybuf_put(sargs_value("input"));
         }
     }
+    emuthread_init(&(emuthread_desc_t){
+        .exec_cb = exec_frame,
+        .input_cb = handle_input,
+        .display_cb = display_size,
+        .mode = sargs_value_def("thread", "on"),
+    });
 }
 
 static void handle_file_loading(void);
-static void send_keybuf_input(void);
+static void send_keybuf_input(uint32_t frame_time_us);
 static void draw_status_bar(void);
 
+// runs on the emulation thread if enabled, see emuthread.h
+static uint32_t exec_frame(uint32_t frame_time_us) {
+    const uint32_t ticks = zx_exec(&state.zx, frame_time_us);
+    bootcache_frame(frame_time_us);
+    uint32_t ahead_us;
+    while ((ahead_us = runahead_exec_time(frame_time_us)) > 0) {
+        zx_exec(&state.zx, ahead_us);
+    }
+    send_keybuf_input(frame_time_us);
+    return ticks;
+}
+
+static void display_size(int* width, int* height) {
+    *width = zx_display_width(&state.zx);
+    *height = zx_display_height(&state.zx);
+}
+
 void app_frame(void) {
     state.frame_time_us = clock_frame_time();
-    const uint64_t emu_start_time = stm_now();
-    state.ticks = zx_exec(&state.zx, state.frame_time_us);
-    state.emu_time_ms = stm_ms(stm_since(emu_start_time));
+    emuthread_frame(state.frame_time_us);
     draw_status_bar();
-    gfx_draw(zx_display_width(&state.zx), zx_display_height(&state.zx));
+    gfx_draw(emuthread_display_width(), emuthread_display_height());
     handle_file_loading();
-    send_keybuf_input();
 }
 
 void app_input(const sapp_event* event) {
@@ -178,6 +248,14 @@ void app_input(const sapp_event* event) {
         return;
     }
     #endif
+    emuthread_input(event);
+}
+
+// applies input events to the emulator, on the emulation thread if enabled
+static void handle_input(const sapp_event* event) {
+    if (snapshot_input(event)) {
+        return;
+    }
     switch (event->type) {
         int c;
         case SAPP_EVENTTYPE_CHAR:
@@ -216,19 +294,21 @@ void app_input(const sapp_event* event) {
 }
 
 void app_cleanup(void) {
+    emuthread_shutdown();
     zx_discard(&state.zx);
     #ifdef CHIPS_USE_UI
         ui_zx_discard(&state.ui_zx);
         ui_discard();
     #endif
+    prof_shutdown();
     saudio_shutdown();
     gfx_shutdown();
     sargs_shutdown();
 }
 
-static void send_keybuf_input(void) {
+static void send_keybuf_input(uint32_t frame_time_us) {
     uint8_t key_code;
-    if (0 != (key_code = keybuf_get(state.frame_time_us))) {
+    if (0 != (key_code = keybuf_get(frame_time_us))) {
         zx_key_down(&state.zx, key_code);
         zx_key_up(&state.zx, key_code);
     }
@@ -236,8 +316,12 @@ static void send_keybuf_input(void) {
 
 static void handle_file_loading(void) {
     fs_dowork();
-    const uint32_t load_delay_frames = 120;
-    if (fs_ptr() && clock_frame_count_60hz() > load_delay_frames) {
+    if (fs_failed()) {
+        gfx_flash_error();
+        fs_reset();
+    }
+    if (fs_ptr() && bootcache_ready()) {
+        emuthread_pause();
         bool load_success = false;
         if (fs_ext("txt") || fs_ext("bas")) {
             load_success = true;
@@ -247,9 +331,7 @@ static void handle_file_loading(void) {
             load_success = zx_quickload(&state.zx, fs_ptr(), fs_size());
         }
         if (load_success) {
-            if (clock_frame_count_60hz() > (load_delay_frames + 10)) {
-                gfx_flash_success();
-            }
+            gfx_flash_success();
             if (sargs_exists("input")) {
                 keybuf_put(sargs_value("input"));
             }
@@ -258,18 +340,25 @@ static void handle_file_loading(void) {
             gfx_flash_error();
         }
         fs_reset();
+        emuthread_resume();
     }
 }
 
 static void draw_status_bar(void) {
-    prof_push(PROF_EMU, (float)state.emu_time_ms);
+    prof_push(PROF_FRAME, (float)state.frame_time_us * 0.001f);
+    prof_push(PROF_EMU, (float)emuthread_exec_time_ms());
+    prof_stats_t frame_stats = prof_stats(PROF_FRAME);
+    prof_percentiles_t frame_pct = prof_percentiles(PROF_FRAME);
     prof_stats_t emu_stats = prof_stats(PROF_EMU);
+    prof_percentiles_t emu_pct = prof_percentiles(PROF_EMU);
     const float w = sapp_widthf();
     const float h = sapp_heightf();
     sdtx_canvas(w, h);
     sdtx_color3b(255, 255, 255);
     sdtx_pos(1.0f, (h / 8.0f) - 1.5f);
-    sdtx_printf("frame:%.2fms emu:%.2fms (min:%.2fms max:%.2fms) ticks:%d", (float)state.frame_time_us * 0.001f, emu_stats.avg_val, emu_stats.min_val, emu_stats.max_val, state.ticks);
+    sdtx_printf("frame:%.2fms p95:%.2f p99:%.2f emu:%.2fms p95:%.2f p99:%.2f ticks:%d", frame_stats.avg_val, frame_pct.p95_val, frame_pct.p99_val, emu_stats.avg_val, emu_pct.p95_val, emu_pct.p99_val, emuthread_ticks());
+    sdtx_pos(1.0f, (h / 8.0f) - 2.5f);
+    runahead_draw_status();
 }
 
 sapp_desc sokol_main(int argc, char* argv[]) {
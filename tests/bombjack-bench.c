@@ -0,0 +1,88 @@
+//------------------------------------------------------------------------------
+//  bombjack-bench.c
+//  Unthrottled headless Bomb Jack emu for benchmarking / profiling.
+//
+//  Inserts a coin and starts a game so that the sound board gets commands
+//  through the sound latch, and prints a checksum of the generated audio
+//  samples. This is the serial reference for alternative main/sound board
+//  scheduling schemes, which must produce identical audio.
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#define SOKOL_IMPL
+#include "sokol_time.h"
+#define CHIPS_IMPL
+#include "chips/z80.h"
+#include "chips/ay38910.h"
+#include "chips/clk.h"
+#include "chips/mem.h"
+#include "systems/bombjack.h"
+#include "bombjack-roms.h"
+
+static struct {
+    bombjack_t sys;
+    uint32_t pixel_buffer[512*512];
+    uint32_t audio_hash;
+    uint32_t num_samples;
+} state;
+
+#define NUM_FRAMES (60 * 30)
+#define FRAME_USEC (16667)
+
+/* FNV-1a over the sample bits */
+static void audio_callback(const float* samples, int num_samples, void* user_data) {
+    (void)user_data;
+    const uint8_t* ptr = (const uint8_t*) samples;
+    for (size_t i = 0; i < num_samples * sizeof(float); i++) {
+        state.audio_hash = (state.audio_hash ^ ptr[i]) * 0x01000193;
+    }
+    state.num_samples += num_samples;
+}
+
+int main() {
+    bombjack_init(&state.sys, &(bombjack_desc_t){
+        .pixel_buffer = { .ptr = state.pixel_buffer, .size = sizeof(state.pixel_buffer) },
+        .audio = {
+            .callback = { .func = audio_callback },
+            .sample_rate = 44100,
+        },
+        .roms = {
+            .main_0000_1FFF = { .ptr=dump_09_j01b_bin, .size=sizeof(dump_09_j01b_bin) },
+            .main_2000_3FFF = { .ptr=dump_10_l01b_bin, .size=sizeof(dump_10_l01b_bin) },
+            .main_4000_5FFF = { .ptr=dump_11_m01b_bin, .size=sizeof(dump_11_m01b_bin) },
+            .main_6000_7FFF = { .ptr=dump_12_n01b_bin, .size=sizeof(dump_12_n01b_bin) },
+            .main_C000_DFFF = { .ptr=dump_13_1r, .size=sizeof(dump_13_1r) },
+            .sound_0000_1FFF = { .ptr=dump_01_h03t_bin, .size=sizeof(dump_01_h03t_bin) },
+            .chars_0000_0FFF = { .ptr=dump_03_e08t_bin, .size=sizeof(dump_03_e08t_bin) },
+            .chars_1000_1FFF = { .ptr=dump_04_h08t_bin, .size=sizeof(dump_04_h08t_bin) },
+            .chars_2000_2FFF = { .ptr=dump_05_k08t_bin, .size=sizeof(dump_05_k08t_bin) },
+            .tiles_0000_1FFF = { .ptr=dump_06_l08t_bin, .size=sizeof(dump_06_l08t_bin) },
+            .tiles_2000_3FFF = { .ptr=dump_07_n08t_bin, .size=sizeof(dump_07_n08t_bin) },
+            .tiles_4000_5FFF = { .ptr=dump_08_r08t_bin, .size=sizeof(dump_08_r08t_bin) },
+            .sprites_0000_1FFF = { .ptr=dump_16_m07b_bin, .size=sizeof(dump_16_m07b_bin) },
+            .sprites_2000_3FFF = { .ptr=dump_15_l07b_bin, .size=sizeof(dump_15_l07b_bin) },
+            .sprites_4000_5FFF = { .ptr=dump_14_j07b_bin, .size=sizeof(dump_14_j07b_bin) },
+            .maps_0000_0FFF = { .ptr=dump_02_p04t_bin, .size=sizeof(dump_02_p04t_bin) }
+        },
+    });
+    state.audio_hash = 0x811C9DC5;
+    stm_setup();
+    printf("== running %d frames\n", NUM_FRAMES);
+    uint64_t start = stm_now();
+    for (int frame = 0; frame < NUM_FRAMES; frame++) {
+        // coin after 5 secs, start after 6 secs, then keep moving right
+        switch (frame) {
+            case 300: state.sys.mainboard.sys |= BOMBJACK_SYS_P1_COIN; break;
+            case 305: state.sys.mainboard.sys &= ~BOMBJACK_SYS_P1_COIN; break;
+            case 360: state.sys.mainboard.sys |= BOMBJACK_SYS_P1_START; break;
+            case 365: state.sys.mainboard.sys &= ~BOMBJACK_SYS_P1_START; break;
+            case 420: state.sys.mainboard.p1 |= BOMBJACK_JOYSTICK_RIGHT; break;
+            default: break;
+        }
+        bombjack_exec(&state.sys, FRAME_USEC);
+    }
+    const double secs = stm_sec(stm_since(start));
+    printf("== time: %f sec (%.3f ms per frame)\n", secs, (secs * 1000.0) / NUM_FRAMES);
+    printf("== audio: %u samples, checksum %08X\n", state.num_samples, state.audio_hash);
+    bombjack_discard(&state.sys);
+    return 0;
+}
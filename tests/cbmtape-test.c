@@ -0,0 +1,200 @@
+//------------------------------------------------------------------------------
+//  cbmtape-test.c
+//  Test .tap decoding in examples/common/cbmtape.h with encoded programs
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#define COMMON_IMPL
+#include "../examples/common/cbmtape.h"
+#include "utest.h"
+
+#define T(b) ASSERT_TRUE(b)
+
+// KERNAL pulse lengths in units of 8 cycles
+typedef struct {
+    uint8_t s, m, l;
+} pulse_lengths_t;
+static const pulse_lengths_t c64_timing = { 0x30, 0x42, 0x56 };
+static const pulse_lengths_t vic20_timing = { 0x2B, 0x3F, 0x53 };
+
+static uint8_t tap[400000];
+static int tap_size;
+// spread pulse lengths like a real tape does
+static bool jitter;
+
+static void put_pulse(uint8_t len) {
+    if (jitter && (len != 0)) {
+        len = (uint8_t)(len + (tap_size % 5) - 2);
+    }
+    tap[tap_size++] = len;
+}
+
+static void put_byte(const pulse_lengths_t* p, uint8_t byte) {
+    put_pulse(p->l); put_pulse(p->m);
+    int parity = 1;
+    for (int bit = 0; bit < 9; bit++) {
+        const int val = (bit < 8) ? ((byte >> bit) & 1) : parity;
+        parity ^= (bit < 8) ? val : 0;
+        if (val) {
+            put_pulse(p->m); put_pulse(p->s);
+        }
+        else {
+            put_pulse(p->s); put_pulse(p->m);
+        }
+    }
+}
+
+// a block is written twice, with a leader, sync countdown, checksum and end marker
+static void put_block(const pulse_lengths_t* p, const uint8_t* data, int size, int leader) {
+    for (int copy = 0; copy < 2; copy++) {
+        for (int i = 0; i < leader; i++) {
+            put_pulse(p->s);
+        }
+        uint8_t check = 0;
+        for (int i = 0; i < 9; i++) {
+            put_byte(p, (uint8_t)((copy ? 0x09 : 0x89) - i));
+        }
+        for (int i = 0; i < size; i++) {
+            put_byte(p, data[i]);
+            check ^= data[i];
+        }
+        put_byte(p, check);
+        put_pulse(p->l); put_pulse(p->s);
+        leader = 80;
+    }
+}
+
+static void put_program(const pulse_lengths_t* p, uint8_t type, uint16_t start, const uint8_t* data, int size) {
+    uint8_t header[192];
+    memset(header, 0x20, sizeof(header));
+    const uint16_t end = (uint16_t)(start + size);
+    header[0] = type;
+    header[1] = (uint8_t)start; header[2] = (uint8_t)(start >> 8);
+    header[3] = (uint8_t)end; header[4] = (uint8_t)(end >> 8);
+    memcpy(&header[5], "TEST", 4);
+    put_block(p, header, sizeof(header), 2000);
+    put_block(p, data, size, 800);
+}
+
+static void begin_tap(int version) {
+    memset(tap, 0, 20);
+    memcpy(tap, "C64-TAPE-RAW", 12);
+    tap[12] = (uint8_t)version;
+    tap_size = 20;
+    // a pause at the start of the tape
+    if (version == 1) {
+        put_pulse(0); put_pulse(0x00); put_pulse(0x80); put_pulse(0x00);
+    }
+    else {
+        put_pulse(0);
+    }
+}
+
+static uint8_t data[4000];
+static uint8_t prg[0x10002];
+static uint8_t tail[400000];
+
+static void init_data(int size) {
+    for (int i = 0; i < size; i++) {
+        data[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+}
+
+UTEST(cbmtape, c64) {
+    init_data(3000);
+    begin_tap(1);
+    put_program(&c64_timing, 3, 0xC000, data, 3000);
+    const int size = cbmtape_to_prg(tap, tap_size, 0x0801, prg, sizeof(prg), 0);
+    T(size == 3002);
+    T((prg[0] == 0x00) && (prg[1] == 0xC0));
+    T(0 == memcmp(&prg[2], data, 3000));
+}
+
+UTEST(cbmtape, vic20_relocate) {
+    init_data(1000);
+    begin_tap(0);
+    jitter = true;
+    put_program(&vic20_timing, 1, 0x1001, data, 1000);
+    jitter = false;
+    int size = cbmtape_to_prg(tap, tap_size, 0x1201, prg, sizeof(prg), 0);
+    T(size == 1002);
+    T((prg[0] == 0x01) && (prg[1] == 0x12));
+    T(0 == memcmp(&prg[2], data, 1000));
+    // without relocation address the header address is used
+    size = cbmtape_to_prg(tap, tap_size, 0, prg, sizeof(prg), 0);
+    T(size == 1002);
+    T((prg[0] == 0x01) && (prg[1] == 0x10));
+}
+
+UTEST(cbmtape, repeat) {
+    init_data(500);
+    begin_tap(1);
+    put_program(&c64_timing, 1, 0x0801, data, 500);
+    // break a pulse in the first copy of the data block, the repeat must be used
+    const int header_pulses = (2000 + 80) + 2 * ((9 + 192 + 1) * 20 + 2);
+    const int broken = 20 + 4 + header_pulses + 800 + 20 * 20 + 5;
+    T(broken < tap_size);
+    const int size_before = cbmtape_to_prg(tap, tap_size, 0, prg, sizeof(prg), 0);
+    T(size_before == 502);
+    tap[broken] = 0x90;
+    const int size = cbmtape_to_prg(tap, tap_size, 0, prg, sizeof(prg), 0);
+    T(size == 502);
+    T(0 == memcmp(&prg[2], data, 500));
+}
+
+UTEST(cbmtape, two_programs) {
+    init_data(2000);
+    begin_tap(1);
+    put_program(&c64_timing, 1, 0x0801, data, 300);
+    put_program(&c64_timing, 3, 0x4000, data + 300, 1700);
+    int tap_end = 0;
+    int size = cbmtape_to_prg(tap, tap_size, 0, prg, sizeof(prg), &tap_end);
+    T(size == 302);
+    T((tap_end > 20) && (tap_end < tap_size));
+    // the rest of the tape starts after the repeat of the first program's data
+    const int tail_size = cbmtape_tail(tap, tap_size, tap_end, tail, sizeof(tail));
+    T(tail_size == (20 + tap_size - tap_end));
+    T(0 == memcmp(tail, tap, 16));
+    T((tail[16] | (tail[17] << 8) | (tail[18] << 16) | (tail[19] << 24)) == (tap_size - tap_end));
+    int tail_end = 0;
+    size = cbmtape_to_prg(tail, tail_size, 0, prg, sizeof(prg), &tail_end);
+    T(size == 1702);
+    T((prg[0] == 0x00) && (prg[1] == 0x40));
+    T(0 == memcmp(&prg[2], data + 300, 1700));
+    // only the end markers of the second program are left
+    const int last_size = cbmtape_tail(tail, tail_size, tail_end, tap, sizeof(tap));
+    T((last_size > 20) && (last_size < 40));
+    T(0 == cbmtape_to_prg(tap, last_size, 0, prg, sizeof(prg), 0));
+    T(0 == cbmtape_tail(tail, tail_size, tail_size, tap, sizeof(tap)));
+}
+
+UTEST(cbmtape, errors) {
+    init_data(100);
+    begin_tap(1);
+    put_program(&c64_timing, 1, 0x0801, data, 100);
+    // prg buffer too small
+    T(0 == cbmtape_to_prg(tap, tap_size, 0, prg, 50, 0));
+    // not a tape image
+    tap[0] = 'X';
+    T(0 == cbmtape_to_prg(tap, tap_size, 0, prg, sizeof(prg), 0));
+    tap[0] = 'C';
+    // unsupported version (C16 half-wave)
+    tap[12] = 2;
+    T(0 == cbmtape_to_prg(tap, tap_size, 0, prg, sizeof(prg), 0));
+    // a data file without program header
+    begin_tap(1);
+    put_program(&c64_timing, 4, 0x033C, data, 100);
+    T(0 == cbmtape_to_prg(tap, tap_size, 0, prg, sizeof(prg), 0));
+    // a turbo loader, only the header decodes
+    uint8_t header[192];
+    memset(header, 0x20, sizeof(header));
+    header[0] = 3;
+    header[1] = 0xA7; header[2] = 0x02; header[3] = 0x04; header[4] = 0x03;
+    begin_tap(1);
+    put_block(&c64_timing, header, sizeof(header), 2000);
+    for (int i = 0; i < 3000; i++) {
+        put_pulse((i & 1) ? 0x1A : 0x28);
+    }
+    T(0 == cbmtape_to_prg(tap, tap_size, 0, prg, sizeof(prg), 0));
+}
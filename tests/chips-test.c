@@ -1,5 +1,7 @@
 #define CHIPS_IMPL
 #include "chips/z80.h"
+#define SOKOL_IMPL
+#include "sokol_time.h"
 #include "utest.h"
 
 UTEST_MAIN()
@@ -0,0 +1,192 @@
+//------------------------------------------------------------------------------
+//  cpc-bench.c
+//  Headless CPC 6128 disc loading benchmark.
+//
+//  Boots the CPC, inserts boulderdash_cpc.dsk (or the .dsk given as first
+//  arg), types RUN"BOULDER and runs unthrottled until the drive motor has
+//  been off for a while. Prints the emulated and host time spent on
+//  loading. It does this with standard FDC timing and then with the fast
+//  sector transfer from cpc-fastdisc.h. The checksums of the sector data
+//  stored in RAM must match. The whole-RAM checksums differ because the
+//  firmware clock keeps running while the standard mode is still loading.
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define SOKOL_IMPL
+#include "sokol_time.h"
+#define CHIPS_IMPL
+#include "chips/z80.h"
+#include "chips/ay38910.h"
+#include "chips/i8255.h"
+#include "chips/mc6845.h"
+#include "chips/am40010.h"
+#include "chips/upd765.h"
+#include "chips/clk.h"
+#include "chips/kbd.h"
+#include "chips/mem.h"
+#include "chips/fdd.h"
+#include "chips/fdd_cpc.h"
+#include "systems/cpc.h"
+#include "cpc-roms.h"
+#include "../examples/sokol/cpc-fastdisc.h"
+
+static struct {
+    cpc_t cpc;
+    cpc_fastdisc_t fastdisc;
+    uint8_t dummy_pixel_buffer[1024*1024];
+    uint8_t* dsk;
+    size_t dsk_size;
+} state;
+
+#define FRAME_USEC (20000)
+#define BOOT_USEC (2*1000000)
+// typing delay between keys, like the front-end's keybuf
+#define KEY_FRAMES (6)
+// loading is done when the motor stayed off this long (AMSDOS switches it off after about 2 secs)
+#define IDLE_USEC (3*1000000)
+#define MAX_USEC (120*1000000)
+
+static void dummy_audio_callback(const float* samples, int num_samples, void* user_data) {
+    (void)samples;
+    (void)num_samples;
+    (void)user_data;
+};
+
+/* FNV-1a */
+static uint32_t checksum(const uint8_t* ptr, size_t size) {
+    uint32_t hash = 0x811C9DC5;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ ptr[i]) * 0x01000193;
+    }
+    return hash;
+}
+
+static bool load_dsk(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    state.dsk_size = (size_t) ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    state.dsk = (uint8_t*) malloc(state.dsk_size);
+    const bool ok = (1 == fread(state.dsk, state.dsk_size, 1, fp));
+    fclose(fp);
+    return ok;
+}
+
+static void run_frames(int num_frames) {
+    for (int i = 0; i < num_frames; i++) {
+        cpc_exec(&state.cpc, FRAME_USEC);
+    }
+}
+
+static void type(const char* text) {
+    for (; *text; text++) {
+        cpc_key_down(&state.cpc, *text);
+        cpc_key_up(&state.cpc, *text);
+        run_frames(KEY_FRAMES);
+    }
+}
+
+typedef struct {
+    uint32_t sectors;
+    uint32_t data_hash;
+    uint32_t ram_hash;
+    bool ok;
+} result_t;
+
+static result_t run(const char* path, bool fast) {
+    result_t res = {0};
+    /* provide "throw-away" pixel buffer and audio callback, so
+       that the video and audio generation isn't skipped in the
+       emulator, the fast disc hook is installed in both modes
+       so that the host times are comparable
+    */
+    cpc_init(&state.cpc, &(cpc_desc_t){
+        .type = CPC_TYPE_6128,
+        .pixel_buffer = { .ptr = state.dummy_pixel_buffer, .size = sizeof(state.dummy_pixel_buffer) },
+        .audio.callback.func = dummy_audio_callback,
+        .roms = {
+            .cpc6128 = {
+                .os = { .ptr=dump_cpc6128_os_bin, .size=sizeof(dump_cpc6128_os_bin) },
+                .basic = { .ptr=dump_cpc6128_basic_bin, .size= sizeof(dump_cpc6128_basic_bin) },
+                .amsdos = { .ptr=dump_cpc6128_amsdos_bin, .size=sizeof(dump_cpc6128_amsdos_bin) }
+            },
+        },
+        .debug = {
+            .callback = { .func = cpc_fastdisc_tick, .user_data = &state.fastdisc },
+            .stopped = &state.fastdisc.stopped,
+        },
+    });
+    cpc_fastdisc_init(&state.fastdisc, &(cpc_fastdisc_desc_t){ .sys = &state.cpc, .enabled = fast });
+    run_frames(BOOT_USEC / FRAME_USEC);
+    if (!cpc_insert_disc(&state.cpc, state.dsk, (int)state.dsk_size)) {
+        printf("== failed to insert '%s'\n", path);
+        return res;
+    }
+    printf("== loading '%s' (%s)\n", path, fast ? "fast sector transfer" : "standard timing");
+    type("run\"boulder");
+    // measure from pressing Return
+    const uint64_t start = stm_now();
+    cpc_key_down(&state.cpc, 0x0D);
+    cpc_key_up(&state.cpc, 0x0D);
+    uint32_t usec = 0;
+    uint32_t motor_usec = 0;
+    uint32_t idle_usec = 0;
+    while ((idle_usec < IDLE_USEC) && (usec < MAX_USEC)) {
+        cpc_exec(&state.cpc, FRAME_USEC);
+        usec += FRAME_USEC;
+        if (state.cpc.fdd.motor_on) {
+            motor_usec += FRAME_USEC;
+            idle_usec = 0;
+        }
+        else if (motor_usec > 0) {
+            idle_usec += FRAME_USEC;
+        }
+    }
+    const double secs = stm_sec(stm_since(start));
+    const double emu_secs = (usec - idle_usec) / 1000000.0;
+    printf("== emulated load time: %.2f secs (drive motor on: %.2f secs)\n", emu_secs, motor_usec / 1000000.0);
+    printf("== host time: %f secs (%.1fx realtime)\n", secs, (usec / 1000000.0) / secs);
+    res.sectors = state.fastdisc.num_sectors;
+    res.data_hash = state.fastdisc.data_hash;
+    res.ram_hash = checksum((const uint8_t*)state.cpc.ram, sizeof(state.cpc.ram));
+    res.ok = usec < MAX_USEC;
+    printf("== sectors: %d (%d fast, %d bytes)\n", (int)res.sectors, (int)state.fastdisc.num_fast_sectors, (int)state.fastdisc.num_fast_bytes);
+    printf("== sector data: %08X\n", res.data_hash);
+    printf("== cpc ram: %08X\n", res.ram_hash);
+    cpc_discard(&state.cpc);
+    return res;
+}
+
+int main(int argc, char* argv[]) {
+    // the disc image is found relative to this source file unless a path is given
+    char path[1024];
+    if (argc > 1) {
+        snprintf(path, sizeof(path), "%s", argv[1]);
+    }
+    else {
+        const char* slash = strrchr(__FILE__, '/');
+        const int dir_len = slash ? (int)(slash - __FILE__ + 1) : 0;
+        snprintf(path, sizeof(path), "%.*sdisks/boulderdash_cpc.dsk", dir_len, __FILE__);
+    }
+    if (!load_dsk(path)) {
+        printf("== failed to load '%s'\n", path);
+        return 1;
+    }
+    stm_setup();
+    const result_t std_res = run(path, false);
+    const result_t fast_res = run(path, true);
+    free(state.dsk);
+    if (!std_res.ok || !fast_res.ok) {
+        return 1;
+    }
+    if ((std_res.sectors == 0) || (std_res.sectors != fast_res.sectors) || (std_res.data_hash != fast_res.data_hash)) {
+        printf("== MISMATCH: sector data differs between standard and fast mode\n");
+        return 10;
+    }
+    printf("== OK: identical sector data\n");
+    return 0;
+}
@@ -0,0 +1,181 @@
+//------------------------------------------------------------------------------
+//  emuthread-test.c
+//  Test frame handover, frame stats, input forwarding and pausing in
+//  examples/common/emuthread.h
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sokol_app.h"
+#include "sokol_audio.h"
+#include "sokol_time.h"
+#include "../examples/common/gfx.h"
+#define COMMON_IMPL
+#include "../examples/common/emuthread.h"
+#include "utest.h"
+
+#define T(b) ASSERT_TRUE(b)
+
+#define W (16)
+#define H (8)
+static uint32_t fb[W * H];
+static const void* draw_source;
+
+// the gfx and audio functions used by emuthread.h, no audio device here
+uint32_t* gfx_framebuffer(void) { return fb; }
+size_t gfx_framebuffer_size(void) { return sizeof(fb); }
+void gfx_set_draw_source(const void* pixels) { draw_source = pixels; }
+bool saudio_isvalid(void) { return false; }
+int saudio_sample_rate(void) { return 44100; }
+int saudio_expect(void) { return 0; }
+
+static int disp_width = W;
+static int disp_height = H;
+static uint32_t num_frames;
+static uint32_t num_events;
+static bool events_in_order;
+
+// the frame number goes into the pixels and is returned as tick count
+static uint32_t exec_frame(uint32_t frame_time_us) {
+    (void)frame_time_us;
+    num_frames++;
+    for (int i = 0; i < W*H; i++) {
+        fb[i] = num_frames;
+    }
+    return num_frames;
+}
+
+static void handle_input(const sapp_event* event) {
+    if (event->frame_count != num_events) {
+        events_in_order = false;
+    }
+    num_events++;
+}
+
+static void display_size(int* width, int* height) {
+    *width = disp_width;
+    *height = disp_height;
+}
+
+static void reset(void) {
+    stm_setup();
+    memset(fb, 0, sizeof(fb));
+    draw_source = 0;
+    disp_width = W;
+    disp_height = H;
+    num_frames = 0;
+    num_events = 0;
+    events_in_order = true;
+}
+
+// read a counter written by the worker thread
+static uint32_t get(const uint32_t* counter) {
+    emuthread_pause();
+    const uint32_t val = *counter;
+    emuthread_resume();
+    return val;
+}
+
+// wait up to a second for a condition which depends on the worker thread
+#define WAIT_FOR(cond) { uint64_t t0 = stm_now(); while (!(cond) && (stm_sec(stm_since(t0)) < 1.0)) { emuthread_frame(1000); } }
+
+UTEST(emuthread, inline) {
+    reset();
+    emuthread_init(&(emuthread_desc_t){
+        .exec_cb = exec_frame,
+        .input_cb = handle_input,
+        .display_cb = display_size,
+        .mode = "off",
+    });
+    T(!emuthread_threaded());
+    emuthread_frame(16667);
+    emuthread_frame(16667);
+    T(2 == num_frames);
+    T(2 == emuthread_ticks());
+    T((W == emuthread_display_width()) && (H == emuthread_display_height()));
+    T(0 == draw_source);
+    sapp_event ev = { .type = SAPP_EVENTTYPE_KEY_DOWN };
+    emuthread_input(&ev);
+    T(1 == num_events);
+    emuthread_pause();
+    emuthread_resume();
+    emuthread_shutdown();
+}
+
+UTEST(emuthread, threaded) {
+    reset();
+    emuthread_init(&(emuthread_desc_t){
+        .exec_cb = exec_frame,
+        .input_cb = handle_input,
+        .display_cb = display_size,
+        .frame_time_us = 1000,
+    });
+    if (!emuthread_threaded()) {
+        // no thread support on this platform
+        emuthread_shutdown();
+        return;
+    }
+    // finished frames show up as draw source, never the buffer being written
+    WAIT_FOR(draw_source && (((const uint32_t*)draw_source)[0] > 2));
+    T(draw_source != 0);
+    T(draw_source != fb);
+    const uint32_t* pixels = (const uint32_t*) draw_source;
+    T(pixels[0] > 2);
+    T(pixels[0] == pixels[W*H - 1]);
+    T((W == emuthread_display_width()) && (H == emuthread_display_height()));
+    // the stats belong to the frame that is drawn, not the one being run
+    T(emuthread_ticks() == pixels[0]);
+    T(emuthread_exec_time_ms() >= 0.0);
+
+    // no frames while paused
+    emuthread_pause();
+    emuthread_pause();
+    const uint32_t paused_frames = num_frames;
+    emuthread_resume();
+    const uint64_t t0 = stm_now();
+    while (stm_ms(stm_since(t0)) < 20.0) { }
+    T(paused_frames == num_frames);
+    emuthread_resume();
+    WAIT_FOR(get(&num_frames) > (paused_frames + 2));
+    T(get(&num_frames) > (paused_frames + 2));
+
+    // events arrive in order, also when the queue overflows
+    for (uint32_t i = 0; i < 3 * EMUTHREAD_NUM_EVENTS; i++) {
+        sapp_event ev = { .type = SAPP_EVENTTYPE_KEY_DOWN, .frame_count = i };
+        emuthread_input(&ev);
+    }
+    WAIT_FOR(get(&num_events) == (3 * EMUTHREAD_NUM_EVENTS));
+    T(get(&num_events) == (3 * EMUTHREAD_NUM_EVENTS));
+    T(events_in_order);
+
+    emuthread_shutdown();
+    T(0 == draw_source);
+}
+
+UTEST(emuthread, resize) {
+    reset();
+    disp_height = H / 2;
+    emuthread_init(&(emuthread_desc_t){
+        .exec_cb = exec_frame,
+        .input_cb = handle_input,
+        .display_cb = display_size,
+        .frame_time_us = 1000,
+    });
+    if (!emuthread_threaded()) {
+        emuthread_shutdown();
+        return;
+    }
+    WAIT_FOR(draw_source && (((const uint32_t*)draw_source)[0] > 2));
+    T((W == emuthread_display_width()) && ((H / 2) == emuthread_display_height()));
+
+    // the buffers grow when the display gets bigger
+    emuthread_pause();
+    disp_height = H;
+    const uint32_t resize_frame = num_frames;
+    emuthread_resume();
+    WAIT_FOR((H == emuthread_display_height()) && (((const uint32_t*)draw_source)[0] > (resize_frame + 3)));
+    T(H == emuthread_display_height());
+    const uint32_t* pixels = (const uint32_t*) draw_source;
+    T(pixels[0] == pixels[W*H - 1]);
+    emuthread_shutdown();
+}
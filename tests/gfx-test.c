@@ -0,0 +1,109 @@
+//------------------------------------------------------------------------------
+//  gfx-test.c
+//  Test the dirty-row detection and indexed-mode CPU conversion
+//  in examples/common/gfx.h
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#define GFX_DIRTY_IMPL
+#include "../examples/common/gfx.h"
+#include "utest.h"
+
+#define T(b) ASSERT_TRUE(b)
+
+#define W (320)
+#define H (200)
+static gfx_dirty_t dirty;
+static uint32_t fb[W * H];
+
+UTEST(gfx, dirty_rows) {
+    for (int i = 0; i < W*H; i++) {
+        fb[i] = 0xFF000000 | (uint32_t)i;
+    }
+    gfx_dirty_reset(&dirty);
+
+    // first frame is fully dirty, in one span
+    T(H == gfx_dirty_update(&dirty, fb, W, H, W));
+    T(1 == dirty.num_spans);
+    T((0 == dirty.spans[0].first_row) && (H == dirty.spans[0].num_rows));
+
+    // identical frame: nothing to do
+    T(0 == gfx_dirty_update(&dirty, fb, W, H, W));
+    T(0 == dirty.num_spans);
+
+    // a single changed pixel, also the last (odd) one of a row
+    fb[10*W + 5] ^= 1;
+    T(1 == gfx_dirty_update(&dirty, fb, W, H, W));
+    T((1 == dirty.num_spans) && (10 == dirty.spans[0].first_row) && (1 == dirty.spans[0].num_rows));
+    fb[20*W + W-1] ^= 0x80000000;
+    T(1 == gfx_dirty_update(&dirty, fb, W, H, W));
+    T((1 == dirty.num_spans) && (20 == dirty.spans[0].first_row));
+
+    // two words swapped still differ
+    uint32_t tmp = fb[30*W + 0]; fb[30*W + 0] = fb[30*W + 2]; fb[30*W + 2] = tmp;
+    T(1 == gfx_dirty_update(&dirty, fb, W, H, W));
+
+    // adjacent rows merge into one span, separate rows make separate spans
+    fb[50*W] ^= 1; fb[51*W] ^= 1; fb[52*W] ^= 1;
+    fb[100*W] ^= 1;
+    T(4 == gfx_dirty_update(&dirty, fb, W, H, W));
+    T(2 == dirty.num_spans);
+    T((50 == dirty.spans[0].first_row) && (3 == dirty.spans[0].num_rows));
+    T((100 == dirty.spans[1].first_row) && (1 == dirty.spans[1].num_rows));
+
+    // more separate rows than spans: the last span covers the rest
+    for (int i = 0; i < GFX_MAX_DIRTY_SPANS + 4; i++) {
+        fb[(i * 10) * W] ^= 1;
+    }
+    T((GFX_MAX_DIRTY_SPANS + 4) == gfx_dirty_update(&dirty, fb, W, H, W));
+    T(GFX_MAX_DIRTY_SPANS == dirty.num_spans);
+    const gfx_row_span_t* last = &dirty.spans[GFX_MAX_DIRTY_SPANS - 1];
+    T(((GFX_MAX_DIRTY_SPANS - 1) * 10) == last->first_row);
+    T(((GFX_MAX_DIRTY_SPANS + 3) * 10) == (last->first_row + last->num_rows - 1));
+
+    // a size change or reset makes everything dirty again
+    T((H/2) == gfx_dirty_update(&dirty, fb, W, H/2, W));
+    gfx_dirty_reset(&dirty);
+    T((H/2) == gfx_dirty_update(&dirty, fb, W, H/2, W));
+
+    // stride larger than width, changes outside of width are ignored
+    T((H/2) == gfx_dirty_update(&dirty, fb, W/2, H/2, W));
+    fb[5*W + W/2 + 1] ^= 1;
+    T(0 == gfx_dirty_update(&dirty, fb, W/2, H/2, W));
+}
+
+UTEST(gfx, indexed) {
+    static uint8_t idx[W * H];
+    static uint32_t rgba[W * H];
+    uint32_t palette[GFX_PALETTE_SIZE];
+    for (int i = 0; i < GFX_PALETTE_SIZE; i++) {
+        palette[i] = 0xFF000000 | (uint32_t)(i * 0x010203);
+    }
+    for (int i = 0; i < W*H; i++) {
+        idx[i] = (uint8_t)(i * 7);
+    }
+
+    // reference conversion, also with a sub-rectangle and different strides
+    gfx_indexed_to_rgba8(idx, W, palette, rgba, W, W, H);
+    bool ok = true;
+    for (int i = 0; i < W*H; i++) {
+        ok &= rgba[i] == palette[idx[i]];
+    }
+    T(ok);
+    memset(rgba, 0, sizeof(rgba));
+    gfx_indexed_to_rgba8(idx + W + 1, W, palette, rgba, 16, 10, 3);
+    T(rgba[0] == palette[idx[W + 1]]);
+    T(rgba[2*16 + 9] == palette[idx[3*W + 10]]);
+    T(rgba[10] == 0);
+
+    // dirty rows on 8-bit data, width not a multiple of 8
+    gfx_dirty_reset(&dirty);
+    T(H == gfx_dirty_update_indexed(&dirty, idx, W - 3, H, W));
+    T(0 == gfx_dirty_update_indexed(&dirty, idx, W - 3, H, W));
+    idx[7*W + W - 4] ^= 1;
+    T(1 == gfx_dirty_update_indexed(&dirty, idx, W - 3, H, W));
+    T((1 == dirty.num_spans) && (7 == dirty.spans[0].first_row));
+    idx[8*W + W - 3] ^= 1;
+    T(0 == gfx_dirty_update_indexed(&dirty, idx, W - 3, H, W));
+}
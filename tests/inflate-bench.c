@@ -0,0 +1,150 @@
+//------------------------------------------------------------------------------
+//  inflate-bench.c
+//  Throughput of the deflate decoder in examples/common/inflate.h, with
+//  zlib as reference implementation. Also checks that both produce the
+//  same output.
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#define SOKOL_IMPL
+#include "sokol_time.h"
+#define COMMON_IMPL
+#include "../examples/common/inflate.h"
+
+#define DATA_SIZE (32 * 1024 * 1024)
+#define NUM_RUNS (5)
+
+static uint32_t rand_state = 0x12345678;
+static uint32_t xorshift32(void) {
+    uint32_t x = rand_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return rand_state = x;
+}
+
+/* generate compressible test data: words, repeated runs and noise */
+static void gen_data(uint8_t* ptr, size_t size) {
+    static const char* words[] = {
+        "LOAD", "RUN", "POKE", "PEEK", "SYS", "PRINT", "GOTO", "READY.",
+        "10 ", "20 ", "53280", "53281", "CHR$(", "\n", " ", "DATA "
+    };
+    size_t pos = 0;
+    while (pos < size) {
+        const uint32_t r = xorshift32();
+        const uint32_t kind = r & 15;
+        if (kind < 10) {
+            const char* w = words[(r >> 4) & 15];
+            const size_t len = strlen(w);
+            for (size_t i = 0; (i < len) && (pos < size); i++) {
+                ptr[pos++] = (uint8_t)w[i];
+            }
+        }
+        else if (kind < 13) {
+            const size_t len = (r >> 8) & 63;
+            for (size_t i = 0; (i < len) && (pos < size); i++) {
+                ptr[pos++] = (uint8_t)(r >> 16);
+            }
+        }
+        else {
+            const size_t len = (r >> 8) & 15;
+            for (size_t i = 0; (i < len) && (pos < size); i++) {
+                ptr[pos++] = (uint8_t)xorshift32();
+            }
+        }
+    }
+}
+
+/* raw deflate compression with zlib */
+static size_t compress_raw(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size, int level) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return 0;
+    }
+    zs.next_in = (Bytef*)src;
+    zs.avail_in = (uInt)src_size;
+    zs.next_out = dst;
+    zs.avail_out = (uInt)dst_size;
+    const int res = deflate(&zs, Z_FINISH);
+    deflateEnd(&zs);
+    return (res == Z_STREAM_END) ? (size_t)zs.total_out : 0;
+}
+
+static bool zlib_inflate_raw(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -15) != Z_OK) {
+        return false;
+    }
+    zs.next_in = (Bytef*)src;
+    zs.avail_in = (uInt)src_size;
+    zs.next_out = dst;
+    zs.avail_out = (uInt)dst_size;
+    const int res = inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+    return res == Z_STREAM_END;
+}
+
+/* decode in 1 MB steps like fs_dowork() does */
+static bool chips_inflate_raw(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size) {
+    static inflate_t inf;
+    inflate_init(&inf, src, src_size, dst, dst_size);
+    inflate_status_t res;
+    while (INFLATE_STATUS_MORE == (res = inflate_run(&inf, 1024 * 1024)));
+    return (res == INFLATE_STATUS_DONE) && (inf.dst_pos == dst_size);
+}
+
+int main() {
+    stm_setup();
+    uint8_t* data = malloc(DATA_SIZE);
+    uint8_t* packed = malloc(DATA_SIZE + DATA_SIZE / 8);
+    uint8_t* out = malloc(DATA_SIZE);
+    gen_data(data, DATA_SIZE);
+    int ret = 0;
+    const int levels[3] = { 1, 6, 9 };
+    for (int l = 0; l < 3; l++) {
+        const size_t packed_size = compress_raw(data, DATA_SIZE, packed, DATA_SIZE + DATA_SIZE / 8, levels[l]);
+        if (packed_size == 0) {
+            printf("zlib compression failed\n");
+            return 10;
+        }
+        printf("== level %d: %d => %d bytes\n", levels[l], DATA_SIZE, (int)packed_size);
+        double best_zlib = 1e9, best_chips = 1e9;
+        for (int run = 0; run < NUM_RUNS; run++) {
+            memset(out, 0, DATA_SIZE);
+            uint64_t start = stm_now();
+            bool ok = zlib_inflate_raw(packed, packed_size, out, DATA_SIZE);
+            double t = stm_sec(stm_since(start));
+            if (!ok || memcmp(out, data, DATA_SIZE)) {
+                printf("zlib output mismatch!\n");
+                ret = 10;
+            }
+            best_zlib = (t < best_zlib) ? t : best_zlib;
+
+            memset(out, 0, DATA_SIZE);
+            start = stm_now();
+            ok = chips_inflate_raw(packed, packed_size, out, DATA_SIZE);
+            t = stm_sec(stm_since(start));
+            if (!ok || memcmp(out, data, DATA_SIZE)) {
+                printf("inflate.h output mismatch!\n");
+                ret = 10;
+            }
+            best_chips = (t < best_chips) ? t : best_chips;
+        }
+        const double mb = DATA_SIZE / (1024.0 * 1024.0);
+        printf("   zlib:      %7.1f MB/s\n", mb / best_zlib);
+        printf("   inflate.h: %7.1f MB/s (%.2fx)\n", mb / best_chips, best_zlib / best_chips);
+    }
+    // CRC-32 check value
+    if (inflate_crc32(0, (const uint8_t*)"123456789", 9) != 0xCBF43926) {
+        printf("crc32 mismatch!\n");
+        ret = 10;
+    }
+    free(data);
+    free(packed);
+    free(out);
+    return ret;
+}
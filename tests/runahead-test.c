@@ -0,0 +1,86 @@
+//------------------------------------------------------------------------------
+//  runahead-test.c
+//  Test save/restore and video switching in examples/common/runahead.h
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sokol_time.h"
+#define COMMON_IMPL
+#define RUNAHEAD_NO_STATUS
+#include "../examples/common/runahead.h"
+#include "utest.h"
+
+#define T(b) ASSERT_TRUE(b)
+
+typedef struct {
+    uint32_t frame;
+    uint32_t exec_us;
+    uint8_t mem[1024];
+} fake_sys_t;
+static fake_sys_t sys;
+
+static void fake_exec(uint32_t us) {
+    sys.frame++;
+    sys.exec_us += us;
+    sys.mem[sys.frame & 1023] = (uint8_t)sys.frame;
+}
+
+static int video_on, video_off;
+static uint32_t video_frame;
+static void video_cb(bool enabled) {
+    if (enabled) {
+        video_on++;
+        video_frame = sys.frame;
+    }
+    else {
+        video_off++;
+    }
+}
+
+UTEST(runahead, off) {
+    stm_setup();
+    memset(&sys, 0, sizeof(sys));
+    runahead_init(&(runahead_desc_t){ .sys = &sys, .sys_size = sizeof(sys) });
+    T(0 == runahead_exec_time(16667));
+    T(!runahead_active());
+}
+
+UTEST(runahead, restore) {
+    stm_setup();
+    memset(&sys, 0, sizeof(sys));
+    video_on = video_off = 0;
+    runahead_init(&(runahead_desc_t){ .sys = &sys, .sys_size = sizeof(sys), .frames = 3, .video_cb = video_cb });
+    for (int frame = 0; frame < 10; frame++) {
+        // the real timeline
+        fake_exec(16667);
+        fake_sys_t real = sys;
+        int num_ahead = 0;
+        uint32_t us;
+        while ((us = runahead_exec_time(16667)) > 0) {
+            T(runahead_active());
+            fake_exec(us);
+            num_ahead++;
+        }
+        T(!runahead_active());
+        T(3 == num_ahead);
+        T(0 == memcmp(&real, &sys, sizeof(sys)));
+    }
+    // video off for the 2 hidden frames, on for the presented one and after restore
+    T(20 == video_off);
+    T(20 == video_on);
+    T(10 == sys.frame);
+
+    // the frame count is clamped, and a zero frame time does nothing
+    runahead_set_frames(100);
+    runahead_init(&(runahead_desc_t){ .sys = &sys, .sys_size = sizeof(sys) });
+    int num_ahead = 0;
+    while (runahead_exec_time(16667) > 0) {
+        fake_exec(16667);
+        num_ahead++;
+    }
+    T(RUNAHEAD_MAX_FRAMES == num_ahead);
+    T(0 == runahead_exec_time(0));
+    T(!runahead_active());
+    runahead_set_frames(0);
+}
@@ -0,0 +1,223 @@
+//------------------------------------------------------------------------------
+//  snapshot-test.c
+//  Test pointer fix-ups and header checks in examples/common/snapshot.h,
+//  and the boot-state cache in examples/common/bootcache.h built on it
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "sokol_app.h"
+#include "../examples/common/gfx.h"
+#define COMMON_IMPL
+#include "../examples/common/snapshot.h"
+#include "../examples/common/bootcache.h"
+#include "utest.h"
+
+#define T(b) ASSERT_TRUE(b)
+
+// snapshot_input() feedback, not tested here
+void gfx_flash_success(void) { }
+void gfx_flash_error(void) { }
+
+typedef struct {
+    uint8_t ram[64];
+    uint8_t* bank[4];
+    uint32_t* pixels;
+    void (*callback)(void);
+    void* user_data;
+    uint64_t data;
+} fake_sys_t;
+
+static void fake_callback(void) { }
+static int fake_user_data;
+static uint8_t fake_unmapped[16];
+static fake_sys_t sys_a, sys_b;
+static uint32_t pixels_a[16], pixels_b[16];
+static uint8_t buf[4096];
+
+static void fake_init(fake_sys_t* sys, uint32_t* pixels) {
+    memset(sys, 0, sizeof(fake_sys_t));
+    for (int i = 0; i < 4; i++) {
+        sys->bank[i] = &sys->ram[i * 16];
+    }
+    sys->pixels = pixels;
+    sys->callback = fake_callback;
+    sys->user_data = &fake_user_data;
+}
+
+static void fake_fixup(snapshot_fixup_t* fx, void* ptr) {
+    fake_sys_t* sys = (fake_sys_t*) ptr;
+    snapshot_relocate(fx, sys->bank, sizeof(sys->bank));
+    snapshot_keep(fx, &sys->pixels, sizeof(sys->pixels));
+    snapshot_keep(fx, &sys->callback, sizeof(sys->callback));
+    snapshot_keep(fx, &sys->user_data, sizeof(sys->user_data));
+}
+
+static void setup(fake_sys_t* sys, const char* build) {
+    snapshot_init(&(snapshot_desc_t){
+        .system = "fake",
+        .build = build,
+        .sys = sys,
+        .sys_size = sizeof(fake_sys_t),
+        .fixup_cb = fake_fixup,
+    });
+}
+
+UTEST(snapshot, relocate) {
+    fake_init(&sys_a, pixels_a);
+    sys_a.bank[1] = &sys_a.ram[48];
+    sys_a.bank[2] = 0;
+    sys_a.bank[3] = fake_unmapped;
+    sys_a.ram[7] = 0x77;
+    // plain data which happens to look like a pointer into the struct stays as-is
+    sys_a.data = (uint64_t)(uintptr_t)&sys_a.ram[5];
+    setup(&sys_a, "build 1");
+    const size_t size = snapshot_write(0, 0);
+    T((size > sizeof(fake_sys_t)) && (size <= sizeof(buf)));
+    T(0 == snapshot_write(buf, size - 1));
+    T(size == snapshot_write(buf, sizeof(buf)));
+
+    // saving is deterministic and leaves the system alone
+    static uint8_t buf2[4096];
+    T(size == snapshot_write(buf2, sizeof(buf2)));
+    T(0 == memcmp(buf, buf2, size));
+    T(sys_a.pixels == pixels_a);
+
+    // restore into another struct with another pixel buffer, the kept
+    // pointers are those of the running system
+    fake_init(&sys_b, pixels_b);
+    sys_b.user_data = 0;
+    setup(&sys_b, "build 1");
+    T(snapshot_read(buf, size));
+    T(sys_b.bank[0] == &sys_b.ram[0]);
+    T(sys_b.bank[1] == &sys_b.ram[48]);
+    T(sys_b.bank[2] == 0);
+    T(sys_b.bank[3] == fake_unmapped);
+    T(sys_b.pixels == pixels_b);
+    T(sys_b.callback == fake_callback);
+    T(sys_b.user_data == 0);
+    T(sys_b.ram[7] == 0x77);
+    T(sys_b.data == (uint64_t)(uintptr_t)&sys_a.ram[5]);
+}
+
+UTEST(snapshot, reject) {
+    fake_init(&sys_a, pixels_a);
+    setup(&sys_a, "build 1");
+    const size_t size = snapshot_write(buf, sizeof(buf));
+    T(size > 0);
+
+    // other build, truncated data or damaged header leave the system alone
+    fake_init(&sys_b, pixels_b);
+    sys_b.data = 42;
+    setup(&sys_b, "build 2");
+    T(!snapshot_read(buf, size));
+    setup(&sys_b, "build 1");
+    T(!snapshot_read(buf, size - 1));
+    buf[4] ^= 1;
+    T(!snapshot_read(buf, size));
+    buf[4] ^= 1;
+    // a relocated pointer outside of the system struct
+    uintptr_t bank0;
+    const size_t bank0_pos = size - sizeof(fake_sys_t) + offsetof(fake_sys_t, bank);
+    memcpy(&bank0, buf + bank0_pos, sizeof(bank0));
+    const uintptr_t bad = (sizeof(fake_sys_t) << 1) | 1;
+    memcpy(buf + bank0_pos, &bad, sizeof(bad));
+    T(!snapshot_read(buf, size));
+    memcpy(buf + bank0_pos, &bank0, sizeof(bank0));
+    T(42 == sys_b.data);
+    T(snapshot_read(buf, size));
+    T(0 == sys_b.data);
+}
+
+UTEST(snapshot, slots) {
+    fake_init(&sys_a, pixels_a);
+    setup(&sys_a, "build 1");
+    T(!snapshot_slot_valid(0));
+    T(!snapshot_load(0));
+    sys_a.data = 1;
+    T(snapshot_save(0));
+    sys_a.data = 2;
+    T(snapshot_save(SNAPSHOT_NUM_SLOTS - 1));
+    T(!snapshot_save(SNAPSHOT_NUM_SLOTS));
+    sys_a.data = 3;
+    T(snapshot_load(0) && (1 == sys_a.data));
+    T(snapshot_load(SNAPSHOT_NUM_SLOTS - 1) && (2 == sys_a.data));
+    T(snapshot_slot_valid(0));
+    remove("fake-1.snp");
+    remove("fake-4.snp");
+}
+
+static bool file_exists(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (fp) {
+        fclose(fp);
+    }
+    return 0 != fp;
+}
+
+static void setup_bootcache(fake_sys_t* sys, const char* build, const char* mode) {
+    setup(sys, build);
+    bootcache_init(&(bootcache_desc_t){
+        .system = "fake",
+        .boot_frames = 3,
+        .mode = mode,
+    });
+}
+
+UTEST(snapshot, bootcache) {
+    // start without a cache file from an earlier run
+    fake_init(&sys_a, pixels_a);
+    setup_bootcache(&sys_a, "build 1", 0);
+    remove(bootcache_path());
+    fake_init(&sys_a, pixels_a);
+    setup_bootcache(&sys_a, "build 1", 0);
+    T(!bootcache_restored());
+    T(!bootcache_ready());
+
+    // cold boot, the cache is written once the boot frames have passed
+    bootcache_frame(16667);
+    bootcache_frame(16667);
+    T(!bootcache_ready());
+    sys_a.ram[3] = 0x33;
+    bootcache_frame(16667);
+    T(bootcache_ready());
+    T(file_exists(bootcache_path()));
+    char path[64];
+    snprintf(path, sizeof(path), "%s", bootcache_path());
+
+    // the next launch restores the booted state
+    fake_init(&sys_b, pixels_b);
+    setup_bootcache(&sys_b, "build 1", 0);
+    T(bootcache_restored());
+    T(bootcache_ready());
+    T(sys_b.ram[3] == 0x33);
+    T(sys_b.bank[1] == &sys_b.ram[16]);
+    T(sys_b.pixels == pixels_b);
+    T(0 == strcmp(path, bootcache_path()));
+
+    // another configuration (or other ROMs) is another key
+    fake_init(&sys_b, pixels_b);
+    sys_b.data = 2;
+    setup_bootcache(&sys_b, "build 1", 0);
+    T(!bootcache_restored());
+    T(0 != strcmp(path, bootcache_path()));
+    T(sys_b.ram[3] == 0);
+
+    // so is another build
+    fake_init(&sys_b, pixels_b);
+    setup_bootcache(&sys_b, "build 2", 0);
+    T(!bootcache_restored());
+
+    // the cache can be switched off
+    fake_init(&sys_b, pixels_b);
+    setup_bootcache(&sys_b, "build 1", "off");
+    T(!bootcache_restored());
+    T(!bootcache_ready());
+    for (int i = 0; i < 3; i++) {
+        bootcache_frame(16667);
+    }
+    T(bootcache_ready());
+    T(0 == bootcache_path()[0]);
+    remove(path);
+}